@@ -11,175 +11,602 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/buffer_pool_manager.h"
-#include "common/logger.h"
 
-// TODO(duynl58): remember to use RWLatch for all pages
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "common/exception.h"
+#include "common/logger.h"
 
 namespace bustub {
 
 BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager)
-    : pool_size_(pool_size), disk_manager_(disk_manager), log_manager_(log_manager) {
-  // We allocate a consecutive memory space for the buffer pool.
-  pages_ = new Page[pool_size_];
-  replacer_ = new ClockReplacer(pool_size);
+    : BufferPoolManager(1, pool_size, disk_manager, log_manager) {}
+
+BufferPoolManager::BufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
+                                     LogManager *log_manager, const BufferPoolOptions &options)
+    : pool_size_(pool_size),
+      max_pool_size_(std::max(pool_size, options.max_pool_size_)),
+      disk_manager_(disk_manager),
+      log_manager_(log_manager),
+      options_(options),
+      metrics_(num_instances, options.latency_sample_interval_, std::max<size_t>(1, options.max_owners_)),
+      owner_names_{"none"},
+      owner_quotas_{0} {
+  BUSTUB_ASSERT(num_instances > 0 && num_instances <= pool_size, "Every instance needs at least one frame.");
+  options_.max_owners_ = std::max<size_t>(1, options_.max_owners_);
+  // We allocate a consecutive memory space for the buffer pool. The address space for the largest size is reserved
+  // now, but the operating system only backs the pages that are touched.
+  page_data_ = mapPageData(max_pool_size_ * PAGE_SIZE, &page_data_size_);
+  pages_ = static_cast<Page *>(::operator new(max_pool_size_ * sizeof(Page)));
+  for (size_t i = 0; i < max_pool_size_; ++i) {
+    new (&pages_[i]) Page(page_data_ + i * PAGE_SIZE);
+  }
+
+  if (options_.extent_size_ > 0) {
+    extents_.resize(options_.max_owners_);
+  }
+  if (options_.compressed_cache_size_ > 0) {
+    compressed_cache_ = new CompressedPageCache(options_.compressed_cache_size_);
+  }
+  instances_.resize(num_instances);
+  for (size_t i = 0; i < num_instances; ++i) {
+    instances_[i] = new BufferPoolManagerInstance(InstanceSize(pool_size_, i), InstanceSize(max_pool_size_, i),
+                                                  num_instances, i, pages_, &metrics_, compressed_cache_,
+                                                  disk_manager_, log_manager_, options_);
+  }
 
-  // Initially, every page is in the free list.
-  for (size_t i = 0; i < pool_size_; ++i) {
-    free_list_.emplace_back(static_cast<int>(i));
+  if (options_.enable_page_cleaner_) {
+    page_cleaner_thread_ = new std::thread(&BufferPoolManager::runPageCleanerThread, this);
+  }
+  if (!options_.warm_start_file_.empty()) {
+    warm_start_thread_ = new std::thread([this] {
+      // A warm start only saves misses, so it must not take the process down when it fails.
+      try {
+        LoadResidentPages(options_.warm_start_file_);
+      } catch (const std::exception &e) {
+        LOG_WARN("cannot load warm start file %s: %s", options_.warm_start_file_.c_str(), e.what());
+      }
+    });
   }
 }
 
 BufferPoolManager::~BufferPoolManager() {
-  delete[] pages_;
-  delete replacer_;
+  if (warm_start_thread_ != nullptr) {
+    stop_loading_ = true;
+    warm_start_thread_->join();
+    delete warm_start_thread_;
+  }
+  SaveResidentPages();
+  if (page_cleaner_thread_ != nullptr) {
+    {
+      std::lock_guard<std::mutex> lock(cleaner_latch_);
+      stop_cleaning_ = true;
+    }
+    cleaner_cv_.notify_all();
+    page_cleaner_thread_->join();
+    delete page_cleaner_thread_;
+  }
+  {
+    std::lock_guard<std::mutex> lock(prefetch_latch_);
+    stop_prefetching_ = true;
+  }
+  prefetch_cv_.notify_all();
+  if (prefetch_thread_ != nullptr) {
+    prefetch_thread_->join();
+    delete prefetch_thread_;
+  }
+  for (auto instance : instances_) {
+    delete instance;
+  }
+  delete compressed_cache_;
+  for (size_t i = 0; i < max_pool_size_; ++i) {
+    pages_[i].~Page();
+  }
+  ::operator delete(pages_);
+  munmap(page_data_, page_data_size_);
 }
 
-bool BufferPoolManager::allPinned() {
-  for (size_t fid = 0; fid < this->pool_size_; fid++) {
-    auto page = GetPages() + fid;
-    if (page->pin_count_ <= 0) {
+char *BufferPoolManager::mapPageData(size_t size, size_t *mapped_size) {
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+  if (options_.use_huge_pages_) {
+    // Reserved huge pages come whole, and only if the administrator set some aside. They are claimed right away, since
+    // without MAP_NORESERVE a shortage fails here rather than with SIGBUS on the first touch.
+    *mapped_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void *data = mmap(nullptr, *mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED) {
+      return static_cast<char *>(data);
+    }
+    // Transparent huge pages only back ranges that are aligned to a huge page, so map one more and cut off the ends.
+    void *reserved = mmap(nullptr, *mapped_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (reserved == MAP_FAILED) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "cannot reserve memory for the buffer pool");
+    }
+    auto begin = reinterpret_cast<uintptr_t>(reserved);
+    auto aligned = (begin + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (aligned > begin) {
+      munmap(reserved, aligned - begin);
+    }
+    munmap(reinterpret_cast<char *>(aligned) + *mapped_size, begin + HUGE_PAGE_SIZE - aligned);
+    madvise(reinterpret_cast<char *>(aligned), *mapped_size, MADV_HUGEPAGE);
+    return reinterpret_cast<char *>(aligned);
+  }
+  *mapped_size = size;
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (data == MAP_FAILED) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "cannot reserve memory for the buffer pool");
+  }
+  return static_cast<char *>(data);
+}
+
+bool BufferPoolManager::Resize(size_t pool_size, std::chrono::milliseconds timeout) {
+  BUSTUB_ASSERT(pool_size >= instances_.size() && pool_size <= max_pool_size_,
+                "The buffer pool can only be resized within its limits.");
+  std::lock_guard<std::mutex> lock(resize_latch_);
+  auto old_pool_size = pool_size_.load();
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    if (!instances_[i]->Resize(InstanceSize(pool_size, i), deadline)) {
+      // Give the instances that did shrink their frames back, so that the frames in use stay a prefix of pages_.
+      for (size_t j = 0; j < i; ++j) {
+        instances_[j]->Resize(InstanceSize(old_pool_size, j), deadline);
+      }
       return false;
-      break;
     }
   }
+  if (pool_size < old_pool_size) {
+    // The frames that went away are free, so the memory behind them can be dropped. Should the pool grow again, the
+    // operating system hands out zeroed memory on the first touch.
+    // Huge pages are only dropped whole, but frames are reset before they are used again anyway.
+    madvise(page_data_ + pool_size * PAGE_SIZE, (old_pool_size - pool_size) * PAGE_SIZE, MADV_DONTNEED);
+  }
+  pool_size_ = pool_size;
   return true;
 }
 
-frame_id_t BufferPoolManager::victimPage() {
-  frame_id_t frame_id;
-  if (!free_list_.empty()) {
-    frame_id = free_list_.front();
-    free_list_.pop_front();
-    return frame_id;
-  }
-  if (!replacer_->Victim(&frame_id)) {
-    return -1;
-  }
-  auto page = GetPages() + frame_id;
-  LOG_DEBUG("Page id %d, is dirty %d", page->page_id_, page->IsDirty());
-  page_table_.erase(page->GetPageId());
-  if (page->IsDirty()) {
-    LOG_DEBUG("Page %d is dirty, writing", page->GetPageId());
-    disk_manager_->WritePage(page->GetPageId(), page->GetData());
-  }
-  return frame_id;
-}
-
-Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
-  // 1.     Search the page table for the requested page (P).
-  // 1.1    If P exists, pin it and return it immediately.
-  // 1.2    If P does not exist, find a replacement page (R) from either the free list or the replacer.
-  //        Note that pages are always found from the free list first.
-  // 2.     If R is dirty, write it back to the disk.
-  // 3.     Delete R from the page table and insert P.
-  // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
-  std::lock_guard<std::mutex> lock(this->latch_);
-  if (this->allPinned()) return nullptr;
-  auto iterator = page_table_.find(page_id);
-  // step 1.1.
-  if (iterator != page_table_.end()) {
-    // page_id found
-    replacer_->Pin(iterator->second);
-    return GetPages() + iterator->second;
-  }
-  // step 2. (includes step 1.2.)
-  auto frame_id = this->victimPage();
-  if (frame_id < 0) return nullptr;
-  auto page = GetPages() + frame_id;
-  // step 3.
-  page_table_.insert({page_id, frame_id});
-  // step 4.
-  page->page_id_ = page_id;
-  page->ResetMemory();
-  page->pin_count_ = 1;
-  page->is_dirty_ = false;
-  disk_manager_->ReadPage(page_id, page->GetData());
+Page *BufferPoolManager::FetchPageImpl(page_id_t page_id, const AccessContext &context) {
+  if (page_id == INVALID_PAGE_ID) {
+    return nullptr;
+  }
+  // Reading ahead is nobody's wait, so it is left out of the latencies.
+  if (context.prefetch_ || !metrics_.SampleLatency()) {
+    return GetInstance(page_id)->FetchPage(page_id, context);
+  }
+  auto start = std::chrono::steady_clock::now();
+  auto page = GetInstance(page_id)->FetchPage(page_id, context);
+  metrics_.RecordFetchLatency(
+      page_id % instances_.size(),
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+  return page;
+}
+
+Page *BufferPoolManager::FetchPage(page_id_t page_id, SwizzledPageRef *ref, const AccessContext &context) {
+  if (!options_.enable_pointer_swizzling_) {
+    return FetchPageImpl(page_id, context);
+  }
+  auto page = ref->frame_.load(std::memory_order_relaxed);
+  if (page != nullptr && GetInstance(page_id)->PinSwizzled(page, page_id, context)) {
+    return page;
+  }
+  page = FetchPageImpl(page_id, context);
+  ref->frame_.store(page, std::memory_order_relaxed);
   return page;
 }
 
+std::vector<Page *> BufferPoolManager::FetchPages(const std::vector<page_id_t> &page_ids, const AccessContext &context) {
+  std::vector<std::vector<page_id_t>> instance_page_ids(instances_.size());
+  for (auto page_id : page_ids) {
+    if (page_id != INVALID_PAGE_ID) {
+      instance_page_ids[page_id % instances_.size()].push_back(page_id);
+    }
+  }
+  // As in FlushAllPagesImpl(), adjacent pages live in different instances, so only a single read for all the
+  // instances turns them into sequential I/O.
+  std::vector<std::vector<Page *>> instance_pages(instances_.size());
+  std::vector<std::vector<std::pair<page_id_t, char *>>> instance_reads(instances_.size());
+  std::vector<std::pair<page_id_t, char *>> reads;
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    instances_[i]->StartFetch(instance_page_ids[i], context, &instance_pages[i], &instance_reads[i]);
+    reads.insert(reads.end(), instance_reads[i].begin(), instance_reads[i].end());
+  }
+  disk_manager_->ReadPages(std::move(reads));
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    instances_[i]->FinishFetch(instance_reads[i]);
+  }
+  // Only wait for the pages that others are reading once our own reads are open to everyone, or two batches that
+  // wait for each other's pages would never finish.
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    instances_[i]->WaitForReads(instance_pages[i]);
+  }
+
+  std::vector<Page *> pages;
+  pages.reserve(page_ids.size());
+  std::vector<size_t> next(instances_.size(), 0);
+  for (auto page_id : page_ids) {
+    if (page_id == INVALID_PAGE_ID) {
+      pages.push_back(nullptr);
+    } else {
+      auto i = page_id % instances_.size();
+      pages.push_back(instance_pages[i][next[i]++]);
+    }
+  }
+  return pages;
+}
+
 bool BufferPoolManager::UnpinPageImpl(page_id_t page_id, bool is_dirty) {
-  std::lock_guard<std::mutex> lock(this->latch_);
-  auto iterator = page_table_.find(page_id);
-  if (iterator == page_table_.end()) {
+  if (page_id == INVALID_PAGE_ID) {
     return false;
   }
-  auto page = GetPages() + iterator->second;
-  page->pin_count_--;
-  if (page->pin_count_ <= 0) {
-    replacer_->Unpin(iterator->second);
-  }
-  page->is_dirty_ |= is_dirty;
-  return true;
+  return GetInstance(page_id)->UnpinPage(page_id, is_dirty);
 }
 
 bool BufferPoolManager::FlushPageImpl(page_id_t page_id) {
-  // Make sure you call DiskManager::WritePage!
-  std::lock_guard<std::mutex> lock(this->latch_);
-  auto iterator = page_table_.find(page_id);
-  if (iterator == page_table_.end()) {
+  if (page_id == INVALID_PAGE_ID) {
     return false;
   }
-  auto page = GetPages() + iterator->second;
-  disk_manager_->WritePage(page_id, page->GetData());
-  page->is_dirty_ = false;
-  return true;
+  return GetInstance(page_id)->FlushPage(page_id);
 }
 
-Page *BufferPoolManager::NewPageImpl(page_id_t *page_id) {
-  // 0.   Make sure you call DiskManager::AllocatePage!
-  // 1.   If all the pages in the buffer pool are pinned, return nullptr.
-  // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
-  // 3.   Update P's metadata, zero out memory and add P to the page table.
-  // 4.   Set the page ID output parameter. Return a pointer to P.
-  std::lock_guard<std::mutex> lock(this->latch_);
-  // step 1.
-  if (this->allPinned()) return nullptr;
-  // step 2.
-  auto frame_id = this->victimPage();
-  if (frame_id < 0) return nullptr;
-  auto page = GetPages() + frame_id;
-  LOG_DEBUG("Frame to be victimized %d", frame_id);
-  // step 3.
-  page->page_id_ = disk_manager_->AllocatePage();
-  page->ResetMemory();
-  page->pin_count_ = 1;
-  page->is_dirty_ = false;
-  // step 4.
-  page_table_.insert({page->page_id_, frame_id});
-  *page_id = page->page_id_;
+Page *BufferPoolManager::NewPageImpl(page_id_t *page_id, const AccessContext &context) {
+  bool timed = metrics_.SampleLatency();
+  std::chrono::steady_clock::time_point start;
+  if (timed) {
+    start = std::chrono::steady_clock::now();
+  }
+
+  // The page id decides which instance the page lives in, so it has to be allocated before a frame can be found.
+  // If the owning instance is full, allocate another id, until every instance has been tried: consecutive ids map to
+  // consecutive instances, and the ids of an extent are consecutive as well. Ids that could not be used are given
+  // back at the end, so that they are not handed out again while we are still looking.
+  std::vector<page_id_t> unused_page_ids;
+  std::vector<bool> tried(instances_.size(), false);
+  size_t num_tried = 0;
+  Page *page = nullptr;
+  page_id_t new_page_id = INVALID_PAGE_ID;
+  while (page == nullptr && num_tried < instances_.size()) {
+    new_page_id = allocatePageId(context, tried);
+    auto instance_index = new_page_id % instances_.size();
+    if (!tried[instance_index]) {
+      tried[instance_index] = true;
+      num_tried++;
+      page = instances_[instance_index]->NewPage(new_page_id, context);
+    }
+    if (page == nullptr) {
+      unused_page_ids.push_back(new_page_id);
+    } else {
+      *page_id = new_page_id;
+    }
+  }
+  releasePageIds(context, unused_page_ids);
+  if (timed) {
+    // A failure is charged to the instance that was tried last.
+    metrics_.RecordNewPageLatency(
+        new_page_id % instances_.size(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+  }
   return page;
 }
 
+page_id_t BufferPoolManager::allocatePageId(const AccessContext &context, const std::vector<bool> &tried) {
+  if (extents_.empty() || context.owner_ == NO_OWNER || context.owner_ >= extents_.size()) {
+    return disk_manager_->AllocatePage();
+  }
+  std::lock_guard<std::mutex> guard(extents_latch_);
+  auto &extent = extents_[context.owner_];
+  for (auto it = extent.given_back_.begin(); it != extent.given_back_.end(); ++it) {
+    auto page_id = *it;
+    if (!tried[page_id % instances_.size()]) {
+      extent.given_back_.erase(it);
+      return page_id;
+    }
+  }
+  if (extent.next_ == extent.end_) {
+    extent.next_ = disk_manager_->AllocateExtent(options_.extent_size_);
+    extent.end_ = extent.next_ + static_cast<page_id_t>(options_.extent_size_);
+  }
+  return extent.next_++;
+}
+
+void BufferPoolManager::releasePageIds(const AccessContext &context, const std::vector<page_id_t> &page_ids) {
+  if (page_ids.empty()) {
+    return;
+  }
+  if (extents_.empty() || context.owner_ == NO_OWNER || context.owner_ >= extents_.size()) {
+    for (auto page_id : page_ids) {
+      disk_manager_->DeallocatePage(page_id);
+    }
+    return;
+  }
+  std::lock_guard<std::mutex> guard(extents_latch_);
+  auto &given_back = extents_[context.owner_].given_back_;
+  given_back.insert(given_back.end(), page_ids.begin(), page_ids.end());
+  std::sort(given_back.begin(), given_back.end());
+}
+
 bool BufferPoolManager::DeletePageImpl(page_id_t page_id) {
-  // 0.   Make sure you call DiskManager::DeallocatePage!
-  // 1.   Search the page table for the requested page (P).
-  // 1.   If P does not exist, return true.
-  // 2.   If P exists, but has a non-zero pin-count, return false. Someone is using the page.
-  // 3.   Otherwise, P can be deleted. Remove P from the page table, reset its metadata and return it to the free list.
-  std::lock_guard<std::mutex> lock(this->latch_);
-  // step 1.
-  auto iterator = page_table_.find(page_id);
-  if (iterator == page_table_.end()) {
-    // step 1.
+  if (page_id == INVALID_PAGE_ID) {
     return true;
   }
-  // step 2.
-  auto page = GetPages() + iterator->second;
-  if (page->GetPinCount() > 0) {
-    // step 2.
+  return GetInstance(page_id)->DeletePage(page_id);
+}
+
+void BufferPoolManager::FlushAllPagesImpl() {
+  // Collect the dirty pages of all the instances first. Adjacent pages live in different instances, so only a single
+  // batch lets the disk manager merge them into long sequential writes.
+  std::vector<std::vector<std::pair<page_id_t, const char *>>> dirty_pages(instances_.size());
+  std::vector<std::pair<page_id_t, const char *>> writes;
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    instances_[i]->StartWriteBack(&dirty_pages[i]);
+    writes.insert(writes.end(), dirty_pages[i].begin(), dirty_pages[i].end());
+  }
+  disk_manager_->WritePages(std::move(writes), true);
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    instances_[i]->FinishWriteBack(dirty_pages[i]);
+  }
+}
+
+namespace {
+
+/** Identifies a warm start file. */
+constexpr uint32_t WARM_START_MAGIC = 0x5741524D;
+
+}  // namespace
+
+bool BufferPoolManager::SaveResidentPages(const std::string &file_name) {
+  // Every instance ranks its own pages. Merge the rankings by relative position, so that the hottest pages of all the
+  // instances come first, whatever the number of pages in each instance.
+  std::vector<std::pair<double, page_id_t>> ranked_pages;
+  for (auto instance : instances_) {
+    auto page_ids = instance->ResidentPages();
+    for (size_t rank = 0; rank < page_ids.size(); rank++) {
+      ranked_pages.emplace_back(static_cast<double>(rank) / page_ids.size(), page_ids[rank]);
+    }
+  }
+  std::stable_sort(ranked_pages.begin(), ranked_pages.end(),
+                   [](const auto &a, const auto &b) { return a.first < b.first; });
+  std::vector<page_id_t> page_ids;
+  page_ids.reserve(ranked_pages.size());
+  for (const auto &entry : ranked_pages) {
+    page_ids.push_back(entry.second);
+  }
+
+  // A warm start file holds a magic number, the number of pages, and the ids of the pages, hottest first. It is
+  // written next to the old one and then renamed, so that a crash never leaves a torn file behind.
+  auto tmp_file_name = file_name + ".tmp";
+  std::ofstream out(tmp_file_name, std::ios::binary | std::ios::trunc);
+  auto num_pages = static_cast<uint32_t>(page_ids.size());
+  out.write(reinterpret_cast<const char *>(&WARM_START_MAGIC), sizeof(WARM_START_MAGIC));
+  out.write(reinterpret_cast<const char *>(&num_pages), sizeof(num_pages));
+  out.write(reinterpret_cast<const char *>(page_ids.data()), page_ids.size() * sizeof(page_id_t));
+  out.close();
+  if (!out || std::rename(tmp_file_name.c_str(), file_name.c_str()) != 0) {
+    LOG_DEBUG("cannot write warm start file %s", file_name.c_str());
+    std::remove(tmp_file_name.c_str());
     return false;
   }
-  // step 3.
-  page->ResetMemory();
-  this->free_list_.push_back(iterator->second);
-  page_table_.erase(iterator);
-  // step 0.
-  this->disk_manager_->DeallocatePage(page_id);
   return true;
 }
 
-void BufferPoolManager::FlushAllPagesImpl() {
-  // You can do it!
+size_t BufferPoolManager::LoadResidentPages(const std::string &file_name) {
+  std::ifstream in(file_name, std::ios::binary);
+  uint32_t magic = 0;
+  uint32_t num_pages = 0;
+  in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  in.read(reinterpret_cast<char *>(&num_pages), sizeof(num_pages));
+  if (!in || magic != WARM_START_MAGIC) {
+    return 0;
+  }
+  // The count comes from a file that may be damaged, so it is checked against the size of the file before anything is
+  // allocated for it. Only the hottest pages can fit into the buffer pool anyway.
+  auto header_end = in.tellg();
+  in.seekg(0, std::ios::end);
+  auto file_size = in.tellg();
+  if (!in || static_cast<uint64_t>(file_size - header_end) != static_cast<uint64_t>(num_pages) * sizeof(page_id_t)) {
+    LOG_DEBUG("warm start file %s is damaged", file_name.c_str());
+    return 0;
+  }
+  in.seekg(header_end);
+  std::vector<page_id_t> saved_page_ids(std::min<size_t>(num_pages, max_pool_size_));
+  in.read(reinterpret_cast<char *>(saved_page_ids.data()), saved_page_ids.size() * sizeof(page_id_t));
+  if (!in) {
+    return 0;
+  }
+
+  // Skip the pages that are not in the database file (anymore), and those that would not fit into the buffer pool
+  // anyway: they would only take the place of hotter ones.
+  auto num_disk_pages = disk_manager_->GetNumPages();
+  std::vector<page_id_t> page_ids;
+  for (auto page_id : saved_page_ids) {
+    if (page_ids.size() >= pool_size_) {
+      break;
+    }
+    if (page_id >= 0 && static_cast<size_t>(page_id) < num_disk_pages) {
+      page_ids.push_back(page_id);
+    }
+  }
+
+  size_t num_loaded = 0;
+  for (size_t begin = 0; begin < page_ids.size() && !stop_loading_; begin += WARM_START_BATCH_SIZE) {
+    auto end = std::min(page_ids.size(), begin + WARM_START_BATCH_SIZE);
+    std::vector<std::vector<page_id_t>> instance_page_ids(instances_.size());
+    for (auto i = begin; i < end; i++) {
+      instance_page_ids[page_ids[i] % instances_.size()].push_back(page_ids[i]);
+    }
+    // As in FlushAllPagesImpl(), adjacent pages live in different instances, so only a single read for all the
+    // instances turns them into sequential I/O.
+    std::vector<std::vector<std::pair<page_id_t, char *>>> instance_reads(instances_.size());
+    std::vector<std::pair<page_id_t, char *>> reads;
+    for (size_t i = 0; i < instances_.size(); ++i) {
+      instances_[i]->StartLoad(instance_page_ids[i], &instance_reads[i]);
+      reads.insert(reads.end(), instance_reads[i].begin(), instance_reads[i].end());
+    }
+    disk_manager_->ReadPages(reads);
+    for (size_t i = 0; i < instances_.size(); ++i) {
+      instances_[i]->FinishLoad(instance_reads[i]);
+    }
+    num_loaded += reads.size();
+  }
+  return num_loaded;
+}
+
+void BufferPoolManager::PrefetchPages(const std::vector<page_id_t> &page_ids, const AccessContext &context) {
+  for (auto page_id : page_ids) {
+    PrefetchPageChain(page_id, 1, nullptr, context);
+  }
+}
+
+void BufferPoolManager::PrefetchPageChain(page_id_t page_id, size_t num_pages,
+                                          const std::function<page_id_t(Page *)> &next_page_id,
+                                          const AccessContext &context) {
+  if (page_id == INVALID_PAGE_ID || num_pages == 0) {
+    return;
+  }
+  std::unique_ptr<BufferAccessStrategy> strategy;
+  if (context.strategy_ != nullptr) {
+    strategy = std::make_unique<BufferAccessStrategy>(*context.strategy_);
+  }
+  enqueuePrefetch({page_id, num_pages, next_page_id, std::move(strategy), context.category_, context.owner_});
+}
+
+void BufferPoolManager::enqueuePrefetch(PrefetchRequest request) {
+  {
+    std::lock_guard<std::mutex> lock(prefetch_latch_);
+    if (stop_prefetching_ || prefetch_queue_.size() >= static_cast<size_t>(PREFETCH_QUEUE_SIZE)) {
+      return;
+    }
+    if (prefetch_thread_ == nullptr) {
+      prefetch_thread_ = new std::thread(&BufferPoolManager::runPrefetchThread, this);
+    }
+    prefetch_queue_.push_back(std::move(request));
+  }
+  prefetch_cv_.notify_one();
+}
+
+void BufferPoolManager::runPrefetchThread() {
+  std::unique_lock<std::mutex> lock(prefetch_latch_);
+  while (true) {
+    prefetch_cv_.wait(lock, [this] { return stop_prefetching_ || !prefetch_queue_.empty(); });
+    if (stop_prefetching_) {
+      return;
+    }
+    auto request = std::move(prefetch_queue_.front());
+    prefetch_queue_.pop_front();
+    lock.unlock();
+
+    AccessContext context{request.strategy_.get(), true, request.category_, request.owner_};
+    auto page_id = request.page_id_;
+    for (size_t i = 0; i < request.num_pages_ && page_id != INVALID_PAGE_ID; i++) {
+      auto page = FetchPageImpl(page_id, context);
+      if (page == nullptr) {
+        // Every frame is pinned. The pages will be read when they are needed.
+        break;
+      }
+      auto next_page_id = INVALID_PAGE_ID;
+      if (request.next_page_id_ && i + 1 < request.num_pages_) {
+        page->RLatch();
+        next_page_id = request.next_page_id_(page);
+        page->RUnlatch();
+      }
+      UnpinPageImpl(page_id, false);
+      page_id = next_page_id;
+    }
+
+    lock.lock();
+  }
+}
+
+void BufferPoolManager::runPageCleanerThread() {
+  std::unique_lock<std::mutex> lock(cleaner_latch_);
+  while (!cleaner_cv_.wait_for(lock, options_.page_cleaner_interval_, [this] { return stop_cleaning_; })) {
+    lock.unlock();
+    for (auto instance : instances_) {
+      instance->CleanPages(options_.page_cleaner_lookahead_, options_.page_cleaner_max_dirty_ratio_);
+    }
+    lock.lock();
+  }
+}
+
+BufferPoolStats BufferPoolManager::GetStats() {
+  BufferPoolStats stats;
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    stats += metrics_.GetStats(i);
+  }
+  return stats;
+}
+
+owner_id_t BufferPoolManager::RegisterOwner(const std::string &name) {
+  std::lock_guard<std::mutex> lock(owners_latch_);
+  auto iterator = owner_ids_.find(name);
+  if (iterator != owner_ids_.end()) {
+    return iterator->second;
+  }
+  if (owner_names_.size() >= options_.max_owners_) {
+    LOG_WARN("No room for owner %s, its pages are not accounted for separately", name.c_str());
+    return NO_OWNER;
+  }
+  auto owner_id = static_cast<owner_id_t>(owner_names_.size());
+  owner_names_.push_back(name);
+  owner_quotas_.push_back(0);
+  owner_ids_[name] = owner_id;
+  return owner_id;
+}
+
+void BufferPoolManager::SetOwnerQuota(owner_id_t owner_id, double quota) {
+  BUSTUB_ASSERT(quota >= 0 && quota <= 1, "A quota is a fraction of the buffer pool.");
+  std::lock_guard<std::mutex> lock(owners_latch_);
+  BUSTUB_ASSERT(owner_id < owner_names_.size(), "Owner ids come from RegisterOwner().");
+  owner_quotas_[owner_id] = quota;
+  // The pages of an owner are spread evenly over the instances, and so is its quota.
+  for (auto instance : instances_) {
+    instance->SetOwnerQuota(owner_id, quota);
+  }
+}
+
+void BufferPoolManager::ReleaseExtents() {
+  std::lock_guard<std::mutex> guard(extents_latch_);
+  for (auto &extent : extents_) {
+    for (auto page_id : extent.given_back_) {
+      disk_manager_->DeallocatePage(page_id);
+    }
+    for (auto page_id = extent.next_; page_id < extent.end_; page_id++) {
+      disk_manager_->DeallocatePage(page_id);
+    }
+    extent = Extent();
+  }
+}
+
+std::vector<BufferOwnerStats> BufferPoolManager::GetOwnerStats() {
+  std::vector<BufferOwnerStats> stats;
+  {
+    std::lock_guard<std::mutex> lock(owners_latch_);
+    for (size_t i = 0; i < owner_names_.size(); ++i) {
+      stats.emplace_back();
+      stats.back().owner_id_ = static_cast<owner_id_t>(i);
+      stats.back().name_ = owner_names_[i];
+      stats.back().quota_ = owner_quotas_[i];
+    }
+  }
+  for (auto instance : instances_) {
+    instance->AddOwnerStats(&stats);
+  }
+  metrics_.AddOwnerStats(&stats);
+  return stats;
+}
+
+std::string BufferPoolManager::DumpMetrics() {
+  auto metrics = GetStats().ToString() + OwnerStatsToString(GetOwnerStats()) +
+                 "# TYPE bustub_buffer_pool_size gauge\nbustub_buffer_pool_size " + std::to_string(pool_size_) + "\n";
+  if (compressed_cache_ != nullptr) {
+    metrics += compressed_cache_->GetStats().ToString();
+  }
+  return metrics;
 }
 
 }  // namespace bustub
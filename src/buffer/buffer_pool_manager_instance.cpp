@@ -0,0 +1,853 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_manager_instance.cpp
+//
+// Identification: src/buffer/buffer_pool_manager_instance.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_pool_manager_instance.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "buffer/clock_replacer.h"
+#include "buffer/lru_k_replacer.h"
+#include "common/logger.h"
+
+namespace bustub {
+
+BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, size_t max_pool_size, size_t num_instances,
+                                                     size_t instance_index, Page *pages, BufferPoolMetrics *metrics,
+                                                     CompressedPageCache *cache, DiskManager *disk_manager,
+                                                     LogManager *log_manager, const BufferPoolOptions &options)
+    : pool_size_(pool_size),
+      usable_frames_(pool_size),
+      max_pool_size_(max_pool_size),
+      num_instances_(num_instances),
+      instance_index_(instance_index),
+      pages_(pages),
+      metrics_(metrics),
+      cache_(cache),
+      disk_manager_(disk_manager),
+      log_manager_(log_manager),
+      page_table_(max_pool_size),
+      frame_owners_(max_pool_size),
+      owners_(options.max_owners_) {
+  switch (options.replacer_type_) {
+    case ReplacerType::CLOCK:
+      replacer_ = new ClockReplacer(max_pool_size);
+      break;
+    case ReplacerType::LRU_K:
+      replacer_ = new LRUKReplacer(max_pool_size, options.lru_k_, options.lru_k_correlated_reference_period_);
+      break;
+  }
+
+  // Initially, every frame is in the free list.
+  for (size_t i = 0; i < max_pool_size_; ++i) {
+    GetFrame(i)->pin_count_ = -1;
+  }
+  for (size_t i = 0; i < pool_size_; ++i) {
+    free_list_.emplace_back(static_cast<frame_id_t>(i));
+  }
+}
+
+BufferPoolManagerInstance::~BufferPoolManagerInstance() { delete replacer_; }
+
+void BufferPoolManagerInstance::unpinFrame(frame_id_t frame_id) {
+  if (GetFrame(frame_id)->pin_count_.fetch_sub(1) == 1) {
+    frameUnpinned(frame_id, false);
+  }
+}
+
+void BufferPoolManagerInstance::releaseFrame(frame_id_t frame_id) {
+  if (GetFrame(frame_id)->pin_count_.fetch_sub(1) == 1) {
+    frameUnpinned(frame_id, true);
+  }
+}
+
+void BufferPoolManagerInstance::frameUnpinned(frame_id_t frame_id, bool release) {
+  auto page = GetFrame(frame_id);
+  bool pinned = false;
+  while (true) {
+    if (pinned) {
+      replacer_->Pin(frame_id);
+    } else if (release) {
+      replacer_->Release(frame_id);
+    } else {
+      replacer_->Unpin(frame_id);
+    }
+    // Whoever pins the frame tells the replacer before it can unpin it again, so if the pin count still agrees with
+    // what we told the replacer, nobody can tell it otherwise after us. A claimed frame is up to whoever claimed it.
+    auto pin_count = page->pin_count_.load();
+    if (pin_count < 0 || (pin_count > 0) == pinned) {
+      return;
+    }
+    pinned = pin_count > 0;
+  }
+}
+
+frame_id_t BufferPoolManagerInstance::pinResident(page_id_t page_id) {
+  auto frame_id = page_table_.Find(page_id);
+  if (frame_id < 0 || !pinFrame(frame_id, page_id)) {
+    return -1;
+  }
+  return frame_id;
+}
+
+bool BufferPoolManagerInstance::pinFrame(frame_id_t frame_id, page_id_t page_id) {
+  auto page = GetFrame(frame_id);
+  auto pin_count = page->pin_count_.load();
+  do {
+    if (pin_count < 0) {
+      return false;
+    }
+  } while (!page->pin_count_.compare_exchange_weak(pin_count, pin_count + 1));
+  // The frame may have been handed to another page since the page was found in it. Our pin keeps it from changing
+  // hands again, so if it still holds our page now, it will until we unpin it.
+  if (page->page_id_ != page_id) {
+    releaseFrame(frame_id);
+    return false;
+  }
+  return true;
+}
+
+bool BufferPoolManagerInstance::PinSwizzled(Page *page, page_id_t page_id, const AccessContext &context) {
+  auto frame_id = static_cast<frame_id_t>((page - pages_ - instance_index_) / num_instances_);
+  if (!pinFrame(frame_id, page_id)) {
+    return false;
+  }
+  hitFrame(frame_id, context);
+  return true;
+}
+
+Page *BufferPoolManagerInstance::hitFrame(frame_id_t frame_id, const AccessContext &context) {
+  auto page = GetFrame(frame_id);
+  recordHit(frame_id, context);
+  // P may still be on its way in from disk. Our pin keeps the frame from being reused while we wait for it.
+  waitForRead(page);
+  return page;
+}
+
+Page *BufferPoolManagerInstance::pinLatched(frame_id_t frame_id, const AccessContext &context) {
+  // Under the latch, a frame in the page table is never claimed, so it can be pinned right away.
+  auto page = GetFrame(frame_id);
+  page->pin_count_.fetch_add(1);
+  recordHit(frame_id, context);
+  return page;
+}
+
+void BufferPoolManagerInstance::recordHit(frame_id_t frame_id, const AccessContext &context) {
+  replacer_->Pin(frame_id);
+  replacer_->SetRetentionClass(frame_id, context.retention_);
+  if (!context.prefetch_) {
+    replacer_->RecordAccess(frame_id);
+    metrics_->RecordHit(instance_index_, context);
+  }
+}
+
+void BufferPoolManagerInstance::recordMiss(frame_id_t frame_id, page_id_t page_id, const AccessContext &context) {
+  replacer_->SetRetentionClass(frame_id, context.retention_);
+  // A page that is read ahead is only referenced once it is actually fetched.
+  if (context.prefetch_) {
+    metrics_->RecordPrefetches(instance_index_, 1);
+  } else {
+    metrics_->RecordMiss(instance_index_, context);
+    replacer_->RecordAccess(frame_id);
+  }
+  if (context.strategy_ != nullptr) {
+    addToRing(context.strategy_, frame_id, page_id);
+  }
+}
+
+Page *BufferPoolManagerInstance::startRead(frame_id_t frame_id, page_id_t page_id, owner_id_t owner_id) {
+  // The pin count goes last: it opens the frame to fetches that do not take the latch.
+  auto page = GetFrame(frame_id);
+  page->page_id_ = page_id;
+  page->is_dirty_ = false;
+  page->io_in_progress_ = true;
+  page_table_.Insert(page_id, frame_id);
+  addOwnerFrame(frame_id, owner_id);
+  page->pin_count_ = 1;
+  return page;
+}
+
+BufferPoolManagerInstance::EvictedPage BufferPoolManagerInstance::reserveEvicted(frame_id_t frame_id) {
+  EvictedPage evicted;
+  // Only an evicted frame still carries the id of its page; free frames have none.
+  page_id_t page_id = GetFrame(frame_id)->page_id_;
+  if (cache_ != nullptr && page_id != INVALID_PAGE_ID) {
+    evicted.page_id_ = page_id;
+    evicted.ticket_ = cache_->Reserve(page_id);
+  }
+  return evicted;
+}
+
+void BufferPoolManagerInstance::cacheEvicted(const EvictedPage &evicted, const char *data) {
+  if (evicted.page_id_ != INVALID_PAGE_ID) {
+    cache_->Put(evicted.page_id_, evicted.ticket_, data);
+  }
+}
+
+void BufferPoolManagerInstance::readPage(Page *page, const std::string *compressed) {
+  if (compressed != nullptr && CompressedPageCache::Restore(*compressed, page->GetData())) {
+    return;
+  }
+  page->ResetMemory();
+  disk_manager_->ReadPage(page->page_id_, page->GetData());
+}
+
+void BufferPoolManagerInstance::waitForRead(Page *page) {
+  if (!page->io_in_progress_) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(latch_);
+  io_cv_.wait(lock, [page] { return !page->io_in_progress_; });
+  lock.unlock();
+  auto waited = std::chrono::steady_clock::now() - start;
+  metrics_->RecordPinWait(instance_index_, std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+}
+
+void BufferPoolManagerInstance::writeBack(const std::vector<std::pair<page_id_t, frame_id_t>> &pages,
+                                          std::unique_lock<std::mutex> *lock) {
+  // The dirty flag is cleared before writing, so that changes made while the write is in flight are not lost.
+  std::vector<std::pair<page_id_t, const char *>> writes;
+  for (const auto &entry : pages) {
+    auto page = GetFrame(entry.second);
+    page->pin_count_.fetch_add(1);
+    replacer_->Pin(entry.second);
+    page->is_dirty_ = false;
+    writes.emplace_back(entry.first, page->GetData());
+  }
+  lock->unlock();
+  disk_manager_->WritePages(std::move(writes), false);
+  lock->lock();
+  for (const auto &entry : pages) {
+    releaseFrame(entry.second);
+  }
+  metrics_->RecordWriteBacks(instance_index_, pages.size());
+}
+
+frame_id_t BufferPoolManagerInstance::victimPage(const AccessContext &context, std::unique_lock<std::mutex> *lock) {
+  frame_id_t frame_id;
+  if (context.strategy_ != nullptr) {
+    frame_id = ringVictim(context.strategy_, lock);
+    if (frame_id >= 0) {
+      return frame_id;
+    }
+  }
+  frame_id = quotaVictim(context.owner_, lock);
+  if (frame_id >= 0) {
+    return frame_id;
+  }
+  while (true) {
+    if (!free_list_.empty()) {
+      frame_id = free_list_.front();
+      free_list_.pop_front();
+      return frame_id;
+    }
+    if (!replacer_->Victim(&frame_id)) {
+      return -1;
+    }
+    if (evictFrame(frame_id, lock)) {
+      if (static_cast<size_t>(frame_id) < usable_frames_) {
+        return frame_id;
+      }
+      // The frame is going away, and its page is gone now, which is all the shrink was waiting for.
+      GetFrame(frame_id)->page_id_ = INVALID_PAGE_ID;
+    }
+  }
+}
+
+bool BufferPoolManagerInstance::evictFrame(frame_id_t frame_id, std::unique_lock<std::mutex> *lock) {
+  auto page = GetFrame(frame_id);
+  auto page_id = page->GetPageId();
+  // Claim the frame, so that it can no longer be pinned without the latch. This fails if a fetch pinned the page
+  // after the replacer picked it, in which case the page is in use again.
+  int pin_count = 0;
+  if (!page->pin_count_.compare_exchange_strong(pin_count, -1)) {
+    return false;
+  }
+  LOG_DEBUG("Page id %d, is dirty %d", page_id, page->IsDirty());
+  if (!page->IsDirty()) {
+    page_table_.Erase(page_id);
+    metrics_->RecordEviction(instance_index_, frame_owners_[frame_id].owner_id_);
+    removeOwnerFrame(frame_id);
+    return true;
+  }
+  // Write the page back with the latch released. The claim turns into a pin that keeps the frame from being picked
+  // again, while the page stays in the page table so that anyone who needs it meanwhile finds it resident.
+  LOG_DEBUG("Page %d is dirty, writing", page_id);
+  page->pin_count_ = 1;
+  page->is_dirty_ = false;
+  lock->unlock();
+  disk_manager_->WritePage(page_id, page->GetData());
+  lock->lock();
+  metrics_->RecordWriteBacks(instance_index_, 1);
+  // The dirty flag can only be trusted once the frame is claimed again: unpinning marks the page dirty first and only
+  // then drops the pin, without the latch.
+  pin_count = 1;
+  if (page->pin_count_.compare_exchange_strong(pin_count, -1)) {
+    if (!page->IsDirty()) {
+      page_table_.Erase(page_id);
+      metrics_->RecordEviction(instance_index_, frame_owners_[frame_id].owner_id_);
+      removeOwnerFrame(frame_id);
+      return true;
+    }
+    page->pin_count_ = 1;
+  }
+  // Somebody started using the page again while it was being written, so leave it be and look for another victim.
+  unpinFrame(frame_id);
+  return false;
+}
+
+size_t BufferPoolManagerInstance::ringCapacity(const BufferAccessStrategy *strategy) const {
+  // Every instance gets its share of the ring, but never so much of its frames that the ring itself would push out
+  // the working set. Two frames are enough for a scan that pins the next page before unpinning the current one.
+  size_t share = (strategy->ring_size_ + num_instances_ - 1) / num_instances_;
+  size_t pool_size = pool_size_;
+  return std::min({share, std::max<size_t>(pool_size / 4, 2), pool_size});
+}
+
+frame_id_t BufferPoolManagerInstance::ringVictim(BufferAccessStrategy *strategy, std::unique_lock<std::mutex> *lock) {
+  auto &ring = *strategy->GetRing(this);
+  if (ring.entries_.size() < ringCapacity(strategy)) {
+    return -1;
+  }
+  auto entry = ring.entries_[ring.next_];
+  if (static_cast<size_t>(entry.frame_id_) >= usable_frames_) {
+    return -1;
+  }
+  auto page = GetFrame(entry.frame_id_);
+  // The frame may have been evicted and reused by someone else meanwhile, or the page may be in use after all. Both
+  // mean the page is not ours to throw out.
+  if (page->page_id_ != entry.page_id_ || page->pin_count_ != 0 || page->io_in_progress_) {
+    return -1;
+  }
+  replacer_->Remove(entry.frame_id_);
+  return evictFrame(entry.frame_id_, lock) ? entry.frame_id_ : -1;
+}
+
+frame_id_t BufferPoolManagerInstance::quotaVictim(owner_id_t owner_id, std::unique_lock<std::mutex> *lock) {
+  const auto &owner = owners_[owner_id];
+  if (owner.quota_ <= 0 ||
+      owner.resident_ < std::max<size_t>(1, static_cast<size_t>(owner.quota_ * static_cast<double>(pool_size_)))) {
+    return -1;
+  }
+  // The pages the owner brought in first go first, as in a ring, except that the pages in use are passed over.
+  for (auto frame_id = owner.head_; frame_id >= 0; frame_id = frame_owners_[frame_id].next_) {
+    auto page = GetFrame(frame_id);
+    if (static_cast<size_t>(frame_id) >= usable_frames_ || page->pin_count_ != 0 || page->io_in_progress_) {
+      continue;
+    }
+    replacer_->Remove(frame_id);
+    if (!evictFrame(frame_id, lock)) {
+      // The latch was released for a write-back, so the list may have changed under our feet. Leave it to the
+      // replacer this time.
+      return -1;
+    }
+    metrics_->RecordQuotaEviction(owner_id);
+    return frame_id;
+  }
+  return -1;
+}
+
+void BufferPoolManagerInstance::addOwnerFrame(frame_id_t frame_id, owner_id_t owner_id) {
+  BUSTUB_ASSERT(owner_id < owners_.size(), "Owner ids come from RegisterOwner().");
+  auto &owner = owners_[owner_id];
+  frame_owners_[frame_id] = {owner_id, owner.tail_, -1};
+  if (owner.tail_ >= 0) {
+    frame_owners_[owner.tail_].next_ = frame_id;
+  } else {
+    owner.head_ = frame_id;
+  }
+  owner.tail_ = frame_id;
+  owner.resident_++;
+}
+
+void BufferPoolManagerInstance::removeOwnerFrame(frame_id_t frame_id) {
+  const auto &entry = frame_owners_[frame_id];
+  auto &owner = owners_[entry.owner_id_];
+  if (entry.prev_ >= 0) {
+    frame_owners_[entry.prev_].next_ = entry.next_;
+  } else {
+    owner.head_ = entry.next_;
+  }
+  if (entry.next_ >= 0) {
+    frame_owners_[entry.next_].prev_ = entry.prev_;
+  } else {
+    owner.tail_ = entry.prev_;
+  }
+  owner.resident_--;
+  frame_owners_[frame_id] = FrameOwner();
+}
+
+void BufferPoolManagerInstance::SetOwnerQuota(owner_id_t owner_id, double quota) {
+  std::lock_guard<std::mutex> lock(latch_);
+  owners_[owner_id].quota_ = quota;
+}
+
+void BufferPoolManagerInstance::ChargePage(page_id_t page_id, owner_id_t owner_id) {
+  std::lock_guard<std::mutex> lock(latch_);
+  auto frame_id = page_table_.Find(page_id);
+  if (frame_id < 0 || frame_owners_[frame_id].owner_id_ == owner_id) {
+    return;
+  }
+  removeOwnerFrame(frame_id);
+  addOwnerFrame(frame_id, owner_id);
+}
+
+void BufferPoolManagerInstance::AddOwnerStats(std::vector<BufferOwnerStats> *stats) {
+  std::lock_guard<std::mutex> lock(latch_);
+  for (auto &owner : *stats) {
+    owner.resident_frames_ += owners_[owner.owner_id_].resident_;
+  }
+}
+
+void BufferPoolManagerInstance::addToRing(BufferAccessStrategy *strategy, frame_id_t frame_id, page_id_t page_id) {
+  auto &ring = *strategy->GetRing(this);
+  auto capacity = ringCapacity(strategy);
+  if (ring.entries_.size() < capacity) {
+    ring.entries_.push_back({frame_id, page_id});
+  } else {
+    ring.entries_[ring.next_] = {frame_id, page_id};
+  }
+  ring.next_ = (ring.next_ + 1) % capacity;
+}
+
+Page *BufferPoolManagerInstance::FetchPage(page_id_t page_id, const AccessContext &context) {
+  // 1.     Search the page table for the requested page (P).
+  // 1.1    If P exists, pin it and return it immediately.
+  // 1.2    If P does not exist, find a replacement page (R) from either the free list or the replacer.
+  //        Note that pages are always found from the free list first.
+  // 2.     If R is dirty, write it back to the disk.
+  // 3.     Delete R from the page table and insert P.
+  // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
+  //
+  // Most fetches find the page resident, so step 1.1 is tried without the latch first.
+  auto frame_id = pinResident(page_id);
+  if (frame_id >= 0) {
+    return hitFrame(frame_id, context);
+  }
+  std::unique_lock<std::mutex> lock(latch_);
+  frame_id = page_table_.Find(page_id);
+  if (frame_id < 0) {
+    // step 2. (includes step 1.2.)
+    if (allPinned()) return nullptr;
+    auto victim_frame_id = victimPage(context, &lock);
+    if (victim_frame_id < 0) return nullptr;
+    // The latch may have been released while R was written back, so P may have been brought in meanwhile.
+    frame_id = page_table_.Find(page_id);
+    if (frame_id < 0) {
+      recordMiss(victim_frame_id, page_id, context);
+      // step 4. R's content stays in the frame until it is in the compressed cache, and P may come from there.
+      auto evicted = reserveEvicted(victim_frame_id);
+      std::string compressed;
+      bool cached = cache_ != nullptr && cache_->Remove(page_id, &compressed);
+      auto page = startRead(victim_frame_id, page_id, context.owner_);
+      lock.unlock();
+      cacheEvicted(evicted, page->GetData());
+      readPage(page, cached ? &compressed : nullptr);
+      lock.lock();
+      page->io_in_progress_ = false;
+      io_cv_.notify_all();
+      return page;
+    }
+    GetFrame(victim_frame_id)->page_id_ = INVALID_PAGE_ID;
+    free_list_.push_back(victim_frame_id);
+  }
+  // step 1.1.
+  auto page = pinLatched(frame_id, context);
+  lock.unlock();
+  waitForRead(page);
+  return page;
+}
+
+void BufferPoolManagerInstance::StartFetch(const std::vector<page_id_t> &page_ids, const AccessContext &context,
+                                           std::vector<Page *> *pages,
+                                           std::vector<std::pair<page_id_t, char *>> *reads) {
+  // Same as FetchPage(), except that nobody waits for a read here: the pages being read by others are waited for in
+  // WaitForReads(), once our own reads are done, and the pages that are missing are left for the caller to read.
+  // The pages found in the compressed cache are restored here rather than read by the caller.
+  std::vector<std::pair<EvictedPage, Page *>> evicted_pages;
+  std::vector<std::pair<Page *, std::string>> cached_pages;
+  std::unique_lock<std::mutex> lock(latch_);
+  for (auto page_id : page_ids) {
+    auto frame_id = page_table_.Find(page_id);
+    if (frame_id < 0) {
+      auto victim_frame_id = allPinned() ? -1 : victimPage(context, &lock);
+      if (victim_frame_id < 0) {
+        pages->push_back(nullptr);
+        continue;
+      }
+      frame_id = page_table_.Find(page_id);
+      if (frame_id < 0) {
+        recordMiss(victim_frame_id, page_id, context);
+        auto evicted = reserveEvicted(victim_frame_id);
+        std::string compressed;
+        bool cached = cache_ != nullptr && cache_->Remove(page_id, &compressed);
+        auto page = startRead(victim_frame_id, page_id, context.owner_);
+        pages->push_back(page);
+        if (evicted.page_id_ != INVALID_PAGE_ID) {
+          evicted_pages.emplace_back(evicted, page);
+        }
+        if (cached) {
+          cached_pages.emplace_back(page, std::move(compressed));
+        } else {
+          reads->emplace_back(page_id, page->GetData());
+        }
+        continue;
+      }
+      GetFrame(victim_frame_id)->page_id_ = INVALID_PAGE_ID;
+      free_list_.push_back(victim_frame_id);
+    }
+    pages->push_back(pinLatched(frame_id, context));
+  }
+  if (evicted_pages.empty() && cached_pages.empty()) {
+    return;
+  }
+  // The evicted pages have to be saved before anything overwrites their frames, including the caller's reads.
+  lock.unlock();
+  for (const auto &entry : evicted_pages) {
+    cacheEvicted(entry.first, entry.second->GetData());
+  }
+  for (const auto &entry : cached_pages) {
+    readPage(entry.first, &entry.second);
+  }
+  lock.lock();
+  for (const auto &entry : cached_pages) {
+    entry.first->io_in_progress_ = false;
+  }
+  io_cv_.notify_all();
+}
+
+void BufferPoolManagerInstance::FinishFetch(const std::vector<std::pair<page_id_t, char *>> &reads) {
+  std::lock_guard<std::mutex> lock(latch_);
+  for (const auto &entry : reads) {
+    // The pin kept the page in its frame.
+    GetFrame(page_table_.Find(entry.first))->io_in_progress_ = false;
+  }
+  io_cv_.notify_all();
+}
+
+void BufferPoolManagerInstance::WaitForReads(const std::vector<Page *> &pages) {
+  for (auto page : pages) {
+    if (page != nullptr) {
+      waitForRead(page);
+    }
+  }
+}
+
+bool BufferPoolManagerInstance::UnpinPage(page_id_t page_id, bool is_dirty) {
+  // The caller's pin keeps the page in its frame, so the latch is only needed if the lookup missed because the page
+  // table was being rearranged.
+  auto frame_id = page_table_.Find(page_id);
+  if (frame_id < 0) {
+    std::lock_guard<std::mutex> lock(latch_);
+    frame_id = page_table_.Find(page_id);
+    if (frame_id < 0) {
+      return false;
+    }
+  }
+  auto page = GetFrame(frame_id);
+  if (page->page_id_ != page_id || page->pin_count_ <= 0) {
+    return false;
+  }
+  // Mark the page dirty while it is still pinned, so that whoever evicts it finds the flag set.
+  if (is_dirty) {
+    page->is_dirty_ = true;
+  }
+  auto pin_count = page->pin_count_.load();
+  do {
+    if (pin_count <= 0) {
+      return false;
+    }
+  } while (!page->pin_count_.compare_exchange_weak(pin_count, pin_count - 1));
+  if (pin_count == 1) {
+    frameUnpinned(frame_id, false);
+  }
+  return true;
+}
+
+bool BufferPoolManagerInstance::FlushPage(page_id_t page_id) {
+  std::unique_lock<std::mutex> lock(latch_);
+  auto frame_id = page_table_.Find(page_id);
+  if (frame_id < 0) {
+    return false;
+  }
+  auto page = GetFrame(frame_id);
+  page->pin_count_.fetch_add(1);
+  replacer_->Pin(frame_id);
+  io_cv_.wait(lock, [page] { return !page->io_in_progress_; });
+  // The dirty flag is cleared before writing, so that changes made while the write is in flight are not lost.
+  page->is_dirty_ = false;
+  lock.unlock();
+  disk_manager_->WritePage(page_id, page->GetData());
+  lock.lock();
+  releaseFrame(frame_id);
+  return true;
+}
+
+Page *BufferPoolManagerInstance::NewPage(page_id_t page_id, const AccessContext &context) {
+  // 1.   If all the pages in the buffer pool are pinned, return nullptr.
+  // 2.   Pick a victim page P from either the free list or the replacer. Always pick from the free list first.
+  // 3.   Update P's metadata, zero out memory and add P to the page table.
+  std::unique_lock<std::mutex> lock(latch_);
+  // The disk manager may hand out the id of a page that is still resident from before, e.g. one that was loaded by a
+  // warm start. Its old content is of no use to anybody.
+  auto stale_frame_id = page_table_.Find(page_id);
+  if (stale_frame_id >= 0 && !dropFrame(stale_frame_id)) return nullptr;
+  // step 1.
+  if (allPinned()) return nullptr;
+  // step 2.
+  auto frame_id = victimPage(context, &lock);
+  if (frame_id < 0) return nullptr;
+  LOG_DEBUG("Frame to be victimized %d", frame_id);
+  // step 3. A page with the same id may have been cached before it was deleted, and must not come back from there.
+  auto evicted = reserveEvicted(frame_id);
+  if (cache_ != nullptr) {
+    cache_->Remove(page_id);
+  }
+  auto page = startRead(frame_id, page_id, context.owner_);
+  replacer_->SetRetentionClass(frame_id, context.retention_);
+  replacer_->RecordAccess(frame_id);
+  if (context.strategy_ != nullptr) {
+    addToRing(context.strategy_, frame_id, page_id);
+  }
+  if (evicted.page_id_ == INVALID_PAGE_ID) {
+    page->ResetMemory();
+    page->io_in_progress_ = false;
+    return page;
+  }
+  // R's content has to be saved before it is zeroed out. Anyone who fetches P meanwhile waits, as for a read.
+  lock.unlock();
+  cacheEvicted(evicted, page->GetData());
+  page->ResetMemory();
+  lock.lock();
+  page->io_in_progress_ = false;
+  io_cv_.notify_all();
+  return page;
+}
+
+bool BufferPoolManagerInstance::dropFrame(frame_id_t frame_id) {
+  // Claiming the frame checks the pin count and keeps fetches that do not take the latch away from it.
+  auto page = GetFrame(frame_id);
+  int pin_count = 0;
+  if (!page->pin_count_.compare_exchange_strong(pin_count, -1)) {
+    return false;
+  }
+  replacer_->Remove(frame_id);
+  page_table_.Erase(page->GetPageId());
+  removeOwnerFrame(frame_id);
+  page->ResetMemory();
+  page->page_id_ = INVALID_PAGE_ID;
+  page->is_dirty_ = false;
+  free_list_.push_back(frame_id);
+  return true;
+}
+
+bool BufferPoolManagerInstance::DeletePage(page_id_t page_id) {
+  // 0.   Make sure you call DiskManager::DeallocatePage!
+  // 1.   Search the page table for the requested page (P).
+  // 1.   If P does not exist, return true.
+  // 2.   If P exists, but has a non-zero pin-count, return false. Someone is using the page.
+  // 3.   Otherwise, P can be deleted. Remove P from the page table, reset its metadata and return it to the free list.
+  std::lock_guard<std::mutex> lock(latch_);
+  if (cache_ != nullptr) {
+    cache_->Remove(page_id);
+  }
+  // step 1.
+  auto frame_id = page_table_.Find(page_id);
+  if (frame_id < 0) {
+    return true;
+  }
+  // step 2. and 3.
+  if (!dropFrame(frame_id)) {
+    return false;
+  }
+  // step 0.
+  disk_manager_->DeallocatePage(page_id);
+  return true;
+}
+
+void BufferPoolManagerInstance::StartWriteBack(std::vector<std::pair<page_id_t, const char *>> *pages) {
+  std::lock_guard<std::mutex> lock(latch_);
+  // Same as writeBack(): pin the pages so that they stay put, and clear the dirty flag before they are written.
+  for (size_t fid = 0; fid < pool_size_; fid++) {
+    auto page = GetFrame(fid);
+    if (page->GetPageId() != INVALID_PAGE_ID && page->IsDirty() && !page->io_in_progress_) {
+      page->pin_count_.fetch_add(1);
+      replacer_->Pin(fid);
+      page->is_dirty_ = false;
+      pages->emplace_back(page->GetPageId(), page->GetData());
+    }
+  }
+}
+
+void BufferPoolManagerInstance::FinishWriteBack(const std::vector<std::pair<page_id_t, const char *>> &pages) {
+  std::lock_guard<std::mutex> lock(latch_);
+  for (const auto &entry : pages) {
+    // The pin kept the page in its frame.
+    releaseFrame(page_table_.Find(entry.first));
+  }
+  metrics_->RecordWriteBacks(instance_index_, pages.size());
+}
+
+std::vector<page_id_t> BufferPoolManagerInstance::ResidentPages() {
+  std::lock_guard<std::mutex> lock(latch_);
+  // Pinned pages are in use right now, so they come first. The others follow in the reverse of the order in which
+  // the replacer would evict them.
+  auto candidates = replacer_->EvictionCandidates(pool_size_);
+  std::vector<bool> evictable(max_pool_size_, false);
+  for (auto frame_id : candidates) {
+    evictable[frame_id] = true;
+  }
+  std::vector<page_id_t> page_ids;
+  for (size_t fid = 0; fid < pool_size_; fid++) {
+    auto page_id = GetFrame(fid)->GetPageId();
+    if (page_id != INVALID_PAGE_ID && !evictable[fid]) {
+      page_ids.push_back(page_id);
+    }
+  }
+  for (auto iterator = candidates.rbegin(); iterator != candidates.rend(); ++iterator) {
+    auto page_id = GetFrame(*iterator)->GetPageId();
+    if (page_id != INVALID_PAGE_ID) {
+      page_ids.push_back(page_id);
+    }
+  }
+  return page_ids;
+}
+
+void BufferPoolManagerInstance::StartLoad(const std::vector<page_id_t> &page_ids,
+                                          std::vector<std::pair<page_id_t, char *>> *pages) {
+  std::lock_guard<std::mutex> lock(latch_);
+  // Same as a miss in FetchPage(), except that only free frames are used: pages that are merely expected to be hot
+  // must not push out pages that are in use.
+  for (auto page_id : page_ids) {
+    if (free_list_.empty()) {
+      break;
+    }
+    if (page_table_.Find(page_id) >= 0) {
+      continue;
+    }
+    auto frame_id = free_list_.front();
+    free_list_.pop_front();
+    if (cache_ != nullptr) {
+      cache_->Remove(page_id);
+    }
+    // Nobody asked for the page yet, so it belongs to nobody in particular.
+    auto page = startRead(frame_id, page_id, NO_OWNER);
+    pages->emplace_back(page_id, page->GetData());
+  }
+}
+
+void BufferPoolManagerInstance::FinishLoad(const std::vector<std::pair<page_id_t, char *>> &pages) {
+  std::lock_guard<std::mutex> lock(latch_);
+  for (const auto &entry : pages) {
+    // The pin kept the page in its frame. Like a page that is read ahead, the page is only referenced once it is
+    // actually fetched.
+    auto frame_id = page_table_.Find(entry.first);
+    GetFrame(frame_id)->io_in_progress_ = false;
+    releaseFrame(frame_id);
+  }
+  metrics_->RecordPrefetches(instance_index_, pages.size());
+  io_cv_.notify_all();
+}
+
+size_t BufferPoolManagerInstance::CleanPages(size_t lookahead, double max_dirty_ratio) {
+  std::unique_lock<std::mutex> lock(latch_);
+  std::vector<bool> selected(max_pool_size_, false);
+  std::vector<std::pair<page_id_t, frame_id_t>> dirty_frames;
+  auto select = [this, &selected, &dirty_frames](frame_id_t frame_id) {
+    auto page = GetFrame(frame_id);
+    if (!selected[frame_id] && page->IsDirty() && page->pin_count_ == 0 && !page->io_in_progress_) {
+      selected[frame_id] = true;
+      dirty_frames.emplace_back(page->GetPageId(), frame_id);
+    }
+  };
+
+  // First make sure that the next few victims are clean.
+  for (auto frame_id : replacer_->EvictionCandidates(lookahead)) {
+    select(frame_id);
+  }
+
+  // If too much of the pool is dirty, bring it back below the limit, whether the pages are about to be evicted or not.
+  size_t num_dirty = 0;
+  for (size_t fid = 0; fid < pool_size_; fid++) {
+    num_dirty += GetFrame(fid)->IsDirty() ? 1 : 0;
+  }
+  auto max_dirty = static_cast<size_t>(max_dirty_ratio * pool_size_);
+  for (size_t fid = 0; fid < pool_size_ && num_dirty > max_dirty + dirty_frames.size(); fid++) {
+    select(static_cast<frame_id_t>(fid));
+  }
+
+  // Writing in page id order turns runs of adjacent pages into sequential I/O.
+  std::sort(dirty_frames.begin(), dirty_frames.end());
+  writeBack(dirty_frames, &lock);
+  metrics_->RecordCleanerWriteBacks(instance_index_, dirty_frames.size());
+  return dirty_frames.size();
+}
+
+bool BufferPoolManagerInstance::Resize(size_t pool_size, std::chrono::steady_clock::time_point deadline) {
+  BUSTUB_ASSERT(pool_size > 0 && pool_size <= max_pool_size_, "Instance size out of range.");
+  std::unique_lock<std::mutex> lock(latch_);
+  if (pool_size >= pool_size_) {
+    for (size_t fid = pool_size_; fid < pool_size; fid++) {
+      free_list_.push_back(static_cast<frame_id_t>(fid));
+    }
+    pool_size_ = pool_size;
+    usable_frames_ = pool_size;
+    return true;
+  }
+
+  // From now on, the frames that go away do not take new pages. Drain them of the pages they hold: evict those that
+  // are unpinned, and wait for the others to be unpinned. Evictions release the latch to write back dirty pages, and
+  // misses go on evicting frames meanwhile, including the ones that are being drained.
+  usable_frames_ = pool_size;
+  free_list_.remove_if([pool_size](frame_id_t frame_id) { return static_cast<size_t>(frame_id) >= pool_size; });
+  while (true) {
+    bool drained = true;
+    for (size_t fid = pool_size; fid < pool_size_; fid++) {
+      auto page = GetFrame(fid);
+      if (page->page_id_ == INVALID_PAGE_ID) {
+        continue;
+      }
+      if (page->pin_count_ == 0 && !page->io_in_progress_) {
+        replacer_->Remove(fid);
+        if (evictFrame(fid, &lock)) {
+          page->page_id_ = INVALID_PAGE_ID;
+          continue;
+        }
+      }
+      drained = false;
+    }
+    if (drained) {
+      break;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      // Keep the current size. The frames that were drained already are free.
+      for (size_t fid = pool_size; fid < pool_size_; fid++) {
+        if (GetFrame(fid)->page_id_ == INVALID_PAGE_ID) {
+          free_list_.push_back(static_cast<frame_id_t>(fid));
+        }
+      }
+      usable_frames_ = pool_size_;
+      return false;
+    }
+    lock.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    lock.lock();
+  }
+  pool_size_ = pool_size;
+  return true;
+}
+
+}  // namespace bustub
@@ -0,0 +1,304 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_metrics.cpp
+//
+// Identification: src/buffer/buffer_pool_metrics.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_pool_metrics.h"
+
+#include <cmath>
+#include <sstream>
+#include <unordered_map>
+
+namespace bustub {
+
+const char *AccessCategoryName(AccessCategory category) {
+  switch (category) {
+    case AccessCategory::OTHER:
+      return "other";
+    case AccessCategory::TABLE:
+      return "table";
+    case AccessCategory::TABLE_SCAN:
+      return "table_scan";
+    case AccessCategory::INDEX:
+      return "index";
+  }
+  return "unknown";
+}
+
+uint64_t LatencyHistogram::Quantile(double quantile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * count_)));
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+    seen += buckets_[bucket];
+    if (seen >= rank) {
+      return UpperBound(bucket);
+    }
+  }
+  return UpperBound(NUM_BUCKETS - 1);
+}
+
+LatencyHistogram &LatencyHistogram::operator+=(const LatencyHistogram &other) {
+  for (size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+    buckets_[bucket] += other.buckets_[bucket];
+  }
+  count_ += other.count_;
+  sum_ns_ += other.sum_ns_;
+  return *this;
+}
+
+BufferPoolStats &BufferPoolStats::operator+=(const BufferPoolStats &other) {
+  hits_ += other.hits_;
+  misses_ += other.misses_;
+  evictions_ += other.evictions_;
+  writebacks_ += other.writebacks_;
+  prefetches_ += other.prefetches_;
+  cleaner_writebacks_ += other.cleaner_writebacks_;
+  for (size_t i = 0; i < NUM_ACCESS_CATEGORIES; i++) {
+    category_hits_[i] += other.category_hits_[i];
+    category_misses_[i] += other.category_misses_[i];
+  }
+  pin_waits_ += other.pin_waits_;
+  pin_wait_ns_ += other.pin_wait_ns_;
+  fetch_latency_ += other.fetch_latency_;
+  new_page_latency_ += other.new_page_latency_;
+  return *this;
+}
+
+namespace {
+
+void FormatHistogram(std::ostream *out, const std::string &name, const LatencyHistogram &histogram) {
+  *out << "# TYPE " << name << " histogram\n";
+  // Prometheus buckets are cumulative, and their upper bounds inclusive.
+  uint64_t cumulative = 0;
+  for (size_t bucket = 0; bucket + 1 < LatencyHistogram::NUM_BUCKETS; bucket++) {
+    cumulative += histogram.buckets_[bucket];
+    *out << name << "_bucket{le=\"" << LatencyHistogram::UpperBound(bucket) - 1 << "\"} " << cumulative << "\n";
+  }
+  *out << name << "_bucket{le=\"+Inf\"} " << histogram.count_ << "\n";
+  *out << name << "_sum " << histogram.sum_ns_ << "\n";
+  *out << name << "_count " << histogram.count_ << "\n";
+}
+
+}  // namespace
+
+std::string BufferPoolStats::ToString() const {
+  std::ostringstream out;
+  auto counter = [&out](const std::string &name, uint64_t value) {
+    out << "# TYPE " << name << " counter\n" << name << " " << value << "\n";
+  };
+  auto by_category = [&out](const std::string &name, const std::array<uint64_t, NUM_ACCESS_CATEGORIES> &values) {
+    out << "# TYPE " << name << " counter\n";
+    for (size_t i = 0; i < NUM_ACCESS_CATEGORIES; i++) {
+      out << name << "{category=\"" << AccessCategoryName(static_cast<AccessCategory>(i)) << "\"} " << values[i]
+          << "\n";
+    }
+  };
+  by_category("bustub_buffer_pool_hits_total", category_hits_);
+  by_category("bustub_buffer_pool_misses_total", category_misses_);
+  out << "# TYPE bustub_buffer_pool_hit_ratio gauge\nbustub_buffer_pool_hit_ratio " << HitRatio() << "\n";
+  counter("bustub_buffer_pool_evictions_total", evictions_);
+  counter("bustub_buffer_pool_writebacks_total", writebacks_);
+  counter("bustub_buffer_pool_cleaner_writebacks_total", cleaner_writebacks_);
+  counter("bustub_buffer_pool_prefetches_total", prefetches_);
+  counter("bustub_buffer_pool_pin_waits_total", pin_waits_);
+  counter("bustub_buffer_pool_pin_wait_nanoseconds_total", pin_wait_ns_);
+  FormatHistogram(&out, "bustub_buffer_pool_fetch_latency_nanoseconds", fetch_latency_);
+  FormatHistogram(&out, "bustub_buffer_pool_new_page_latency_nanoseconds", new_page_latency_);
+  return out.str();
+}
+
+std::string OwnerStatsToString(const std::vector<BufferOwnerStats> &stats) {
+  std::ostringstream out;
+  auto by_owner = [&out, &stats](const std::string &name, const std::string &type, auto value) {
+    out << "# TYPE " << name << " " << type << "\n";
+    for (const auto &owner : stats) {
+      out << name << "{owner=\"";
+      // Label values escape backslashes, quotes and line breaks.
+      for (auto c : owner.name_) {
+        if (c == '\\' || c == '"') {
+          out << '\\' << c;
+        } else if (c == '\n') {
+          out << "\\n";
+        } else {
+          out << c;
+        }
+      }
+      out << "\"} " << value(owner) << "\n";
+    }
+  };
+  by_owner("bustub_buffer_pool_owner_resident_frames", "gauge",
+           [](const BufferOwnerStats &owner) { return owner.resident_frames_; });
+  by_owner("bustub_buffer_pool_owner_quota", "gauge", [](const BufferOwnerStats &owner) { return owner.quota_; });
+  by_owner("bustub_buffer_pool_owner_hits_total", "counter", [](const BufferOwnerStats &owner) { return owner.hits_; });
+  by_owner("bustub_buffer_pool_owner_misses_total", "counter",
+           [](const BufferOwnerStats &owner) { return owner.misses_; });
+  by_owner("bustub_buffer_pool_owner_evictions_total", "counter",
+           [](const BufferOwnerStats &owner) { return owner.evictions_; });
+  by_owner("bustub_buffer_pool_owner_quota_evictions_total", "counter",
+           [](const BufferOwnerStats &owner) { return owner.quota_evictions_; });
+  return out.str();
+}
+
+namespace {
+
+/** Source of BufferPoolMetrics ids. 0 is left out, so that it can mean "none" in the threads' caches. */
+std::atomic<uint64_t> next_metrics_id{1};
+
+/** The metrics that exist, by id, for the threads to retire their counters in when they exit. */
+std::mutex live_metrics_latch;
+std::unordered_map<uint64_t, BufferPoolMetrics *> live_metrics;
+
+/** Moves a counter that nobody writes to anymore into another one. */
+void MoveCounter(std::atomic<uint64_t> *to, std::atomic<uint64_t> *from) {
+  to->store(to->load(std::memory_order_relaxed) + from->load(std::memory_order_relaxed), std::memory_order_relaxed);
+  from->store(0, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+BufferPoolMetrics::BufferPoolMetrics(size_t num_instances, size_t latency_sample_interval, size_t max_owners)
+    : id_(next_metrics_id++),
+      num_instances_(num_instances),
+      latency_sample_interval_(latency_sample_interval),
+      max_owners_(max_owners),
+      retired_(num_instances, max_owners) {
+  std::lock_guard<std::mutex> lock(live_metrics_latch);
+  live_metrics[id_] = this;
+}
+
+BufferPoolMetrics::~BufferPoolMetrics() {
+  std::lock_guard<std::mutex> lock(live_metrics_latch);
+  live_metrics.erase(id_);
+}
+
+BufferPoolMetrics::ThreadCounters *BufferPoolMetrics::localThreadCounters() {
+  /** The counters of a thread, by the id of their metrics, which get them back when the thread exits. */
+  struct LocalCounters {
+    std::unordered_map<uint64_t, ThreadCounters *> by_id_;
+    ~LocalCounters() {
+      // The ids of metrics that are gone are skipped: their counters went with them.
+      std::lock_guard<std::mutex> lock(live_metrics_latch);
+      for (auto [id, counters] : by_id_) {
+        auto metrics = live_metrics.find(id);
+        if (metrics != live_metrics.end()) {
+          metrics->second->retire(counters);
+        }
+      }
+    }
+  };
+  thread_local LocalCounters thread_counters;
+  auto &counters = thread_counters.by_id_[id_];
+  if (counters == nullptr) {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (free_threads_.empty()) {
+      threads_.push_back(std::make_unique<ThreadCounters>(num_instances_, max_owners_));
+      counters = threads_.back().get();
+    } else {
+      counters = free_threads_.back();
+      free_threads_.pop_back();
+    }
+  }
+  return counters;
+}
+
+void BufferPoolMetrics::retire(ThreadCounters *counters) {
+  auto move_histogram = [](Histogram *to, Histogram *from) {
+    for (size_t bucket = 0; bucket < LatencyHistogram::NUM_BUCKETS; bucket++) {
+      MoveCounter(&to->buckets_[bucket], &from->buckets_[bucket]);
+    }
+    MoveCounter(&to->count_, &from->count_);
+    MoveCounter(&to->sum_ns_, &from->sum_ns_);
+  };
+  std::lock_guard<std::mutex> lock(latch_);
+  for (size_t i = 0; i < num_instances_; i++) {
+    auto &to = retired_.instances_[i];
+    auto &from = counters->instances_[i];
+    for (size_t category = 0; category < NUM_ACCESS_CATEGORIES; category++) {
+      MoveCounter(&to.hits_[category], &from.hits_[category]);
+      MoveCounter(&to.misses_[category], &from.misses_[category]);
+    }
+    MoveCounter(&to.evictions_, &from.evictions_);
+    MoveCounter(&to.writebacks_, &from.writebacks_);
+    MoveCounter(&to.cleaner_writebacks_, &from.cleaner_writebacks_);
+    MoveCounter(&to.prefetches_, &from.prefetches_);
+    MoveCounter(&to.pin_waits_, &from.pin_waits_);
+    MoveCounter(&to.pin_wait_ns_, &from.pin_wait_ns_);
+    move_histogram(&to.fetch_latency_, &from.fetch_latency_);
+    move_histogram(&to.new_page_latency_, &from.new_page_latency_);
+  }
+  for (size_t owner = 0; owner < max_owners_; owner++) {
+    auto &to = retired_.owners_[owner];
+    auto &from = counters->owners_[owner];
+    MoveCounter(&to.hits_, &from.hits_);
+    MoveCounter(&to.misses_, &from.misses_);
+    MoveCounter(&to.evictions_, &from.evictions_);
+    MoveCounter(&to.quota_evictions_, &from.quota_evictions_);
+  }
+  free_threads_.push_back(counters);
+}
+
+BufferPoolStats BufferPoolMetrics::GetStats(size_t instance_index) {
+  auto load = [](const std::atomic<uint64_t> &counter) { return counter.load(std::memory_order_relaxed); };
+  BufferPoolStats stats;
+  std::lock_guard<std::mutex> lock(latch_);
+  auto add = [&](const ThreadCounters &thread) {
+    const auto &counters = thread.instances_[instance_index];
+    for (size_t i = 0; i < NUM_ACCESS_CATEGORIES; i++) {
+      stats.category_hits_[i] += load(counters.hits_[i]);
+      stats.category_misses_[i] += load(counters.misses_[i]);
+    }
+    stats.evictions_ += load(counters.evictions_);
+    stats.writebacks_ += load(counters.writebacks_);
+    stats.cleaner_writebacks_ += load(counters.cleaner_writebacks_);
+    stats.prefetches_ += load(counters.prefetches_);
+    stats.pin_waits_ += load(counters.pin_waits_);
+    stats.pin_wait_ns_ += load(counters.pin_wait_ns_);
+    for (auto [histogram, source] : {std::make_pair(&stats.fetch_latency_, &counters.fetch_latency_),
+                                     std::make_pair(&stats.new_page_latency_, &counters.new_page_latency_)}) {
+      for (size_t bucket = 0; bucket < LatencyHistogram::NUM_BUCKETS; bucket++) {
+        histogram->buckets_[bucket] += load(source->buckets_[bucket]);
+      }
+      histogram->count_ += load(source->count_);
+      histogram->sum_ns_ += load(source->sum_ns_);
+    }
+  };
+  add(retired_);
+  for (const auto &thread : threads_) {
+    add(*thread);
+  }
+  for (size_t i = 0; i < NUM_ACCESS_CATEGORIES; i++) {
+    stats.hits_ += stats.category_hits_[i];
+    stats.misses_ += stats.category_misses_[i];
+  }
+  return stats;
+}
+
+void BufferPoolMetrics::AddOwnerStats(std::vector<BufferOwnerStats> *stats) {
+  auto load = [](const std::atomic<uint64_t> &counter) { return counter.load(std::memory_order_relaxed); };
+  std::lock_guard<std::mutex> lock(latch_);
+  auto add = [&](const ThreadCounters &thread) {
+    for (auto &owner : *stats) {
+      const auto &counters = thread.owners_[owner.owner_id_];
+      owner.hits_ += load(counters.hits_);
+      owner.misses_ += load(counters.misses_);
+      owner.evictions_ += load(counters.evictions_);
+      owner.quota_evictions_ += load(counters.quota_evictions_);
+    }
+  };
+  add(retired_);
+  for (const auto &thread : threads_) {
+    add(*thread);
+  }
+}
+
+}  // namespace bustub
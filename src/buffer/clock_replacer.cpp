@@ -11,77 +11,129 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/clock_replacer.h"
-#include "common/logger.h"
+
+#include <vector>
+
+#include "common/macros.h"
 
 namespace bustub {
 
-ClockReplacer::ClockReplacer(size_t num_pages) {
-  this->ref_flag_.clear();
-  this->pin_pos_.clear();
-  this->frames_.clear();
-  this->clock_hand_ = this->frames_.begin();
+ClockReplacer::ClockReplacer(size_t num_pages) : num_pages_(num_pages), states_(num_pages) {
+  // Frames start out in the class of most pages.
+  for (auto &state : states_) {
+    state.store(static_cast<uint8_t>(RetentionClass::HEAP) << CLASS_SHIFT);
+  }
+  for (auto &class_size : class_sizes_) {
+    class_size.store(0);
+  }
 }
 
 ClockReplacer::~ClockReplacer() = default;
 
 bool ClockReplacer::Victim(frame_id_t *frame_id) {
-  std::lock_guard<std::mutex> lock(this->mux_);
-  if (this->frames_.size() <= 0) {
-    frame_id = nullptr;
-    return false;
-  }
-  while (true) {
-    if (this->clock_hand_ == this->frames_.end()) {
-      this->clock_hand_ = this->frames_.begin();
+  // Pins and unpins may race with the sweep, so keep going for as long as there is anything to victimize. Every full
+  // turn of the hand clears all reference bits of the class it is after, so without concurrent unpins we stop within
+  // two turns. The class is looked up again after every turn, in case its frames were pinned meanwhile.
+  while (size_.load() > 0) {
+    auto lowest_class = LowestClass();
+    for (size_t i = 0; i < 2 * num_pages_; i++) {
+      auto fid = clock_hand_.fetch_add(1) % num_pages_;
+      auto &slot = states_[fid];
+      uint8_t state = slot.load();
+      if ((state & EVICTABLE) == 0 || ClassOf(state) > lowest_class) {
+        continue;
+      }
+      if ((state & REFERENCED) != 0) {
+        // Give the frame a second chance. If the CAS fails the frame was pinned or unpinned meanwhile, and it will be
+        // looked at again on the next turn.
+        slot.compare_exchange_strong(state, state & ~REFERENCED);
+        continue;
+      }
+      // Claim the frame. Only one of any concurrent victimizers (or a concurrent Pin) can win this.
+      if (slot.compare_exchange_strong(state, state & CLASS_MASK)) {
+        AddEvictable(ClassOf(state), -1);
+        *frame_id = static_cast<frame_id_t>(fid);
+        return true;
+      }
     }
-    auto f_id = *(this->clock_hand_);
-    if (f_id >= 0 && !this->ref_flag_[f_id]) {
-      *frame_id = f_id;
-      // remove the frame
-      this->PinImpl(f_id);
-      return true;
-    }
-    // set ref_flag of f_id to false (cause it's true)
-    if (f_id >= 0) {
-      this->ref_flag_[f_id] = false;
-    }
-    // rotate the clock hand
-    this->clock_hand_++;
+  }
+  return false;
+}
+
+void ClockReplacer::MakeEvictable(frame_id_t frame_id, uint8_t bits) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "Frame id out of range.");
+  uint8_t old_state = states_[frame_id].fetch_or(EVICTABLE | bits);
+  if ((old_state & EVICTABLE) == 0) {
+    AddEvictable(ClassOf(old_state), 1);
   }
 }
 
-// this function is  not thread-safe. Don't call this directly
-void ClockReplacer::PinImpl(frame_id_t frame_id) {
-  auto found_iterator = this->pin_pos_.find(frame_id);
-  if (found_iterator != this->pin_pos_.end()) {
-    if (found_iterator->second == this->clock_hand_) {
-      this->clock_hand_++;
+void ClockReplacer::AddEvictable(size_t retention, int64_t delta) {
+  class_sizes_[retention].fetch_add(delta);
+  size_.fetch_add(delta);
+}
+
+size_t ClockReplacer::LowestClass() const {
+  for (size_t retention = 0; retention < NUM_RETENTION_CLASSES; retention++) {
+    if (class_sizes_[retention].load() > 0) {
+      return retention;
     }
-    this->ref_flag_.erase(frame_id);
-    this->frames_.erase(found_iterator->second);
-    this->pin_pos_.erase(frame_id);
   }
+  return NUM_RETENTION_CLASSES;
 }
 
 void ClockReplacer::Pin(frame_id_t frame_id) {
-  std::lock_guard<std::mutex> lock(this->mux_);
-  this->PinImpl(frame_id);
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "Frame id out of range.");
+  // The reference bit is left alone: whether the pin counts as a use is decided by Unpin or Release.
+  uint8_t old_state = states_[frame_id].fetch_and(static_cast<uint8_t>(~EVICTABLE));
+  if ((old_state & EVICTABLE) != 0) {
+    AddEvictable(ClassOf(old_state), -1);
+  }
+}
+
+void ClockReplacer::Unpin(frame_id_t frame_id) { MakeEvictable(frame_id, REFERENCED); }
+
+void ClockReplacer::Release(frame_id_t frame_id) { MakeEvictable(frame_id, 0); }
+
+void ClockReplacer::SetRetentionClass(frame_id_t frame_id, RetentionClass retention) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "Frame id out of range.");
+  auto new_class = static_cast<size_t>(retention);
+  auto &slot = states_[frame_id];
+  uint8_t state = slot.load();
+  while (ClassOf(state) != new_class) {
+    if (slot.compare_exchange_weak(state, (state & ~CLASS_MASK) | (new_class << CLASS_SHIFT))) {
+      // The frame is normally pinned by whoever accessed it, but an unpin may have raced with the pin.
+      if ((state & EVICTABLE) != 0) {
+        AddEvictable(ClassOf(state), -1);
+        AddEvictable(new_class, 1);
+      }
+      break;
+    }
+  }
 }
 
-void ClockReplacer::Unpin(frame_id_t frame_id) {
-  std::lock_guard<std::mutex> lock(this->mux_);
-  if (this->ref_flag_.find(frame_id) != this->ref_flag_.end()) {
-    this->ref_flag_[frame_id] = true;
-    return;
+std::vector<frame_id_t> ClockReplacer::EvictionCandidates(size_t max_frames) {
+  // The hand takes the lowest class first. Within a class, it takes the unreferenced frames it comes across first,
+  // and the referenced ones on its next turn.
+  std::vector<frame_id_t> candidates;
+  auto hand = clock_hand_.load();
+  for (size_t retention = 0; retention < NUM_RETENTION_CLASSES; retention++) {
+    for (uint8_t referenced : {uint8_t{0}, REFERENCED}) {
+      auto wanted = static_cast<uint8_t>(EVICTABLE | referenced | (retention << CLASS_SHIFT));
+      for (size_t i = 0; i < num_pages_ && candidates.size() < max_frames; i++) {
+        auto fid = (hand + i) % num_pages_;
+        if (states_[fid].load() == wanted) {
+          candidates.push_back(static_cast<frame_id_t>(fid));
+        }
+      }
+    }
   }
-  this->frames_.push_back(frame_id);
-  this->ref_flag_.insert({frame_id, true});
-  this->pin_pos_.insert({frame_id, std::prev(this->frames_.end())});
+  return candidates;
 }
 
 size_t ClockReplacer::Size() {
-  std::lock_guard<std::mutex> lock(this->mux_);
-  return this->frames_.size();
+  auto size = size_.load();
+  return size > 0 ? static_cast<size_t>(size) : 0;
 }
 
 }  // namespace bustub
@@ -0,0 +1,157 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compressed_page_cache.cpp
+//
+// Identification: src/buffer/compressed_page_cache.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/compressed_page_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "common/util/compression_util.h"
+
+namespace bustub {
+
+std::string CompressedPageCacheStats::ToString() const {
+  std::ostringstream out;
+  auto sample = [&out](const std::string &name, const std::string &type, auto value) {
+    out << "# TYPE " << name << " " << type << "\n" << name << " " << value << "\n";
+  };
+  sample("bustub_compressed_cache_hits_total", "counter", hits_);
+  sample("bustub_compressed_cache_misses_total", "counter", misses_);
+  sample("bustub_compressed_cache_insertions_total", "counter", insertions_);
+  sample("bustub_compressed_cache_evictions_total", "counter", evictions_);
+  sample("bustub_compressed_cache_bytes_in_total", "counter", bytes_in_);
+  sample("bustub_compressed_cache_bytes_stored_total", "counter", bytes_stored_);
+  sample("bustub_compressed_cache_compression_ratio", "gauge", CompressionRatio());
+  sample("bustub_compressed_cache_pages", "gauge", num_pages_);
+  sample("bustub_compressed_cache_used_bytes", "gauge", used_bytes_);
+  sample("bustub_compressed_cache_capacity_bytes", "gauge", capacity_bytes_);
+  return out.str();
+}
+
+CompressedPageCache::CompressedPageCache(size_t capacity)
+    : num_chunks_(capacity / CHUNK_SIZE), arena_(new char[num_chunks_ * CHUNK_SIZE]), next_chunk_(num_chunks_, -1) {
+  free_chunks_.reserve(num_chunks_);
+  for (size_t i = num_chunks_; i > 0; i--) {
+    free_chunks_.push_back(static_cast<int32_t>(i - 1));
+  }
+  stats_.capacity_bytes_ = num_chunks_ * CHUNK_SIZE;
+}
+
+CompressedPageCache::~CompressedPageCache() { delete[] arena_; }
+
+uint64_t CompressedPageCache::Reserve(page_id_t page_id) {
+  std::lock_guard<std::mutex> lock(latch_);
+  auto ticket = next_ticket_++;
+  reservations_[page_id] = ticket;
+  return ticket;
+}
+
+void CompressedPageCache::Put(page_id_t page_id, uint64_t ticket, const char *data) {
+  // Compress before taking the latch. A page that does not get any smaller is stored as is.
+  char buffer[PAGE_SIZE];
+  auto size = CompressionUtil::Compress(data, PAGE_SIZE, buffer, PAGE_SIZE - 1);
+  const char *bytes = buffer;
+  if (size == 0) {
+    size = PAGE_SIZE;
+    bytes = data;
+  }
+  auto num_chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+  std::lock_guard<std::mutex> lock(latch_);
+  auto reservation = reservations_.find(page_id);
+  if (reservation == reservations_.end() || reservation->second != ticket) {
+    // The page was brought back into the buffer pool meanwhile, so this copy may be stale.
+    return;
+  }
+  reservations_.erase(reservation);
+  if (num_chunks > num_chunks_) {
+    return;
+  }
+  auto stale = entries_.find(page_id);
+  if (stale != entries_.end()) {
+    erase(stale);
+  }
+  while (free_chunks_.size() < num_chunks) {
+    erase(entries_.find(fifo_.front()));
+    stats_.evictions_++;
+  }
+
+  int32_t first_chunk = -1;
+  // Fill the chunks back to front, so that every chunk can be linked to the one after it right away.
+  for (size_t i = num_chunks; i > 0; i--) {
+    auto chunk = free_chunks_.back();
+    free_chunks_.pop_back();
+    auto offset = (i - 1) * CHUNK_SIZE;
+    memcpy(arena_ + chunk * CHUNK_SIZE, bytes + offset, std::min(CHUNK_SIZE, size - offset));
+    next_chunk_[chunk] = first_chunk;
+    first_chunk = chunk;
+  }
+  fifo_.push_back(page_id);
+  entries_[page_id] = {first_chunk, size, std::prev(fifo_.end())};
+  stats_.insertions_++;
+  stats_.bytes_in_ += PAGE_SIZE;
+  stats_.bytes_stored_ += size;
+  stats_.num_pages_++;
+  stats_.used_bytes_ += num_chunks * CHUNK_SIZE;
+}
+
+bool CompressedPageCache::Remove(page_id_t page_id, std::string *compressed) {
+  std::lock_guard<std::mutex> lock(latch_);
+  reservations_.erase(page_id);
+  auto entry = entries_.find(page_id);
+  if (entry == entries_.end()) {
+    if (compressed != nullptr) {
+      stats_.misses_++;
+    }
+    return false;
+  }
+  if (compressed != nullptr) {
+    stats_.hits_++;
+    compressed->resize(entry->second.size_);
+    size_t offset = 0;
+    for (auto chunk = entry->second.first_chunk_; chunk >= 0; chunk = next_chunk_[chunk]) {
+      auto piece = std::min(CHUNK_SIZE, entry->second.size_ - offset);
+      memcpy(&(*compressed)[offset], arena_ + chunk * CHUNK_SIZE, piece);
+      offset += piece;
+    }
+  }
+  erase(entry);
+  return true;
+}
+
+bool CompressedPageCache::Restore(const std::string &compressed, char *data) {
+  if (compressed.size() == PAGE_SIZE) {
+    memcpy(data, compressed.data(), PAGE_SIZE);
+    return true;
+  }
+  return CompressionUtil::Decompress(compressed.data(), compressed.size(), data, PAGE_SIZE);
+}
+
+CompressedPageCacheStats CompressedPageCache::GetStats() {
+  std::lock_guard<std::mutex> lock(latch_);
+  return stats_;
+}
+
+void CompressedPageCache::erase(std::unordered_map<page_id_t, Entry>::iterator entry) {
+  size_t num_chunks = 0;
+  for (auto chunk = entry->second.first_chunk_; chunk >= 0; chunk = next_chunk_[chunk]) {
+    free_chunks_.push_back(chunk);
+    num_chunks++;
+  }
+  stats_.num_pages_--;
+  stats_.used_bytes_ -= num_chunks * CHUNK_SIZE;
+  fifo_.erase(entry->second.position_);
+  entries_.erase(entry);
+}
+
+}  // namespace bustub
@@ -0,0 +1,156 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.cpp
+//
+// Identification: src/buffer/lru_k_replacer.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/lru_k_replacer.h"
+
+#include <algorithm>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+LRUKReplacer::LRUKReplacer(size_t num_frames, size_t k, size_t correlated_reference_period)
+    : k_(k), correlated_reference_period_(correlated_reference_period), frames_(num_frames) {
+  BUSTUB_ASSERT(k_ > 0, "LRU-K needs at least one reference per frame.");
+  for (auto &frame : frames_) {
+    frame.history_.resize(k_, 0);
+  }
+}
+
+LRUKReplacer::~LRUKReplacer() = default;
+
+bool LRUKReplacer::Victim(frame_id_t *frame_id) {
+  std::lock_guard<std::mutex> lock(latch_);
+  auto victims = NextVictims(1);
+  if (victims.empty()) {
+    return false;
+  }
+  *frame_id = victims[0];
+  RemoveImpl(victims[0]);
+  return true;
+}
+
+std::vector<frame_id_t> LRUKReplacer::NextVictims(size_t max_frames) const {
+  std::vector<frame_id_t> victims;
+  // Within a class, frames referenced within the correlated reference period are only taken after all the others.
+  std::vector<frame_id_t> correlated;
+  auto it = evictable_.begin();
+  while (it != evictable_.end() && victims.size() < max_frames) {
+    auto retention = std::get<0>(*it);
+    for (; it != evictable_.end() && std::get<0>(*it) == retention && victims.size() < max_frames; ++it) {
+      auto frame_id = std::get<3>(*it);
+      if (current_time_ - frames_[frame_id].last_ > correlated_reference_period_) {
+        victims.push_back(frame_id);
+      } else {
+        correlated.push_back(frame_id);
+      }
+    }
+    if (it == evictable_.end() || std::get<0>(*it) != retention) {
+      // The class is done, so its correlated frames come next.
+      for (size_t i = 0; i < correlated.size() && victims.size() < max_frames; i++) {
+        victims.push_back(correlated[i]);
+      }
+    }
+    correlated.clear();
+  }
+  return victims;
+}
+
+std::vector<frame_id_t> LRUKReplacer::EvictionCandidates(size_t max_frames) {
+  std::lock_guard<std::mutex> lock(latch_);
+  return NextVictims(max_frames);
+}
+
+void LRUKReplacer::Pin(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  if (frame.evictable_) {
+    frame.evictable_ = false;
+    evictable_.erase(Key(frame_id));
+  }
+}
+
+void LRUKReplacer::Unpin(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch_);
+  auto &frame = frames_[frame_id];
+  if (!frame.evictable_) {
+    frame.evictable_ = true;
+    evictable_.insert(Key(frame_id));
+  }
+}
+
+size_t LRUKReplacer::Size() {
+  std::lock_guard<std::mutex> lock(latch_);
+  return evictable_.size();
+}
+
+void LRUKReplacer::RecordAccess(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch_);
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < frames_.size(), "Frame id out of range.");
+  auto now = ++current_time_;
+  auto &frame = frames_[frame_id];
+  auto &history = frame.history_;
+  // The position of an evictable frame moves with its references.
+  if (frame.evictable_) {
+    evictable_.erase(Key(frame_id));
+  }
+  if (history[0] != 0 && now - frame.last_ <= correlated_reference_period_) {
+    // A correlated reference only moves the end of the current period.
+    frame.last_ = now;
+    if (frame.evictable_) {
+      evictable_.insert(Key(frame_id));
+    }
+    return;
+  }
+  // Close the correlated period of the previous reference: older references are moved forward by its length, so
+  // that the period counts as a single point in time.
+  uint64_t correlated_period = history[0] != 0 ? frame.last_ - history[0] : 0;
+  for (size_t i = k_ - 1; i > 0; i--) {
+    history[i] = history[i - 1] != 0 ? history[i - 1] + correlated_period : 0;
+  }
+  history[0] = now;
+  frame.last_ = now;
+  if (frame.evictable_) {
+    evictable_.insert(Key(frame_id));
+  }
+}
+
+void LRUKReplacer::SetRetentionClass(frame_id_t frame_id, RetentionClass retention) {
+  std::lock_guard<std::mutex> lock(latch_);
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < frames_.size(), "Frame id out of range.");
+  auto &frame = frames_[frame_id];
+  if (frame.evictable_) {
+    evictable_.erase(Key(frame_id));
+  }
+  frame.retention_ = retention;
+  if (frame.evictable_) {
+    evictable_.insert(Key(frame_id));
+  }
+}
+
+void LRUKReplacer::Remove(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lock(latch_);
+  RemoveImpl(frame_id);
+}
+
+void LRUKReplacer::RemoveImpl(frame_id_t frame_id) {
+  auto &frame = frames_[frame_id];
+  if (frame.evictable_) {
+    evictable_.erase(Key(frame_id));
+  }
+  frame.evictable_ = false;
+  frame.last_ = 0;
+  frame.retention_ = RetentionClass::HEAP;
+  std::fill(frame.history_.begin(), frame.history_.end(), 0);
+}
+
+}  // namespace bustub
@@ -0,0 +1,97 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_table.cpp
+//
+// Identification: src/buffer/page_table.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/page_table.h"
+
+#include "common/macros.h"
+
+namespace bustub {
+
+PageTable::PageTable(size_t num_frames) : bits_(1) {
+  // Keep the load factor at or below one half.
+  while ((size_t{1} << bits_) < 2 * num_frames) {
+    bits_++;
+  }
+  mask_ = (size_t{1} << bits_) - 1;
+  slots_ = std::vector<std::atomic<uint64_t>>(mask_ + 1);
+  for (auto &slot : slots_) {
+    slot.store(EMPTY);
+  }
+}
+
+size_t PageTable::Home(page_id_t page_id) const {
+  // Fibonacci hashing. The pages of one instance are num_instances apart, so the low bits alone would cluster.
+  return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(page_id)) * 0x9E3779B97F4A7C15ULL) >>
+                             (64 - bits_));
+}
+
+frame_id_t PageTable::Find(page_id_t page_id) const {
+  auto i = Home(page_id);
+  // Bounded, because entries may move under our feet while we probe.
+  for (size_t n = 0; n <= mask_; n++, i = (i + 1) & mask_) {
+    auto slot = slots_[i].load();
+    if (slot == EMPTY) {
+      return -1;
+    }
+    if (PageIdOf(slot) == page_id) {
+      return FrameIdOf(slot);
+    }
+  }
+  return -1;
+}
+
+void PageTable::Insert(page_id_t page_id, frame_id_t frame_id) {
+  BUSTUB_ASSERT(page_id != INVALID_PAGE_ID, "Cannot map the invalid page id.");
+  auto i = Home(page_id);
+  while (slots_[i].load() != EMPTY) {
+    BUSTUB_ASSERT(PageIdOf(slots_[i].load()) != page_id, "Page is mapped already.");
+    i = (i + 1) & mask_;
+  }
+  slots_[i].store(Pack(page_id, frame_id));
+}
+
+bool PageTable::Erase(page_id_t page_id) {
+  auto i = Home(page_id);
+  while (true) {
+    auto slot = slots_[i].load();
+    if (slot == EMPTY) {
+      return false;
+    }
+    if (PageIdOf(slot) == page_id) {
+      break;
+    }
+    i = (i + 1) & mask_;
+  }
+  // Slot i is a hole now. Walk the rest of the cluster and move back every entry whose probe sequence passes the
+  // hole, leaving a new hole where it was, until the cluster ends.
+  auto j = i;
+  while (true) {
+    j = (j + 1) & mask_;
+    auto slot = slots_[j].load();
+    if (slot == EMPTY) {
+      break;
+    }
+    auto home = Home(PageIdOf(slot));
+    // The entry can stay if its home lies cyclically in (i, j].
+    bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+    if (!stays) {
+      // Copy before clearing, so that concurrent lookups find the entry in at least one of the two places most of
+      // the time.
+      slots_[i].store(slot);
+      i = j;
+    }
+  }
+  slots_[i].store(EMPTY);
+  return true;
+}
+
+}  // namespace bustub
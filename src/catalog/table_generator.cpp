@@ -48,6 +48,8 @@ std::vector<Value> TableGenerator::MakeValues(ColumnInsertMeta *col_meta, uint32
 void TableGenerator::FillTable(TableMetadata *info, TableInsertMeta *table_meta) {
   uint32_t num_inserted = 0;
   uint32_t batch_size = 128;
+  // Keep the load from pushing everything else out of the buffer pool.
+  BufferAccessStrategy strategy(BufferAccessStrategyType::BULK_WRITE);
   while (num_inserted < table_meta->num_rows_) {
     std::vector<std::vector<Value>> values;
     uint32_t num_values = std::min(batch_size, table_meta->num_rows_ - num_inserted);
@@ -61,7 +63,8 @@ void TableGenerator::FillTable(TableMetadata *info, TableInsertMeta *table_meta)
         entry.emplace_back(col[i]);
       }
       RID rid;
-      bool inserted = info->table_->InsertTuple(Tuple(entry, &info->schema_), &rid, exec_ctx_->GetTransaction());
+      bool inserted =
+          info->table_->InsertTuple(Tuple(entry, &info->schema_), &rid, exec_ctx_->GetTransaction(), &strategy);
       BUSTUB_ASSERT(inserted, "Sequential insertion cannot fail");
       num_inserted++;
     }
@@ -0,0 +1,81 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// rwlatch.cpp
+//
+// Identification: src/common/rwlatch.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/rwlatch.h"
+
+namespace bustub {
+
+void ReaderWriterLatch::wlockSlow() {
+  // Wait for the other writer to leave, and enter right away, which keeps new readers out.
+  parking_.Await([this] {
+    uint32_t state = state_.load();
+    while ((state & WRITER_ENTERED) == 0) {
+      if (state_.compare_exchange_weak(state, state | WRITER_ENTERED)) {
+        return true;
+      }
+    }
+    return false;
+  });
+  // Then wait for the readers that are in to leave.
+  parking_.Await([this] { return state_.load() == WRITER_ENTERED; });
+}
+
+void ReaderWriterLatch::rlockSlow() {
+  parking_.Await([this] {
+    uint32_t state = state_.load();
+    while (state < MAX_READERS) {
+      if (state_.compare_exchange_weak(state, state + 1)) {
+        return true;
+      }
+    }
+    return false;
+  });
+}
+
+size_t DistributedReaderWriterLatch::SlotIndex() {
+  // Threads take the counters in turn. A core would be a better key, but a thread may move to another core between
+  // taking and releasing a latch, so the key has to stay with the thread.
+  static std::atomic<size_t> next_slot{0};
+  thread_local size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % NUM_SLOTS;
+  return slot;
+}
+
+bool DistributedReaderWriterLatch::drained() const {
+  for (const auto &slot : slots_) {
+    if (slot.readers_.load() != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void DistributedReaderWriterLatch::wlockSlow(bool entered) {
+  if (!entered) {
+    parking_.Await([this] {
+      bool expected = false;
+      return writer_entered_.compare_exchange_strong(expected, true);
+    });
+  }
+  parking_.Await([this] { return drained(); });
+}
+
+void DistributedReaderWriterLatch::rlockSlow(std::atomic<uint32_t> *readers) {
+  // Step back until the writer is done, as ReaderWriterLatch would not have let us in either.
+  do {
+    readers->fetch_sub(1);
+    parking_.WakeAll();
+    parking_.Await([this] { return !writer_entered_.load(); });
+    readers->fetch_add(1);
+  } while (writer_entered_.load());
+}
+
+}  // namespace bustub
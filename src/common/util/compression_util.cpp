@@ -0,0 +1,187 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compression_util.cpp
+//
+// Identification: src/common/util/compression_util.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/util/compression_util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+namespace {
+
+/** Number of bits of the hash of four bytes, i.e. log2 of the size of the match finder's table. */
+constexpr int HASH_BITS = 12;
+
+uint32_t Load32(const char *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint32_t Hash(uint32_t sequence) { return (sequence * 2654435761U) >> (32 - HASH_BITS); }
+
+/**
+ * Appends the continuation bytes of a length that did not fit into its nibble.
+ * @return the position after them, or nullptr if they do not fit
+ */
+char *PutLength(char *out, const char *end, size_t length) {
+  for (; length >= 255; length -= 255) {
+    if (out == end) {
+      return nullptr;
+    }
+    *out++ = static_cast<char>(255);
+  }
+  if (out == end) {
+    return nullptr;
+  }
+  *out++ = static_cast<char>(length);
+  return out;
+}
+
+/**
+ * Reads the continuation bytes of a length whose nibble was 15.
+ * @return false if the input ends first
+ */
+bool GetLength(const unsigned char **in, const unsigned char *end, size_t *length) {
+  unsigned char byte;
+  do {
+    if (*in == end) {
+      return false;
+    }
+    byte = *(*in)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/**
+ * Appends a token: the literals in [literals, literals + num_literals), then a match of the given length at the given
+ * distance back, or no match if match_length is 0.
+ * @return the position after the token, or nullptr if it does not fit
+ */
+char *PutToken(char *out, const char *end, const char *literals, size_t num_literals, size_t distance,
+               size_t match_length) {
+  if (out == end) {
+    return nullptr;
+  }
+  auto token = out++;
+  size_t match_code = match_length == 0 ? 0 : match_length - CompressionUtil::MIN_MATCH;
+  *token = static_cast<char>((std::min<size_t>(num_literals, 15) << 4) | std::min<size_t>(match_code, 15));
+  if (num_literals >= 15 && (out = PutLength(out, end, num_literals - 15)) == nullptr) {
+    return nullptr;
+  }
+  if (static_cast<size_t>(end - out) < num_literals) {
+    return nullptr;
+  }
+  memcpy(out, literals, num_literals);
+  out += num_literals;
+  if (match_length == 0) {
+    return out;
+  }
+  if (end - out < 2) {
+    return nullptr;
+  }
+  *out++ = static_cast<char>(distance & 0xFF);
+  *out++ = static_cast<char>(distance >> 8);
+  if (match_code >= 15) {
+    return PutLength(out, end, match_code - 15);
+  }
+  return out;
+}
+
+}  // namespace
+
+size_t CompressionUtil::Compress(const char *src, size_t src_size, char *dst, size_t dst_capacity) {
+  BUSTUB_ASSERT(src_size <= MAX_INPUT_SIZE, "Input too large for 16 bit distances.");
+  // Positions plus one, so that 0 means that no position with the hash was seen yet.
+  uint16_t table[1 << HASH_BITS] = {};
+  char *out = dst;
+  const char *end = dst + dst_capacity;
+  size_t anchor = 0;
+  size_t pos = 0;
+  while (pos + MIN_MATCH <= src_size) {
+    auto sequence = Load32(src + pos);
+    auto &slot = table[Hash(sequence)];
+    size_t candidate = slot;
+    slot = static_cast<uint16_t>(pos + 1);
+    if (candidate == 0 || Load32(src + candidate - 1) != sequence) {
+      // Step further the longer we go without a match, so that incompressible data costs little time.
+      pos += 1 + ((pos - anchor) >> 5);
+      continue;
+    }
+    candidate--;
+    size_t length = MIN_MATCH;
+    while (pos + length < src_size && src[candidate + length] == src[pos + length]) {
+      length++;
+    }
+    out = PutToken(out, end, src + anchor, pos - anchor, pos - candidate, length);
+    if (out == nullptr) {
+      return 0;
+    }
+    pos += length;
+    anchor = pos;
+  }
+  out = PutToken(out, end, src + anchor, src_size - anchor, 0, 0);
+  return out == nullptr ? 0 : out - dst;
+}
+
+bool CompressionUtil::Decompress(const char *src, size_t src_size, char *dst, size_t dst_size) {
+  auto in = reinterpret_cast<const unsigned char *>(src);
+  auto in_end = in + src_size;
+  size_t out = 0;
+  while (in < in_end) {
+    auto token = *in++;
+    size_t num_literals = token >> 4;
+    if (num_literals == 15 && !GetLength(&in, in_end, &num_literals)) {
+      return false;
+    }
+    if (static_cast<size_t>(in_end - in) < num_literals || dst_size - out < num_literals) {
+      return false;
+    }
+    memcpy(dst + out, in, num_literals);
+    in += num_literals;
+    out += num_literals;
+    if (in == in_end) {
+      // The last token has no match.
+      break;
+    }
+    if (in_end - in < 2) {
+      return false;
+    }
+    size_t distance = in[0] | (static_cast<size_t>(in[1]) << 8);
+    in += 2;
+    size_t length = token & 0xF;
+    if (length == 15 && !GetLength(&in, in_end, &length)) {
+      return false;
+    }
+    length += MIN_MATCH;
+    if (distance == 0 || distance > out || dst_size - out < length) {
+      return false;
+    }
+    // The match may overlap the bytes it produces, e.g. a run of zeros refers back to the zero before it. Such a match
+    // repeats the distance bytes it starts with, so copy those, then twice as many, and so on.
+    auto from = dst + out - distance;
+    while (length > 0) {
+      auto piece = std::min<size_t>(length, dst + out - from);
+      memcpy(dst + out, from, piece);
+      out += piece;
+      length -= piece;
+    }
+  }
+  return out == dst_size;
+}
+
+}  // namespace bustub
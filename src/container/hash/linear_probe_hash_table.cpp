@@ -10,6 +10,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <utility>
@@ -26,14 +27,22 @@ template <typename KeyType, typename ValueType, typename KeyComparator>
 HASH_TABLE_TYPE::LinearProbeHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
                                       const KeyComparator &comparator, size_t num_buckets,
                                       HashFunction<KeyType> hash_fn)
-    : name_(name), buffer_pool_manager_(buffer_pool_manager), comparator_(comparator), hash_fn_(std::move(hash_fn)) {
-  auto page = buffer_pool_manager->NewPage(&(this->header_page_id_));
+    : name_(name),
+      buffer_pool_manager_(buffer_pool_manager),
+      comparator_(comparator),
+      hash_fn_(std::move(hash_fn)),
+      access_{nullptr, false, AccessCategory::INDEX, buffer_pool_manager->RegisterOwner("index:" + name),
+              RetentionClass::INDEX_BLOCK},
+      header_access_{nullptr, false, AccessCategory::INDEX, access_.owner_, RetentionClass::INDEX_HEADER} {
+  auto page = buffer_pool_manager->NewPage(&(this->header_page_id_), this->header_access_);
   if (page == nullptr) {
     throw new Exception("Can't initialize header page");
   }
   auto header_page = reinterpret_cast<HashTableHeaderPage *>(page->GetData());
   header_page->SetSize(num_buckets);
   this->appendBuckets(header_page, num_buckets);
+  this->block_refs_ = std::vector<SwizzledPageRef>(header_page->NumBlocks());
+  buffer_pool_manager->UnpinPage(this->header_page_id_, true);
 }
 
 /*****************************************************************************
@@ -42,36 +51,33 @@ HASH_TABLE_TYPE::LinearProbeHashTable(const std::string &name, BufferPoolManager
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result) {
   this->table_latch_.RLock();
+  this->getValue(key, result);
+  this->table_latch_.RUnlock();
+  if (result->size() > 0) return true;
+  return false;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::getValue(const KeyType &key, std::vector<ValueType> *result) {
   auto header_page = this->HeaderPage();
-  auto expected_index = this->GetSlotIndex(key);
-  auto meet_starting_point = false;
-  for (auto index = expected_index;; index = (index + 1) % header_page->GetSize()) {
-    if (index == expected_index) {
-      if (meet_starting_point) break;
-      meet_starting_point = true;
-    }
-    // initialize block_page and block (casting)
+  size_t size = header_page->GetSize();
+  size_t index = this->GetSlotIndex(key);
+  // Probe block by block, pinning every block on the way once, until an empty slot or all the way around.
+  std::vector<std::pair<KeyType, ValueType>> copies;
+  for (size_t num_probed = 0; num_probed < size;) {
     auto block_index = index / BLOCK_ARRAY_SIZE;
-    auto page = this->buffer_pool_manager_->FetchPage(header_page->GetBlockPageId(block_index));
-    auto block = reinterpret_cast<HashTableBlockPage<KeyType, ValueType, KeyComparator> *>(page->GetData());
-
-    // expected offset of key-value pair in this block
-    auto data_offset_in_block = index % BLOCK_ARRAY_SIZE;
-
-    // start searching
-    page->RLatch();
-    if (!block->IsOccupied(data_offset_in_block)) {
-      page->RUnlatch();
+    auto num_slots = std::min((block_index + 1) * BLOCK_ARRAY_SIZE, size) - index;
+    num_slots = std::min(num_slots, size - num_probed);
+    auto page = this->fetchBlock(header_page, block_index);
+    auto done = this->probeBlock(page, index % BLOCK_ARRAY_SIZE, num_slots, key, result, &copies);
+    this->buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    if (done) {
       break;
     }
-    if (block->IsReadable(data_offset_in_block) && this->comparator_(key, block->KeyAt(data_offset_in_block)) == 0) {
-      result->push_back(block->ValueAt(data_offset_in_block));
-    }
-    page->RUnlatch();
+    num_probed += num_slots;
+    index = (index + num_slots) % size;
   }
-  this->table_latch_.RUnlock();
-  if (result->size() > 0) return true;
-  return false;
+  this->buffer_pool_manager_->UnpinPage(this->header_page_id_, false);
 }
 
 /*****************************************************************************
@@ -81,8 +87,9 @@ template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_TYPE::Insert(Transaction *transaction, const KeyType &key, const ValueType &value) {
   this->table_latch_.RLock();
   auto result = std::vector<ValueType>();
-  this->GetValue(transaction, key, &result);
+  this->getValue(key, &result);
   if (std::find(result.begin(), result.end(), value) != result.end()) {
+    this->table_latch_.RUnlock();
     return false;
   }
   auto header_page = this->HeaderPage();
@@ -95,7 +102,7 @@ bool HASH_TABLE_TYPE::Insert(Transaction *transaction, const KeyType &key, const
     }
     // initialize block_page and block (casting)
     auto block_index = index / BLOCK_ARRAY_SIZE;
-    auto page = this->buffer_pool_manager_->FetchPage(header_page->GetBlockPageId(block_index));
+    auto page = this->fetchBlock(header_page, block_index);
     auto block = reinterpret_cast<HashTableBlockPage<KeyType, ValueType, KeyComparator> *>(page->GetData());
 
     // inserting (and flushing the page if the insert operator is successfuly)
@@ -104,14 +111,23 @@ bool HASH_TABLE_TYPE::Insert(Transaction *transaction, const KeyType &key, const
     if (success) {
       this->buffer_pool_manager_->FlushPage(page->GetPageId());
       page->WUnlatch();
+      this->buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+      this->buffer_pool_manager_->UnpinPage(this->header_page_id_, false);
       this->table_latch_.RUnlock();
       return true;
     }
     page->WUnlatch();
+    this->buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
   }
+  auto size = header_page->GetSize();
+  this->buffer_pool_manager_->UnpinPage(this->header_page_id_, false);
   this->table_latch_.RUnlock();
   // come here mean the current hash table is full, we need to resize
-  this->Resize(header_page->GetSize());
+  this->Resize(size);
+  if (this->GetSize() == size) {
+    // The table is as large as it gets.
+    return false;
+  }
   return this->Insert(transaction, key, value);
 }
 
@@ -131,7 +147,7 @@ bool HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const
     }
     // initialize block_page and block (casting)
     auto block_index = index / BLOCK_ARRAY_SIZE;
-    auto page = this->buffer_pool_manager_->FetchPage(header_page->GetBlockPageId(block_index));
+    auto page = this->fetchBlock(header_page, block_index);
     auto block = reinterpret_cast<HashTableBlockPage<KeyType, ValueType, KeyComparator> *>(page->GetData());
     // expected offset of key-value pair in this block
     auto data_offset_in_block = index % BLOCK_ARRAY_SIZE;
@@ -140,6 +156,7 @@ bool HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const
     page->WLatch();
     if (!block->IsOccupied(data_offset_in_block)) {
       page->WUnlatch();
+      this->buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
       break;
     }
     if (block->IsReadable(data_offset_in_block) && this->comparator_(key, block->KeyAt(data_offset_in_block)) == 0 &&
@@ -147,11 +164,15 @@ bool HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const
       // removing and unlock
       block->Remove(data_offset_in_block);
       page->WUnlatch();
+      this->buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+      this->buffer_pool_manager_->UnpinPage(this->header_page_id_, false);
       this->table_latch_.RUnlock();
       return true;
     }
     page->WUnlatch();
+    this->buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
   }
+  this->buffer_pool_manager_->UnpinPage(this->header_page_id_, false);
   this->table_latch_.RUnlock();
   return false;
 }
@@ -163,28 +184,52 @@ template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_TYPE::Resize(size_t initial_size) {
   this->table_latch_.WLock();
   auto header_page = this->HeaderPage();
-  auto expected_size = initial_size * 2;
+  // The table cannot grow beyond the number of blocks the header page has room for.
+  auto expected_size = std::min(initial_size * 2, header_page->MaxBlocks() * BLOCK_ARRAY_SIZE);
   // only grow up in size
   if (header_page->GetSize() < expected_size) {
-    auto old_size = header_page->GetSize();
-    header_page->SetSize(expected_size);
-    this->appendBuckets(header_page, expected_size - old_size);
-    // re-organize all key-value pairs
-    auto all_old_blocks = std::vector<HashTableBlockPage<KeyType, ValueType, KeyComparator> *>();
-    auto all_block_page_ids = std::vector<page_id_t>();
+    // Take every pair out of the old blocks first, so that nothing is lost if a block cannot be fetched. The blocks are
+    // fetched in batches, which reads the ones that are not resident with a few large reads instead of one each.
+    std::vector<page_id_t> old_block_page_ids;
     for (size_t idx = 0; idx < header_page->NumBlocks(); idx++) {
-      all_old_blocks.push_back(this->BlockPage(header_page, idx));
-      all_block_page_ids.push_back(header_page->GetBlockPageId(idx));
+      old_block_page_ids.push_back(header_page->GetBlockPageId(idx));
     }
-    header_page->ResetBlockIndex();
-    for (size_t idx = 0; idx < header_page->NumBlocks(); idx++) {
-      const auto &block = all_old_blocks[idx];
-      for (size_t pair_idx = 0; pair_idx < BLOCK_ARRAY_SIZE; pair_idx++) {
-        this->Insert(nullptr, block->KeyAt(pair_idx), block->ValueAt(pair_idx));
+    std::vector<std::pair<KeyType, ValueType>> pairs;
+    auto batch_size = std::max<size_t>(1, this->buffer_pool_manager_->GetPoolSize() / 2);
+    for (size_t begin = 0; begin < old_block_page_ids.size(); begin += batch_size) {
+      std::vector<page_id_t> batch(old_block_page_ids.begin() + begin,
+                                   old_block_page_ids.begin() + std::min(begin + batch_size, old_block_page_ids.size()));
+      auto pages = this->buffer_pool_manager_->FetchPages(batch, this->access_);
+      bool fetched_all = true;
+      for (size_t i = 0; i < batch.size(); i++) {
+        if (pages[i] == nullptr) {
+          fetched_all = false;
+          continue;
+        }
+        auto block = reinterpret_cast<HashTableBlockPage<KeyType, ValueType, KeyComparator> *>(pages[i]->GetData());
+        for (size_t pair_idx = 0; pair_idx < BLOCK_ARRAY_SIZE; pair_idx++) {
+          if (block->IsReadable(pair_idx)) {
+            pairs.emplace_back(block->KeyAt(pair_idx), block->ValueAt(pair_idx));
+          }
+        }
+        this->buffer_pool_manager_->UnpinPage(batch[i], false);
+      }
+      if (!fetched_all) {
+        this->buffer_pool_manager_->UnpinPage(this->header_page_id_, false);
+        this->table_latch_.WUnlock();
+        throw Exception(ExceptionType::OUT_OF_MEMORY, "Can't fetch the blocks of the hash table to resize it");
       }
-      this->buffer_pool_manager_->DeletePage(all_block_page_ids[idx]);
+    }
+
+    header_page->SetSize(expected_size);
+    header_page->ResetBlockIndex();
+    this->rebuildBlocks(header_page, pairs);
+    this->block_refs_ = std::vector<SwizzledPageRef>(header_page->NumBlocks());
+    for (auto page_id : old_block_page_ids) {
+      this->buffer_pool_manager_->DeletePage(page_id);
     }
   }
+  this->buffer_pool_manager_->UnpinPage(this->header_page_id_, true);
   this->table_latch_.WUnlock();
 }
 
@@ -195,6 +240,7 @@ template <typename KeyType, typename ValueType, typename KeyComparator>
 size_t HASH_TABLE_TYPE::GetSize() {
   this->table_latch_.RLock();
   auto size = this->HeaderPage()->GetSize();
+  this->buffer_pool_manager_->UnpinPage(this->header_page_id_, false);
   this->table_latch_.RUnlock();
   return size;
 }
@@ -204,20 +250,76 @@ size_t HASH_TABLE_TYPE::GetSize() {
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 HashTableHeaderPage *HASH_TABLE_TYPE::HeaderPage() {
-  return reinterpret_cast<HashTableHeaderPage *>(
-      this->buffer_pool_manager_->FetchPage(this->header_page_id_)->GetData());
+  auto page = this->buffer_pool_manager_->FetchPage(this->header_page_id_, &this->header_ref_, this->header_access_);
+  return reinterpret_cast<HashTableHeaderPage *>(page->GetData());
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 HashTableBlockPage<KeyType, ValueType, KeyComparator> *HASH_TABLE_TYPE::BlockPage(HashTableHeaderPage *header_page,
                                                                                   size_t bucket_ind) {
   return reinterpret_cast<HashTableBlockPage<KeyType, ValueType, KeyComparator> *>(
-      this->buffer_pool_manager_->FetchPage(header_page->GetBlockPageId(bucket_ind))->GetData());
+      this->fetchBlock(header_page, bucket_ind)->GetData());
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+Page *HASH_TABLE_TYPE::fetchBlock(HashTableHeaderPage *header_page, size_t block_index) {
+  auto page_id = header_page->GetBlockPageId(block_index);
+  return this->buffer_pool_manager_->FetchPage(page_id, &this->block_refs_[block_index], this->access_);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 slot_offset_t HASH_TABLE_TYPE::GetSlotIndex(const KeyType &key) {
-  return this->hash_fn_.GetHash(key) % this->HeaderPage()->GetSize();
+  auto size = this->HeaderPage()->GetSize();
+  this->buffer_pool_manager_->UnpinPage(this->header_page_id_, false);
+  return this->hash_fn_.GetHash(key) % size;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool HASH_TABLE_TYPE::probeBlock(Page *page, size_t first_slot, size_t num_slots, const KeyType &key,
+                                 std::vector<ValueType> *result, std::vector<std::pair<KeyType, ValueType>> *copies) {
+  auto block = reinterpret_cast<HashTableBlockPage<KeyType, ValueType, KeyComparator> *>(page->GetData());
+  auto end_slot = first_slot + num_slots;
+
+  // Lookups only read, so they do not need the page latch unless an insert or remove is writing the block right now.
+  // The pairs are copied and only compared once the read turned out consistent, since a key that is being written
+  // may be garbage.
+  uint64_t version;
+  if (page->StartOptimisticRead(&version)) {
+    copies->clear();
+    auto done = false;
+    for (auto slot = first_slot; slot < end_slot; slot++) {
+      if (!block->IsOccupied(slot)) {
+        done = true;
+        break;
+      }
+      if (block->IsReadable(slot)) {
+        copies->emplace_back();
+        block->CopyPairAt(slot, &copies->back().first, &copies->back().second);
+      }
+    }
+    if (page->ValidateOptimisticRead(version)) {
+      for (const auto &pair : *copies) {
+        if (this->comparator_(key, pair.first) == 0) {
+          result->push_back(pair.second);
+        }
+      }
+      return done;
+    }
+  }
+
+  page->RLatch();
+  auto done = false;
+  for (auto slot = first_slot; slot < end_slot; slot++) {
+    if (!block->IsOccupied(slot)) {
+      done = true;
+      break;
+    }
+    if (block->IsReadable(slot) && this->comparator_(key, block->KeyAt(slot)) == 0) {
+      result->push_back(block->ValueAt(slot));
+    }
+  }
+  page->RUnlatch();
+  return done;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
@@ -225,13 +327,72 @@ void HASH_TABLE_TYPE::appendBuckets(HashTableHeaderPage *header_page, size_t num
   size_t total_current_buckets = header_page->NumBlocks() * BLOCK_ARRAY_SIZE;
   for (; total_current_buckets < num_buckets; total_current_buckets += BLOCK_ARRAY_SIZE) {
     page_id_t next_block_id;
-    assert(this->buffer_pool_manager_->NewPage(&next_block_id) != nullptr);
+    if (this->buffer_pool_manager_->NewPage(&next_block_id, this->access_) == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "Can't allocate a block page");
+    }
     this->buffer_pool_manager_->UnpinPage(next_block_id, true);
     this->buffer_pool_manager_->FlushPage(next_block_id);
     header_page->AddBlockPageId(next_block_id);
   }
 }
 
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::rebuildBlocks(HashTableHeaderPage *header_page,
+                                    const std::vector<std::pair<KeyType, ValueType>> &pairs) {
+  // The blocks start out empty, so linear probing would put every pair into the first free slot at or after its home
+  // slot. Placing the pairs in the order of their home slots gets there without probing: a pair goes right behind the
+  // pair before it, unless its home slot comes later. Pairs that run past the last slot wrap around to the free slots
+  // at the start.
+  auto size = header_page->GetSize();
+  std::vector<std::pair<size_t, size_t>> homes;  // (home slot, index into pairs)
+  homes.reserve(pairs.size());
+  for (size_t i = 0; i < pairs.size(); i++) {
+    homes.emplace_back(this->hash_fn_.GetHash(pairs[i].first) % size, i);
+  }
+  std::sort(homes.begin(), homes.end());
+  std::vector<std::pair<size_t, size_t>> slots;  // (slot, index into pairs)
+  slots.reserve(homes.size());
+  size_t next_free = 0;
+  std::vector<size_t> wrapped;
+  for (const auto &home : homes) {
+    auto slot = std::max(home.first, next_free);
+    if (slot >= size) {
+      wrapped.push_back(home.second);
+    } else {
+      slots.emplace_back(slot, home.second);
+      next_free = slot + 1;
+    }
+  }
+  size_t slot = 0;
+  size_t taken = 0;
+  for (auto i : wrapped) {
+    while (taken < slots.size() && slots[taken].first == slot) {
+      slot++;
+      taken++;
+    }
+    slots.emplace_back(slot++, i);
+  }
+  std::sort(slots.begin(), slots.end());
+
+  // Every block is filled right when it is created, so that it is written once, when it is evicted or flushed, and
+  // never read back.
+  auto it = slots.begin();
+  for (size_t first_slot = 0; first_slot < size; first_slot += BLOCK_ARRAY_SIZE) {
+    page_id_t block_page_id;
+    auto page = this->buffer_pool_manager_->NewPage(&block_page_id, this->access_);
+    if (page == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "Can't allocate a block page");
+    }
+    auto block = reinterpret_cast<HashTableBlockPage<KeyType, ValueType, KeyComparator> *>(page->GetData());
+    for (; it != slots.end() && it->first < first_slot + BLOCK_ARRAY_SIZE; ++it) {
+      const auto &pair = pairs[it->second];
+      block->Insert(it->first - first_slot, pair.first, pair.second);
+    }
+    this->buffer_pool_manager_->UnpinPage(block_page_id, true);
+    header_page->AddBlockPageId(block_page_id);
+  }
+}
+
 template class LinearProbeHashTable<int, int, IntComparator>;
 
 template class LinearProbeHashTable<GenericKey<4>, RID, GenericComparator<4>>;
@@ -0,0 +1,138 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_access_strategy.h
+//
+// Identification: src/include/buffer/buffer_access_strategy.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+class BufferPoolManagerInstance;
+
+/** The kinds of bulk access that get a ring of their own. */
+enum class BufferAccessStrategyType {
+  /** A sequential scan that reads every page of a table once. */
+  BULK_READ,
+  /** A bulk insert that fills one new page after the other. */
+  BULK_WRITE,
+};
+
+/**
+ * BufferAccessStrategy keeps a bulk operation from flooding the buffer pool.
+ *
+ * A sequential scan or a bulk insert touches every page once and then never again. If those pages went through the
+ * replacer like any other, a single pass over a large table would evict the whole working set of everyone else.
+ * Instead, the operation brings its pages into a small ring of frames: once the ring is full, a miss reuses the
+ * frame the operation loaded ring_size misses ago, provided nobody else is using that page by now. Pages that are
+ * already resident are served from wherever they are, and if the ring frame cannot be reused the miss falls back to
+ * the regular replacer and the new frame takes its place in the ring.
+ *
+ * The ring is split between the instances of the buffer pool, since every instance can only recycle its own frames.
+ * Copies of a strategy share the same ring, so read-ahead requests queued on behalf of an operation keep using its
+ * ring even if they outlive the operation's own strategy object.
+ */
+class BufferAccessStrategy {
+  friend class BufferPoolManagerInstance;
+
+ public:
+  /**
+   * Creates a strategy with the default ring size for the given kind of access.
+   * @param type the kind of bulk access
+   */
+  explicit BufferAccessStrategy(BufferAccessStrategyType type)
+      : BufferAccessStrategy(type == BufferAccessStrategyType::BULK_READ ? BULK_READ_RING_SIZE
+                                                                         : BULK_WRITE_RING_SIZE) {}
+
+  /**
+   * Creates a strategy with a ring of the given size.
+   * @param ring_size the number of frames the operation may occupy at any time
+   */
+  explicit BufferAccessStrategy(size_t ring_size) : ring_size_(ring_size), rings_(std::make_shared<Rings>()) {}
+
+  /** @return the number of frames the operation may occupy at any time */
+  size_t GetRingSize() const { return ring_size_; }
+
+ private:
+  /** A frame in the ring, together with the page the operation loaded into it. */
+  struct RingEntry {
+    frame_id_t frame_id_;
+    page_id_t page_id_;
+  };
+
+  /** The part of the ring that lives in one instance. Protected by the latch of that instance. */
+  struct Ring {
+    std::vector<RingEntry> entries_;
+    /** Entry to recycle on the next miss. */
+    size_t next_{0};
+  };
+
+  /** The parts of the ring, by instance. */
+  struct Rings {
+    std::mutex latch_;
+    std::unordered_map<const BufferPoolManagerInstance *, Ring> rings_;
+  };
+
+  /** @return the part of the ring that lives in the given instance */
+  Ring *GetRing(const BufferPoolManagerInstance *instance) {
+    std::lock_guard<std::mutex> lock(rings_->latch_);
+    return &rings_->rings_[instance];
+  }
+
+  size_t ring_size_;
+  std::shared_ptr<Rings> rings_;
+};
+
+/** Who a page is accessed for. The buffer pool keeps hits and misses apart by category. */
+enum class AccessCategory {
+  /** Anything not listed below, e.g. the catalog. */
+  OTHER,
+  /** A table heap, looking up or changing single tuples. */
+  TABLE,
+  /** A sequential scan of a table heap. */
+  TABLE_SCAN,
+  /** An index. */
+  INDEX,
+};
+
+/** Number of access categories. */
+static constexpr size_t NUM_ACCESS_CATEGORIES = 4;
+
+/** Identifies the table or index a page belongs to, for the buffer pool's accounting. Handed out by RegisterOwner(). */
+using owner_id_t = uint32_t;
+
+/** The owner of the pages that belong to no table or index in particular. */
+static constexpr owner_id_t NO_OWNER = 0;
+
+/**
+ * AccessContext tells the buffer pool how a page is being accessed.
+ */
+struct AccessContext {
+  /** Ring to bring the page into on a miss, or nullptr to use the whole buffer pool. */
+  BufferAccessStrategy *strategy_{nullptr};
+  /** True if the page is only being read ahead of its use, so the access must not count as a reference. */
+  bool prefetch_{false};
+  /** Who the page is accessed for. */
+  AccessCategory category_{AccessCategory::OTHER};
+  /** The table or index the page belongs to. A page is charged to the owner that brought it into the buffer pool. */
+  owner_id_t owner_{NO_OWNER};
+  /** How hard the buffer pool should try to keep the page. */
+  RetentionClass retention_{RetentionClass::HEAP};
+};
+
+}  // namespace bustub
@@ -12,11 +12,22 @@
 
 #pragma once
 
-#include <list>
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <vector>
 
-#include "buffer/clock_replacer.h"
+#include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/buffer_pool_metrics.h"
+#include "buffer/compressed_page_cache.h"
+#include "buffer/swizzled_page_ref.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
 #include "storage/page/page.h"
@@ -25,6 +36,29 @@ namespace bustub {
 
 /**
  * BufferPoolManager reads disk pages to and from its internal buffer pool.
+ *
+ * The buffer pool can be split into several BufferPoolManagerInstances that each own a share of the frames and
+ * latch independently. A page always lives in instance (page_id % num_instances), so threads working on different
+ * pages rarely contend with each other.
+ *
+ * Pages can also be read ahead of their use. Read-ahead requests are served by a background thread that is started
+ * on the first request, so that a scan can keep working on one page while the next ones are read from disk.
+ *
+ * Optionally, a page cleaner thread writes dirty pages back before the replacer picks them, so that misses find clean
+ * frames and do not have to wait for a write.
+ *
+ * With a warm start file, the buffer pool remembers its hot pages across restarts: the ids of the resident pages are
+ * saved, ordered by how hot the replacer thinks they are, and a new buffer pool reads them back in large batches,
+ * hottest first, while it serves requests.
+ *
+ * The buffer pool can be resized while it is in use, up to the max_pool_size_ it was created with. The memory of the
+ * pages is reserved for that size up front but only backed by the operating system as frames are used, and the
+ * memory of the frames given up by a shrink is handed back to the operating system.
+ *
+ * Tables and indexes register as owners, and tag their accesses with their owner id, so that the buffer pool can tell
+ * how much of it every one of them holds, how well it is served, and how often its pages are evicted. An owner can be
+ * given a quota, which keeps it from pushing out more than its share of the pool: once it holds that many frames, it
+ * replaces its own pages.
  */
 class BufferPoolManager {
  public:
@@ -39,6 +73,17 @@ class BufferPoolManager {
    */
   BufferPoolManager(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr);
 
+  /**
+   * Creates a new BufferPoolManager that is split into several independently latched instances.
+   * @param num_instances the number of instances to split the buffer pool into
+   * @param pool_size the total size of the buffer pool, shared out evenly between the instances
+   * @param disk_manager the disk manager
+   * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param options the settings of the buffer pool, e.g. its replacement policy
+   */
+  BufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
+                    LogManager *log_manager = nullptr, const BufferPoolOptions &options = BufferPoolOptions());
+
   /**
    * Destroys an existing BufferPoolManager.
    */
@@ -91,12 +136,170 @@ class BufferPoolManager {
     GradingCallback(callback, CallbackType::AFTER, INVALID_PAGE_ID);
   }
 
+  /**
+   * Fetch the requested page. Unlike the grading function, this lets the caller say how the page is accessed, e.g.
+   * that a sequential scan should only recycle the frames of its own ring.
+   * @param page_id id of page to be fetched
+   * @param context how the page is being accessed
+   * @return the requested page, or nullptr if every frame is pinned
+   */
+  Page *FetchPage(page_id_t page_id, const AccessContext &context) { return FetchPageImpl(page_id, context); }
+
+  /**
+   * Fetch the requested page through a reference the caller keeps to it. If pointer swizzling is enabled and the page
+   * is still in the frame the reference remembers, the page table is skipped. Otherwise this is FetchPage(), and the
+   * reference remembers the frame the page was fetched into.
+   * @param page_id id of page to be fetched
+   * @param ref the reference to the page. It must only ever be used for this page id.
+   * @param context how the page is being accessed
+   * @return the requested page, or nullptr if every frame is pinned
+   */
+  Page *FetchPage(page_id_t page_id, SwizzledPageRef *ref, const AccessContext &context = AccessContext());
+
+  /**
+   * Creates a new page in the buffer pool, accessed as described by the context.
+   * @param[out] page_id id of created page
+   * @param context how the page is being accessed
+   * @return nullptr if no new pages could be created, otherwise pointer to new page
+   */
+  Page *NewPage(page_id_t *page_id, const AccessContext &context) { return NewPageImpl(page_id, context); }
+
+  /**
+   * Fetches several pages at once. Resident pages are pinned right away, and the missing ones are read together with a
+   * single vectored read per run of adjacent pages, instead of one read per page. Every page that is returned has to
+   * be unpinned like a page returned by FetchPage().
+   * @param page_ids ids of the pages to fetch. At most as many pages as there are frames can be pinned at once.
+   * @param context how the pages are being accessed
+   * @return the pages, in the order of page_ids, with nullptr for the pages that could not be fetched because every
+   * frame was pinned
+   */
+  std::vector<Page *> FetchPages(const std::vector<page_id_t> &page_ids, const AccessContext &context = AccessContext());
+
+  /**
+   * Reads pages into the buffer pool in the background, so that fetching them later does not have to wait for the
+   * disk. This is only a hint: requests are dropped while too many are queued, and pages are skipped while every
+   * frame is pinned.
+   * @param page_ids ids of the pages to read ahead
+   * @param context how the pages are going to be accessed
+   */
+  void PrefetchPages(const std::vector<page_id_t> &page_ids, const AccessContext &context = AccessContext());
+
+  /**
+   * Reads a chain of linked pages in the background, such as the pages of a table heap, where the id of a page is
+   * only known once the page before it has been read. Like PrefetchPages(), this is only a hint.
+   * @param page_id id of the first page of the chain
+   * @param num_pages the maximum number of pages to read
+   * @param next_page_id returns the id of the page after the given one, or INVALID_PAGE_ID at the end of the chain.
+   * It is called with the page pinned and read latched.
+   * @param context how the pages are going to be accessed
+   */
+  void PrefetchPageChain(page_id_t page_id, size_t num_pages, const std::function<page_id_t(Page *)> &next_page_id,
+                         const AccessContext &context = AccessContext());
+
+  /**
+   * Changes the number of frames of the buffer pool while it is in use. Growing always succeeds. Shrinking evicts the
+   * pages held by the frames that go away, writing them back if they are dirty, and waits for those that are pinned
+   * to be unpinned. If that takes longer than the timeout, the buffer pool keeps its size.
+   * @param pool_size the new size of the buffer pool, between the number of instances and the maximum size
+   * @param timeout how long to wait for pinned pages to be unpinned
+   * @return true if the buffer pool has the new size
+   */
+  bool Resize(size_t pool_size, std::chrono::milliseconds timeout = std::chrono::seconds(1));
+
+  /**
+   * Saves the ids of the resident pages, hottest first, so that LoadResidentPages() can bring them back later.
+   * @param file_name the file to save the page ids to. It is replaced atomically.
+   * @return true if the file was written
+   */
+  bool SaveResidentPages(const std::string &file_name);
+
+  /**
+   * Saves the resident pages to the warm start file the buffer pool was created with, e.g. at a checkpoint.
+   * @return true if the file was written, false if it could not be or there is no warm start file
+   */
+  bool SaveResidentPages() {
+    return !options_.warm_start_file_.empty() && SaveResidentPages(options_.warm_start_file_);
+  }
+
+  /**
+   * Reads the pages saved by SaveResidentPages() into free frames, hottest first. The pages are read in batches of
+   * WARM_START_BATCH_SIZE, and every run of adjacent pages in a batch with a single read. Pages that are resident
+   * already, or that the database file does not hold anymore, are skipped. Requests can be served meanwhile.
+   * @param file_name the file the page ids were saved to
+   * @return the number of pages read
+   */
+  size_t LoadResidentPages(const std::string &file_name);
+
+  /**
+   * Registers a table or an index with the buffer pool, so that its accesses can be told apart from the others.
+   * Registering a name again returns the id it got the first time.
+   * @param name the name of the owner, e.g. "table:orders"
+   * @return the id to tag the owner's accesses with, or NO_OWNER if the buffer pool has no room for more owners
+   */
+  owner_id_t RegisterOwner(const std::string &name);
+
+  /**
+   * Limits the share of the buffer pool an owner may hold. An owner that holds its share replaces its own pages
+   * instead of the pages of others, unless all of its pages are in use.
+   * @param owner_id an id returned by RegisterOwner()
+   * @param quota the largest fraction of the buffer pool the owner may hold, in (0, 1], or 0 for no limit
+   */
+  void SetOwnerQuota(owner_id_t owner_id, double quota);
+
+  /**
+   * Charges a resident page to another owner, e.g. to the one that was registered for it after it was created.
+   * @param page_id id of the page
+   * @param owner_id an id returned by RegisterOwner()
+   */
+  void ChargePage(page_id_t page_id, owner_id_t owner_id) { GetInstance(page_id)->ChargePage(page_id, owner_id); }
+
+  /**
+   * Deallocates the pages of the owners' extents that were not handed out yet, if the buffer pool allocates extents.
+   * Call it before the disk manager is shut down, as BustubInstance does on teardown: the buffer pool does not do it
+   * on its own, and the pages stay allocated otherwise. Owners get new extents when they create pages afterwards.
+   */
+  void ReleaseExtents();
+
+  /**
+   * @return what the buffer pool holds of every registered owner, and of NO_OWNER, with the counters of their pages,
+   * by owner id
+   */
+  std::vector<BufferOwnerStats> GetOwnerStats();
+
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
   /** @return size of the buffer pool */
   size_t GetPoolSize() { return pool_size_; }
 
+  /** @return the largest size the buffer pool can be resized to */
+  size_t GetMaxPoolSize() { return max_pool_size_; }
+
+  /** @return the number of instances the buffer pool is split into */
+  size_t GetNumInstances() { return instances_.size(); }
+
+  /**
+   * @param instance_index index of the instance
+   * @return a snapshot of the counters of the given instance
+   */
+  BufferPoolStats GetInstanceStats(size_t instance_index) { return metrics_.GetStats(instance_index); }
+
+  /** @return the counters of all the instances added together */
+  BufferPoolStats GetStats();
+
+  /**
+   * Formats the counters of the buffer pool for a metrics scraper, in the Prometheus text format. Counters by instance
+   * are left out; GetInstanceStats() has them. Counters by owner are labelled with the owner's name. The counters of
+   * the compressed cache follow, if there is one.
+   * @return the counters and the current size of the buffer pool, one sample per line
+   */
+  std::string DumpMetrics();
+
+  /** @return the counters of the compressed cache, all zero if the buffer pool has none */
+  CompressedPageCacheStats GetCompressedCacheStats() {
+    return compressed_cache_ == nullptr ? CompressedPageCacheStats() : compressed_cache_->GetStats();
+  }
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -114,9 +317,10 @@ class BufferPoolManager {
   /**
    * Fetch the requested page from the buffer pool.
    * @param page_id id of page to be fetched
+   * @param context how the page is being accessed
    * @return the requested page
    */
-  Page *FetchPageImpl(page_id_t page_id);
+  Page *FetchPageImpl(page_id_t page_id, const AccessContext &context = AccessContext());
 
   /**
    * Unpin the target page from the buffer pool.
@@ -136,9 +340,10 @@ class BufferPoolManager {
   /**
    * Creates a new page in the buffer pool.
    * @param[out] page_id id of created page
+   * @param context how the page is being accessed
    * @return nullptr if no new pages could be created, otherwise pointer to new page
    */
-  Page *NewPageImpl(page_id_t *page_id);
+  Page *NewPageImpl(page_id_t *page_id, const AccessContext &context = AccessContext());
 
   /**
    * Deletes a page from the buffer pool.
@@ -147,29 +352,141 @@ class BufferPoolManager {
    */
   bool DeletePageImpl(page_id_t page_id);
 
-  frame_id_t victimPage();
-  bool allPinned();
-
   /**
    * Flushes all the pages in the buffer pool to disk.
    */
   void FlushAllPagesImpl();
 
+  /** A page, or a chain of pages, to read in the background. */
+  struct PrefetchRequest {
+    page_id_t page_id_;
+    size_t num_pages_;
+    /** Finds the next page of a chain. Empty for a single page. */
+    std::function<page_id_t(Page *)> next_page_id_;
+    /** Copy of the strategy the pages are going to be accessed with, sharing the ring of the original, or nullptr. */
+    std::unique_ptr<BufferAccessStrategy> strategy_;
+    /** Who the pages are going to be accessed for. */
+    AccessCategory category_;
+    owner_id_t owner_;
+  };
+
+  /** Queues a read-ahead request, starting the read-ahead thread if it is not running yet. */
+  void enqueuePrefetch(PrefetchRequest request);
+
+  /** Body of the read-ahead thread. */
+  void runPrefetchThread();
+
+  /** Body of the page cleaner thread. */
+  void runPageCleanerThread();
+
+  /**
+   * Allocates a page on disk for a new page, from the extent of the owner of the access if the buffer pool allocates
+   * extents. Pages of the extent that were given back are handed out first, unless they live in an instance that was
+   * tried already.
+   * @param context the access the new page is created with
+   * @param tried the instances that were tried already, by index
+   * @return the id of the allocated page
+   */
+  page_id_t allocatePageId(const AccessContext &context, const std::vector<bool> &tried);
+
+  /**
+   * Gives back pages from allocatePageId() that could not be used: to the extent of the owner, so that nobody else
+   * gets them, or else to the disk manager.
+   * @param context the access they were allocated for
+   * @param page_ids the ids of the pages
+   */
+  void releasePageIds(const AccessContext &context, const std::vector<page_id_t> &page_ids);
+
+  /** Size of a huge page, for use_huge_pages_. */
+  static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  /**
+   * Reserves the memory for the page data, on huge pages if the options ask for them.
+   * @param size the number of bytes needed
+   * @param[out] mapped_size the size of the mapping, for munmap()
+   * @return the memory, aligned to PAGE_SIZE
+   */
+  char *mapPageData(size_t size, size_t *mapped_size);
+
+  /** @return the instance that owns the given page */
+  BufferPoolManagerInstance *GetInstance(page_id_t page_id) { return instances_[page_id % instances_.size()]; }
+
+  /**
+   * Frames are dealt out round-robin, so the first (pool_size % num_instances) instances get one extra frame. This
+   * makes the frames of all instances together exactly the first pool_size entries of pages_, whatever the size.
+   * @return the number of frames of the given instance in a buffer pool of the given size
+   */
+  size_t InstanceSize(size_t pool_size, size_t instance_index) {
+    return pool_size / instances_.size() + (instance_index < pool_size % instances_.size() ? 1 : 0);
+  }
+
   /** Number of pages in the buffer pool. */
-  size_t pool_size_;
-  /** Array of buffer pool pages. */
+  std::atomic<size_t> pool_size_;
+  /** Largest number of pages the buffer pool can be resized to. */
+  size_t max_pool_size_;
+  /** Array of buffer pool pages, shared by all the instances, with room for max_pool_size_ of them. */
   Page *pages_;
+  /**
+   * Memory for the data of max_pool_size_ pages, of which only the first pool_size_ are in use. Every frame is aligned
+   * to PAGE_SIZE, as direct I/O needs.
+   */
+  char *page_data_;
+  /** Size of the mapping at page_data_, which is rounded up to whole huge pages when they back it. */
+  size_t page_data_size_;
+  /** Serializes resizes. */
+  std::mutex resize_latch_;
+  /** Loads the warm start file in the background, or nullptr. */
+  std::thread *warm_start_thread_{nullptr};
+  /** Tells LoadResidentPages() to stop after the current batch. */
+  std::atomic<bool> stop_loading_{false};
   /** Pointer to the disk manager. */
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
   /** Pointer to the log manager. */
   LogManager *log_manager_ __attribute__((__unused__));
-  /** Page table for keeping track of buffer pool pages. */
-  std::unordered_map<page_id_t, frame_id_t> page_table_;
-  /** Replacer to find unpinned pages for replacement. */
-  Replacer *replacer_;
-  /** List of free pages. */
-  std::list<frame_id_t> free_list_;
-  /** This latch protects shared data structures. We recommend updating this comment to describe what it protects. */
-  std::mutex latch_;
+  /** Settings the buffer pool was created with. */
+  BufferPoolOptions options_;
+  /** Counters of every instance. */
+  BufferPoolMetrics metrics_;
+  /** Second tier for evicted pages, shared by all the instances, or nullptr if there is none. */
+  CompressedPageCache *compressed_cache_{nullptr};
+  /** Protects owner_names_, owner_ids_ and owner_quotas_. */
+  std::mutex owners_latch_;
+  /** Names of the registered owners, by owner id. */
+  std::vector<std::string> owner_names_;
+  /** Ids of the registered owners, by name. */
+  std::unordered_map<std::string, owner_id_t> owner_ids_;
+  /** Quotas of the registered owners, by owner id. */
+  std::vector<double> owner_quotas_;
+  /**
+   * The rest of an extent that was allocated for an owner: the next page to hand out, one past the last, and the pages
+   * that were handed out but given back, lowest first.
+   */
+  struct Extent {
+    page_id_t next_{0};
+    page_id_t end_{0};
+    std::vector<page_id_t> given_back_;
+  };
+  /** The current extent of every owner, by owner id, if options_.extent_size_ is set. */
+  std::vector<Extent> extents_;
+  /** Protects extents_. */
+  std::mutex extents_latch_;
+  /** The instances the buffer pool is split into. Each one protects its own frames with its own latch. */
+  std::vector<BufferPoolManagerInstance *> instances_;
+  /** Read-ahead requests that have not been served yet. */
+  std::deque<PrefetchRequest> prefetch_queue_;
+  /** Protects the read-ahead queue and thread. */
+  std::mutex prefetch_latch_;
+  /** Signalled when a read-ahead request is queued or the read-ahead thread should stop. */
+  std::condition_variable prefetch_cv_;
+  /** Thread serving the read-ahead queue, or nullptr if nothing has been read ahead yet. */
+  std::thread *prefetch_thread_{nullptr};
+  bool stop_prefetching_{false};
+  /** Protects stop_cleaning_. */
+  std::mutex cleaner_latch_;
+  /** Signalled when the page cleaner thread should stop. */
+  std::condition_variable cleaner_cv_;
+  /** The page cleaner thread, or nullptr if it is disabled. */
+  std::thread *page_cleaner_thread_{nullptr};
+  bool stop_cleaning_{false};
 };
 }  // namespace bustub
@@ -0,0 +1,403 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_manager_instance.h
+//
+// Identification: src/include/buffer/buffer_pool_manager_instance.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <list>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "buffer/buffer_access_strategy.h"
+#include "buffer/buffer_pool_metrics.h"
+#include "buffer/buffer_pool_options.h"
+#include "buffer/compressed_page_cache.h"
+#include "buffer/page_table.h"
+#include "buffer/replacer.h"
+#include "common/macros.h"
+#include "recovery/log_manager.h"
+#include "storage/disk/disk_manager.h"
+#include "storage/page/page.h"
+
+namespace bustub {
+
+/**
+ * BufferPoolManagerInstance manages one partition of the buffer pool: a subset of the frames, together with the page
+ * table, replacer and free list that track them, all protected by a latch of its own. Every page id maps to exactly
+ * one instance, so instances never have to coordinate with each other.
+ *
+ * The frames of all instances live in one array owned by the BufferPoolManager. Instance i of n owns the frames
+ * i, i + n, i + 2n, ...; frame ids used inside an instance are indexes into that subsequence.
+ *
+ * Disk I/O is done with the latch released, so a miss does not hold up hits on other pages:
+ * - a frame that is being read into is mapped in the page table right away and flagged io_in_progress_. Threads
+ *   that fetch the same page pin it and wait on io_cv_ until the read is done.
+ * - a frame that is being written back (eviction, FlushPage, FlushAllPages) stays mapped and is only pinned, so its
+ *   page can still be fetched and read while the write is in flight.
+ *
+ * Fetching a resident page and unpinning a page take no latch at all: the page table can be searched concurrently, and the frame is
+ * pinned with a compare-and-swap on its pin count that fails on free frames and frames being evicted (pin count -1).
+ * Since the frame may have been reused between the lookup and the pin, the page id is checked again once the pin is
+ * held. Anything that does not work out on the first try falls back to the latched path. Eviction in turn claims a
+ * frame by swapping its pin count from 0 to -1, so a frame that was pinned behind the replacer's back is left alone.
+ *
+ * Every frame is charged to the owner (table or index) whose access brought its page in. An owner with a quota that
+ * holds as many frames as its quota allows replaces its own pages, in the order they were brought in, instead of
+ * taking a frame from somebody else. The quota is a soft limit: if every page of the owner is in use, the miss goes to
+ * the replacer as usual.
+ *
+ * If the buffer pool has a CompressedPageCache, the clean pages that are evicted go there, and misses look there
+ * before reading from disk. Pages are compressed and decompressed with the latch released, while their frames are
+ * flagged io_in_progress_ as for a read.
+ */
+class BufferPoolManagerInstance {
+ public:
+  /**
+   * Creates a new BufferPoolManagerInstance.
+   * @param pool_size the number of frames owned by this instance
+   * @param max_pool_size the largest number of frames this instance can be resized to
+   * @param num_instances the total number of instances in the buffer pool
+   * @param instance_index the index of this instance, in [0, num_instances)
+   * @param pages the frame array shared by all instances
+   * @param metrics the metrics shared by all instances
+   * @param cache the compressed cache shared by all instances, or nullptr
+   * @param disk_manager the disk manager
+   * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param options the settings of the buffer pool
+   */
+  BufferPoolManagerInstance(size_t pool_size, size_t max_pool_size, size_t num_instances, size_t instance_index,
+                            Page *pages, BufferPoolMetrics *metrics, CompressedPageCache *cache,
+                            DiskManager *disk_manager, LogManager *log_manager, const BufferPoolOptions &options);
+
+  /**
+   * Destroys an existing BufferPoolManagerInstance.
+   */
+  ~BufferPoolManagerInstance();
+
+  DISALLOW_COPY_AND_MOVE(BufferPoolManagerInstance);
+
+  /**
+   * Fetch the requested page from this instance.
+   * @param page_id id of page to be fetched
+   * @param context how the page is being accessed
+   * @return the requested page, or nullptr if every frame is pinned
+   */
+  Page *FetchPage(page_id_t page_id, const AccessContext &context = AccessContext());
+
+  /**
+   * Fetches a page through the frame a SwizzledPageRef remembered for it, without looking at the page table.
+   * @param page the frame the reference remembered
+   * @param page_id id of the page, which maps to this instance
+   * @param context how the page is being accessed
+   * @return true if the frame still held the page and it is pinned now, false if the page has to be fetched
+   */
+  bool PinSwizzled(Page *page, page_id_t page_id, const AccessContext &context);
+
+  /**
+   * Pins the given pages on behalf of FetchPages(), so that the caller can read the missing ones in one batch
+   * together with the pages of the other instances. Resident pages are pinned right away. Missing pages are mapped to
+   * frames, as in FetchPage(), and handed back to be read, and anyone who fetches one of them meanwhile waits for
+   * FinishFetch(). Must be followed by FinishFetch() and then WaitForReads().
+   * @param page_ids ids of the pages to fetch, all of which map to this instance
+   * @param context how the pages are being accessed
+   * @param[out] pages receives the pinned page for every id, in order, or nullptr once every frame is pinned
+   * @param[out] reads receives the id and frame of every page to read
+   */
+  void StartFetch(const std::vector<page_id_t> &page_ids, const AccessContext &context, std::vector<Page *> *pages,
+                  std::vector<std::pair<page_id_t, char *>> *reads);
+
+  /**
+   * Opens the pages read on behalf of StartFetch() to everyone.
+   * @param reads the pages StartFetch() handed back to be read, after they were read
+   */
+  void FinishFetch(const std::vector<std::pair<page_id_t, char *>> &reads);
+
+  /**
+   * Waits until the pages returned by StartFetch() that were being read by somebody else have been read.
+   * @param pages the pages StartFetch() returned
+   */
+  void WaitForReads(const std::vector<Page *> &pages);
+
+  /**
+   * Unpin the target page.
+   * @param page_id id of page to be unpinned
+   * @param is_dirty true if the page should be marked as dirty, false otherwise
+   * @return false if the page is not resident, true otherwise
+   */
+  bool UnpinPage(page_id_t page_id, bool is_dirty);
+
+  /**
+   * Flushes the target page to disk.
+   * @param page_id id of page to be flushed
+   * @return false if the page could not be found in the page table, true otherwise
+   */
+  bool FlushPage(page_id_t page_id);
+
+  /**
+   * Creates a new page in this instance. The page must already have been allocated on disk and map to this instance.
+   * @param page_id id of the page to create
+   * @param context how the page is being accessed
+   * @return nullptr if every frame is pinned, otherwise pointer to the new page
+   */
+  Page *NewPage(page_id_t page_id, const AccessContext &context = AccessContext());
+
+  /**
+   * Deletes a page from this instance.
+   * @param page_id id of page to be deleted
+   * @return false if the page exists but could not be deleted, true if the page didn't exist or deletion succeeded
+   */
+  bool DeletePage(page_id_t page_id);
+
+  /**
+   * Pins the dirty pages of this instance and marks them clean, so that the caller can write them back in one batch
+   * together with the dirty pages of the other instances. Must be followed by FinishWriteBack() with the same pages
+   * once they are written.
+   * @param[out] pages receives the id and data of every page to write back
+   */
+  void StartWriteBack(std::vector<std::pair<page_id_t, const char *>> *pages);
+
+  /**
+   * Releases the pages handed out by StartWriteBack() after they were written.
+   * @param pages the pages StartWriteBack() returned
+   */
+  void FinishWriteBack(const std::vector<std::pair<page_id_t, const char *>> &pages);
+
+  /**
+   * @return the ids of the pages resident in this instance, hottest first according to the replacer
+   */
+  std::vector<page_id_t> ResidentPages();
+
+  /**
+   * Maps the given pages to free frames and pins them, so that the caller can read them in one batch together with
+   * the pages of the other instances. Pages that are resident already are skipped, and so are the pages that find no
+   * free frame. Anyone who fetches one of the pages meanwhile waits for FinishLoad().
+   * @param page_ids ids of the pages to load
+   * @param[out] pages receives the id and frame of every page to read
+   */
+  void StartLoad(const std::vector<page_id_t> &page_ids, std::vector<std::pair<page_id_t, char *>> *pages);
+
+  /**
+   * Releases the pages handed out by StartLoad() after they were read.
+   * @param pages the pages StartLoad() returned
+   */
+  void FinishLoad(const std::vector<std::pair<page_id_t, char *>> &pages);
+
+  /**
+   * Writes back dirty pages before they have to be evicted, so that evictions find clean frames. Called by the page
+   * cleaner. Pages are written in page id order.
+   * @param lookahead the number of upcoming eviction candidates to write back if they are dirty
+   * @param max_dirty_ratio fraction of dirty frames above which other unpinned dirty pages are written back too
+   * @return the number of pages written back
+   */
+  size_t CleanPages(size_t lookahead, double max_dirty_ratio);
+
+  /**
+   * Changes the number of frames owned by this instance. Frames are always added and taken away at the end, so when
+   * shrinking, the pages held by the last frames are evicted first, waiting for them to be unpinned if necessary.
+   * @param pool_size the new number of frames, at least one and at most the maximum size
+   * @param deadline when to give up waiting for pinned pages
+   * @return true if the instance has the new size, false if it gave up and kept its size
+   */
+  bool Resize(size_t pool_size, std::chrono::steady_clock::time_point deadline);
+
+  /** @return the number of frames owned by this instance */
+  size_t GetPoolSize() const { return pool_size_; }
+
+  /** @return a snapshot of the counters of this instance */
+  BufferPoolStats GetStats() { return metrics_->GetStats(instance_index_); }
+
+  /**
+   * Limits the number of frames of this instance an owner may hold. Lowering the quota does not evict anything right
+   * away; the owner gives frames back as it brings in more pages.
+   * @param owner_id the owner
+   * @param quota the largest fraction of the frames the owner may hold, or 0 for no limit
+   */
+  void SetOwnerQuota(owner_id_t owner_id, double quota);
+
+  /**
+   * Charges a resident page to another owner, as if that owner had brought it in. Does nothing if the page is not
+   * resident.
+   * @param page_id id of the page
+   * @param owner_id the owner
+   */
+  void ChargePage(page_id_t page_id, owner_id_t owner_id);
+
+  /**
+   * Adds the number of frames every owner holds in this instance to its stats.
+   * @param[in,out] stats the stats of the owners, by owner id
+   */
+  void AddOwnerStats(std::vector<BufferOwnerStats> *stats);
+
+ private:
+  /** @return the frame with the given instance-local id */
+  Page *GetFrame(frame_id_t frame_id) { return pages_ + frame_id * num_instances_ + instance_index_; }
+
+  /**
+   * Finds a frame that can hold a new page. A dirty victim is written back first, with the latch released, so the
+   * caller has to check again whether the page it wants was brought in meanwhile.
+   * @param context the access that needs the frame. Its ring, if any, is recycled first, and then the pages of its
+   * owner if the owner holds all of its quota, before turning to the replacer.
+   * @param lock the held instance latch
+   * @return a frame that is in neither the page table nor the replacer, or -1 if every frame is pinned. Frames that
+   * are being drained by a shrink are never returned.
+   */
+  frame_id_t victimPage(const AccessContext &context, std::unique_lock<std::mutex> *lock);
+  /**
+   * Evicts the page held by a frame that was just taken out of the replacer, writing it back first if it is dirty.
+   * @return true if the frame is free now, false if somebody started using the page again during the write-back
+   */
+  bool evictFrame(frame_id_t frame_id, std::unique_lock<std::mutex> *lock);
+  /** @return the ring frame the strategy wants recycled next, evicted, or -1 if it cannot be recycled */
+  frame_id_t ringVictim(BufferAccessStrategy *strategy, std::unique_lock<std::mutex> *lock);
+  /** @return the oldest unused frame of an owner that holds all of its quota, evicted, or -1 if there is none */
+  frame_id_t quotaVictim(owner_id_t owner_id, std::unique_lock<std::mutex> *lock);
+  /** Charges a frame that was just mapped to a page to the given owner. */
+  void addOwnerFrame(frame_id_t frame_id, owner_id_t owner_id);
+  /** Takes a frame whose page was just evicted or dropped off its owner's account. */
+  void removeOwnerFrame(frame_id_t frame_id);
+  /**
+   * Pins the frame holding a page without taking the latch.
+   * @return the pinned frame, or -1 if the page was not found or its frame is changing hands
+   */
+  frame_id_t pinResident(page_id_t page_id);
+  /**
+   * Pins a frame if it holds the given page, without taking the latch.
+   * @return false if the frame holds another page, none, or is changing hands
+   */
+  bool pinFrame(frame_id_t frame_id, page_id_t page_id);
+  /** Finishes a fetch that found the page resident and pinned it. */
+  Page *hitFrame(frame_id_t frame_id, const AccessContext &context);
+  /** Pins a resident page on behalf of a fetch that holds the latch, without waiting for it to be read. */
+  Page *pinLatched(frame_id_t frame_id, const AccessContext &context);
+  /** Accounts for a fetch that found the page resident, once the page is pinned. */
+  void recordHit(frame_id_t frame_id, const AccessContext &context);
+  /** Accounts for a fetch that missed, before its page is read into the given frame. */
+  void recordMiss(frame_id_t frame_id, page_id_t page_id, const AccessContext &context);
+  /**
+   * Maps a free frame to a page that is about to be read into it on behalf of the given owner, and pins it. The page
+   * is flagged io_in_progress_, so that anyone who fetches it meanwhile waits for the read.
+   */
+  Page *startRead(frame_id_t frame_id, page_id_t page_id, owner_id_t owner_id);
+  /** A page that was just evicted from a frame, on its way to the compressed cache. */
+  struct EvictedPage {
+    /** The page, or INVALID_PAGE_ID if there is nothing to put into the cache. */
+    page_id_t page_id_{INVALID_PAGE_ID};
+    uint64_t ticket_{0};
+  };
+  /**
+   * Reserves the page that a frame just returned by victimPage() held, if any, in the compressed cache. Must be called
+   * before the frame is mapped to another page.
+   */
+  EvictedPage reserveEvicted(frame_id_t frame_id);
+  /** Puts a page that reserveEvicted() reserved into the compressed cache. Called with the latch released. */
+  void cacheEvicted(const EvictedPage &evicted, const char *data);
+  /**
+   * Fills a frame that is being read into, with the latch released: from the compressed copy of its page if there is
+   * one, or else from disk.
+   * @param page the frame, flagged io_in_progress_
+   * @param compressed the compressed page the cache handed out, or nullptr
+   */
+  void readPage(Page *page, const std::string *compressed);
+  /** Waits until a pinned page is no longer being read in. */
+  void waitForRead(Page *page);
+  /**
+   * Drops the page held by a frame without writing it back, and puts the frame on the free list.
+   * @return false if the page is pinned
+   */
+  bool dropFrame(frame_id_t frame_id);
+  /** Makes the frame that now holds page_id the strategy's most recent ring entry. */
+  void addToRing(BufferAccessStrategy *strategy, frame_id_t frame_id, page_id_t page_id);
+  /** @return the number of frames the strategy may occupy in this instance */
+  size_t ringCapacity(const BufferAccessStrategy *strategy) const;
+  /** @return true if no frame is free or evictable. O(1), unlike looking at every frame. */
+  bool allPinned() { return free_list_.empty() && replacer_->Size() == 0; }
+  /** Drops one pin on a frame, handing it to the replacer when it was the last one. Does not need the latch. */
+  void unpinFrame(frame_id_t frame_id);
+  /** Drops a pin the buffer pool took for its own purposes. Unlike unpinFrame(), this is not a use of the page. */
+  void releaseFrame(frame_id_t frame_id);
+  /**
+   * Hands a frame whose pin count just dropped to 0 to the replacer. The frame may be pinned again, and the replacer
+   * told so, before we get to tell it, so the pin count is checked again afterwards until the replacer agrees with it.
+   * @param frame_id the frame
+   * @param release true if the last pin was not a use of the page, see releaseFrame()
+   */
+  void frameUnpinned(frame_id_t frame_id, bool release);
+  /**
+   * Writes back the given pages in one batch, with the latch released. The frames are pinned while they are written.
+   * @param pages (page id, frame id) of the dirty pages to write back
+   * @param lock the held instance latch
+   */
+  void writeBack(const std::vector<std::pair<page_id_t, frame_id_t>> &pages, std::unique_lock<std::mutex> *lock);
+
+  /** Number of frames owned by this instance. */
+  std::atomic<size_t> pool_size_;
+  /** Number of frames that may take new pages: pool_size_, or less while a shrink is draining the frames behind. */
+  size_t usable_frames_;
+  /** Largest number of frames this instance can be resized to. Everything indexed by frame id has room for them. */
+  size_t max_pool_size_;
+  /** Number of instances in the buffer pool. */
+  size_t num_instances_;
+  /** Index of this instance. */
+  size_t instance_index_;
+  /** Frame array shared by all instances. */
+  Page *pages_;
+  /** Metrics shared by all instances, which keep count of what happens in this one under instance_index_. */
+  BufferPoolMetrics *metrics_;
+  /** Compressed cache shared by all instances, or nullptr. */
+  CompressedPageCache *cache_;
+  /** Pointer to the disk manager. */
+  DiskManager *disk_manager_;
+  /** Pointer to the log manager. */
+  LogManager *log_manager_ __attribute__((__unused__));
+  /** Page table for keeping track of the pages resident in this instance. Written under the latch only. */
+  PageTable page_table_;
+  /** Replacer to find unpinned frames for replacement. */
+  Replacer *replacer_;
+  /** List of free frames. */
+  std::list<frame_id_t> free_list_;
+  /**
+   * Protects changes to the page table, the free list and the metadata of the frames owned by this
+   * instance. Pinning a resident page does not need it.
+   */
+  std::mutex latch_;
+  /** Signalled whenever a frame of this instance finishes reading in its page. */
+  std::condition_variable io_cv_;
+
+  /** The owner a frame is charged to, and its neighbours in the owner's list of frames. */
+  struct FrameOwner {
+    owner_id_t owner_id_{NO_OWNER};
+    frame_id_t prev_{-1};
+    frame_id_t next_{-1};
+  };
+
+  /** The frames an owner holds in this instance. */
+  struct OwnerFrames {
+    /** Number of frames charged to the owner. */
+    size_t resident_{0};
+    /** Largest fraction of the frames the owner may hold, or 0 for no limit. */
+    double quota_{0};
+    /** First and last frame charged to the owner, in the order their pages were brought in, or -1. */
+    frame_id_t head_{-1};
+    frame_id_t tail_{-1};
+  };
+
+  /** The owner of every frame, by frame id. Protected by the latch. */
+  std::vector<FrameOwner> frame_owners_;
+  /** The frames of every owner, by owner id. Protected by the latch. */
+  std::vector<OwnerFrames> owners_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,315 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_metrics.h
+//
+// Identification: src/include/buffer/buffer_pool_metrics.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "buffer/buffer_access_strategy.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/** @return the name of an access category, as used in metric labels */
+const char *AccessCategoryName(AccessCategory category);
+
+/**
+ * A histogram of latencies. The buckets double in width: bucket 0 counts latencies of 0 ns, bucket i > 0 those in
+ * [2^(i-1), 2^i) ns, and the last bucket everything from 2^(NUM_BUCKETS-2) ns up.
+ */
+struct LatencyHistogram {
+  static constexpr size_t NUM_BUCKETS = 32;
+
+  /** Number of latencies per bucket. */
+  std::array<uint64_t, NUM_BUCKETS> buckets_{};
+  /** Number of latencies recorded. */
+  uint64_t count_{0};
+  /** Sum of the latencies recorded, in nanoseconds. */
+  uint64_t sum_ns_{0};
+
+  /** @return the bucket a latency in nanoseconds falls into */
+  static size_t BucketOf(uint64_t ns) {
+    return ns == 0 ? 0 : std::min<size_t>(64 - __builtin_clzll(ns), NUM_BUCKETS - 1);
+  }
+
+  /** @return the smallest latency in nanoseconds beyond the given bucket, or the largest latency for the last one */
+  static uint64_t UpperBound(size_t bucket) { return bucket + 1 < NUM_BUCKETS ? uint64_t{1} << bucket : UINT64_MAX; }
+
+  /**
+   * @param quantile the quantile, e.g. 0.99
+   * @return the upper bound of the bucket holding the quantile, or 0 if nothing was recorded
+   */
+  uint64_t Quantile(double quantile) const;
+
+  LatencyHistogram &operator+=(const LatencyHistogram &other);
+};
+
+/**
+ * Counters of a buffer pool, or of one of its instances.
+ */
+struct BufferPoolStats {
+  /** Number of fetches that found the page resident. */
+  uint64_t hits_{0};
+  /** Number of fetches that had to read the page from disk. */
+  uint64_t misses_{0};
+  /** Number of resident pages that were replaced to make room for another page. */
+  uint64_t evictions_{0};
+  /** Number of dirty pages written back to disk. */
+  uint64_t writebacks_{0};
+  /** Number of pages read from disk ahead of their use. */
+  uint64_t prefetches_{0};
+  /** Number of dirty pages written back by the page cleaner, included in writebacks_. */
+  uint64_t cleaner_writebacks_{0};
+  /** hits_, by the category of the fetch. */
+  std::array<uint64_t, NUM_ACCESS_CATEGORIES> category_hits_{};
+  /** misses_, by the category of the fetch. */
+  std::array<uint64_t, NUM_ACCESS_CATEGORIES> category_misses_{};
+  /** Number of fetches that found their page still being read in by somebody else, and had to wait for it. */
+  uint64_t pin_waits_{0};
+  /** Total time those fetches waited, in nanoseconds. */
+  uint64_t pin_wait_ns_{0};
+  /** Latency of a sample of the calls to FetchPage(), read-ahead excepted. */
+  LatencyHistogram fetch_latency_;
+  /** Latency of a sample of the calls to NewPage(). */
+  LatencyHistogram new_page_latency_;
+
+  /** @return the fraction of fetches that were hits, or 0 if there were none */
+  double HitRatio() const {
+    return hits_ + misses_ == 0 ? 0 : static_cast<double>(hits_) / static_cast<double>(hits_ + misses_);
+  }
+
+  BufferPoolStats &operator+=(const BufferPoolStats &other);
+
+  /**
+   * Formats the counters in the Prometheus text format, one sample per line, e.g.
+   * bustub_buffer_pool_hits_total{category="index"} 42
+   * @return the formatted counters
+   */
+  std::string ToString() const;
+};
+
+/**
+ * What the buffer pool holds of one owner, i.e. a table or an index, and what happened to its pages.
+ */
+struct BufferOwnerStats {
+  /** Id of the owner. */
+  owner_id_t owner_id_{NO_OWNER};
+  /** Name the owner was registered with. */
+  std::string name_;
+  /** Largest fraction of the buffer pool the owner may hold, or 0 for no limit. */
+  double quota_{0};
+  /** Number of frames holding pages of the owner. */
+  size_t resident_frames_{0};
+  /** Number of fetches on behalf of the owner that found the page resident. */
+  uint64_t hits_{0};
+  /** Number of fetches on behalf of the owner that had to read the page from disk. */
+  uint64_t misses_{0};
+  /** Number of pages of the owner that were replaced to make room for another page. */
+  uint64_t evictions_{0};
+  /** Evictions that replaced a page of the owner with another one of its pages because it held all of its quota. */
+  uint64_t quota_evictions_{0};
+};
+
+/**
+ * Formats the stats of the owners in the Prometheus text format, one sample per owner and counter, e.g.
+ * bustub_buffer_pool_owner_resident_frames{owner="table:orders"} 42
+ * @param stats the stats of the owners
+ * @return the formatted stats
+ */
+std::string OwnerStatsToString(const std::vector<BufferOwnerStats> &stats);
+
+/**
+ * BufferPoolMetrics collects the counters of all the instances of a buffer pool.
+ *
+ * The counters are bumped on every fetch, by every thread, so they must not become a point of contention themselves.
+ * Every thread therefore gets counters of its own, which only it writes to, and reading the metrics adds up the
+ * counters of all the threads that ever used the buffer pool. Bumping a counter is a plain load and store, and the
+ * cache lines of a thread's counters are never written by anybody else. When a thread exits, its counters are added to
+ * those of the threads that exited before, and handed to the next thread that comes along.
+ */
+class BufferPoolMetrics {
+ public:
+  /**
+   * Creates metrics with all counters at zero.
+   * @param num_instances the number of instances to keep counters for
+   * @param latency_sample_interval one in how many operations SampleLatency() picks on average, or 0 for none
+   * @param max_owners the number of owners to keep counters for
+   */
+  BufferPoolMetrics(size_t num_instances, size_t latency_sample_interval, size_t max_owners);
+
+  ~BufferPoolMetrics();
+
+  DISALLOW_COPY_AND_MOVE(BufferPoolMetrics);
+
+  /**
+   * Decides whether the calling thread should time the operation it is about to do. The operations are picked at
+   * random intervals, so that a workload that repeats itself is not always caught at the same step.
+   * @return true if the operation should be timed and recorded
+   */
+  bool SampleLatency() {
+    if (latency_sample_interval_ == 0) {
+      return false;
+    }
+    auto thread = Local();
+    if (thread->sample_countdown_ > 0) {
+      thread->sample_countdown_--;
+      return false;
+    }
+    // xorshift64, to draw the next interval uniformly from [0, 2 * latency_sample_interval_ - 1).
+    thread->random_ ^= thread->random_ << 13;
+    thread->random_ ^= thread->random_ >> 7;
+    thread->random_ ^= thread->random_ << 17;
+    thread->sample_countdown_ = thread->random_ % (2 * latency_sample_interval_ - 1);
+    return true;
+  }
+
+  void RecordHit(size_t instance_index, const AccessContext &context) {
+    auto thread = Local();
+    Bump(&thread->instances_[instance_index].hits_[static_cast<size_t>(context.category_)]);
+    Bump(&thread->owners_[context.owner_].hits_);
+  }
+  void RecordMiss(size_t instance_index, const AccessContext &context) {
+    auto thread = Local();
+    Bump(&thread->instances_[instance_index].misses_[static_cast<size_t>(context.category_)]);
+    Bump(&thread->owners_[context.owner_].misses_);
+  }
+  void RecordEviction(size_t instance_index, owner_id_t owner_id) {
+    auto thread = Local();
+    Bump(&thread->instances_[instance_index].evictions_);
+    Bump(&thread->owners_[owner_id].evictions_);
+  }
+  void RecordQuotaEviction(owner_id_t owner_id) { Bump(&Local()->owners_[owner_id].quota_evictions_); }
+  void RecordWriteBacks(size_t instance_index, uint64_t count) { Bump(&Local(instance_index)->writebacks_, count); }
+  void RecordCleanerWriteBacks(size_t instance_index, uint64_t count) {
+    Bump(&Local(instance_index)->cleaner_writebacks_, count);
+  }
+  void RecordPrefetches(size_t instance_index, uint64_t count) { Bump(&Local(instance_index)->prefetches_, count); }
+  void RecordPinWait(size_t instance_index, uint64_t ns) {
+    auto counters = Local(instance_index);
+    Bump(&counters->pin_waits_);
+    Bump(&counters->pin_wait_ns_, ns);
+  }
+  void RecordFetchLatency(size_t instance_index, uint64_t ns) { Record(&Local(instance_index)->fetch_latency_, ns); }
+  void RecordNewPageLatency(size_t instance_index, uint64_t ns) {
+    Record(&Local(instance_index)->new_page_latency_, ns);
+  }
+
+  /**
+   * @param instance_index index of the instance
+   * @return the counters of the given instance, added up over all threads
+   */
+  BufferPoolStats GetStats(size_t instance_index);
+
+  /**
+   * Adds the counters of the owners to their stats, added up over all threads.
+   * @param[in,out] stats the stats of the owners, by owner id
+   */
+  void AddOwnerStats(std::vector<BufferOwnerStats> *stats);
+
+ private:
+  /** LatencyHistogram, written by a single thread. */
+  struct Histogram {
+    std::atomic<uint64_t> buckets_[LatencyHistogram::NUM_BUCKETS]{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_ns_{0};
+  };
+
+  /** The counters of one instance, written by a single thread. */
+  struct alignas(64) Counters {
+    std::atomic<uint64_t> hits_[NUM_ACCESS_CATEGORIES]{};
+    std::atomic<uint64_t> misses_[NUM_ACCESS_CATEGORIES]{};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> writebacks_{0};
+    std::atomic<uint64_t> cleaner_writebacks_{0};
+    std::atomic<uint64_t> prefetches_{0};
+    std::atomic<uint64_t> pin_waits_{0};
+    std::atomic<uint64_t> pin_wait_ns_{0};
+    Histogram fetch_latency_;
+    Histogram new_page_latency_;
+  };
+
+  /** The counters of one owner, written by a single thread. */
+  struct OwnerCounters {
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> quota_evictions_{0};
+  };
+
+  /** The counters of one thread, by instance and by owner. */
+  struct ThreadCounters {
+    ThreadCounters(size_t num_instances, size_t max_owners) : instances_(num_instances), owners_(max_owners) {}
+    std::vector<Counters> instances_;
+    std::vector<OwnerCounters> owners_;
+    /** State of SampleLatency(), only ever touched by the thread. */
+    uint64_t random_{0x9E3779B97F4A7C15ULL};
+    uint64_t sample_countdown_{0};
+  };
+
+  /** Adds to a counter that only the calling thread writes to, which needs no atomic read-modify-write. */
+  static void Bump(std::atomic<uint64_t> *counter, uint64_t count = 1) {
+    counter->store(counter->load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+  }
+
+  static void Record(Histogram *histogram, uint64_t ns) {
+    Bump(&histogram->buckets_[LatencyHistogram::BucketOf(ns)]);
+    Bump(&histogram->count_);
+    Bump(&histogram->sum_ns_, ns);
+  }
+
+  /** @return the calling thread's counters */
+  ThreadCounters *Local() {
+    // Most threads only ever use one buffer pool, so the counters of the last one are kept at hand.
+    thread_local uint64_t cached_id = 0;
+    thread_local ThreadCounters *cached = nullptr;
+    if (cached_id != id_) {
+      cached = localThreadCounters();
+      cached_id = id_;
+    }
+    return cached;
+  }
+
+  /** @return the calling thread's counters of the given instance */
+  Counters *Local(size_t instance_index) { return &Local()->instances_[instance_index]; }
+
+  /** @return the calling thread's counters, created on its first use of this buffer pool */
+  ThreadCounters *localThreadCounters();
+
+  /**
+   * Adds the counters of a thread that exited to retired_ and frees them for another thread.
+   * @param counters the counters, which nobody writes to anymore
+   */
+  void retire(ThreadCounters *counters);
+
+  /** Identifies these metrics in the threads' caches. Never reused, unlike the address. */
+  uint64_t id_;
+  size_t num_instances_;
+  size_t latency_sample_interval_;
+  size_t max_owners_;
+  /** Protects retired_, threads_ and free_threads_. */
+  std::mutex latch_;
+  /** The counters of the threads that have exited, added up. */
+  ThreadCounters retired_;
+  /** The counters of every thread that uses the buffer pool. Those in free_threads_ are all zero. */
+  std::vector<std::unique_ptr<ThreadCounters>> threads_;
+  /** Counters in threads_ whose thread has exited. */
+  std::vector<ThreadCounters *> free_threads_;
+};
+
+}  // namespace bustub
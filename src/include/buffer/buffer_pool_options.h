@@ -0,0 +1,83 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_options.h
+//
+// Identification: src/include/buffer/buffer_pool_options.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <chrono>  // NOLINT
+#include <cstddef>
+#include <string>
+
+namespace bustub {
+
+/** Replacement policies the buffer pool can be built with. */
+enum class ReplacerType { CLOCK, LRU_K };
+
+/**
+ * Settings that are fixed when a BufferPoolManager is created. The defaults give the classic buffer pool.
+ */
+struct BufferPoolOptions {
+  /**
+   * The largest size the buffer pool can be resized to, or 0 for the size it is created with. The bookkeeping of
+   * every frame up to this size is set up front, but memory for the pages themselves is only used by the frames the
+   * pool currently has.
+   */
+  size_t max_pool_size_{0};
+  /** The replacement policy of every instance. */
+  ReplacerType replacer_type_{ReplacerType::CLOCK};
+  /** For LRU_K: the number of past references used to rank a page. */
+  size_t lru_k_{2};
+  /** For LRU_K: references within this many buffer pool accesses of the previous one count as the same reference. */
+  size_t lru_k_correlated_reference_period_{2};
+  /** True to run a background thread that writes dirty pages back before they are evicted. */
+  bool enable_page_cleaner_{false};
+  /** How long the page cleaner sleeps between rounds. */
+  std::chrono::milliseconds page_cleaner_interval_{10};
+  /** Number of upcoming eviction candidates per instance that the page cleaner keeps clean. */
+  size_t page_cleaner_lookahead_{16};
+  /** Fraction of dirty frames above which the page cleaner writes back pages that are not about to be evicted too. */
+  double page_cleaner_max_dirty_ratio_{0.5};
+  /**
+   * The latency histograms of FetchPage() and NewPage() time one in this many calls on average, picked at random, or
+   * none for 0. Reading the clock costs about as much as a hit, so timing every call would double its cost.
+   */
+  size_t latency_sample_interval_{16};
+  /** The number of owners, i.e. tables and indexes, the buffer pool keeps counters for. Later owners count as none. */
+  size_t max_owners_{256};
+  /**
+   * Memory, in bytes, for a second tier that keeps evicted pages compressed, so that fetching them again does not go
+   * to disk, or 0 for none. See CompressedPageCache.
+   */
+  size_t compressed_cache_size_{0};
+  /**
+   * True to let the SwizzledPageRef of a page remember the frame of the page, so that fetching the page through it
+   * skips the page table. False to fetch through the page table regardless.
+   */
+  bool enable_pointer_swizzling_{false};
+  /**
+   * Number of pages allocated on disk at a time for every owner, so that the pages of a table or index lie together in
+   * the file and scans of it read sequentially, or 0 to allocate page by page. Pages of NO_OWNER are always allocated
+   * one by one.
+   */
+  size_t extent_size_{0};
+  /**
+   * True to back the page data with huge pages, which cuts TLB misses on large pools: reserved huge pages if the system
+   * has enough of them, or else transparent huge pages.
+   */
+  bool use_huge_pages_{false};
+  /**
+   * File to remember the hot pages in, or empty to start cold. If set, the resident pages are saved to it when the
+   * buffer pool is destroyed, and loaded back in the background when the next buffer pool is created with it.
+   */
+  std::string warm_start_file_;
+};
+
+}  // namespace bustub
@@ -12,9 +12,9 @@
 
 #pragma once
 
-#include <list>
-#include <mutex>  // NOLINT
-#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include <vector>
 
 #include "buffer/replacer.h"
 #include "common/config.h"
@@ -23,6 +23,16 @@ namespace bustub {
 
 /**
  * ClockReplacer implements the clock replacement policy, which approximates the Least Recently Used policy.
+ *
+ * Every frame has a slot in a fixed-size array holding two bits: whether the frame may be victimized and whether it
+ * was referenced since the clock hand last passed it. The replacer takes no latch: Pin and Unpin are a single atomic
+ * read-modify-write on the frame's slot, and Victim advances the shared clock hand atomically and claims a frame by clearing
+ * its slot with a compare-and-swap, so concurrent victimizers never pick the same frame. Nothing is allocated after
+ * construction.
+ *
+ * The slot also holds the retention class of the frame. The hand passes over frames of classes above the lowest one
+ * that has an evictable frame, without touching their reference bits, so each class is victimized in clock order once
+ * the classes below it have nothing left.
  */
 class ClockReplacer : public Replacer {
  public:
@@ -43,17 +53,43 @@ class ClockReplacer : public Replacer {
 
   void Unpin(frame_id_t frame_id) override;
 
+  void Release(frame_id_t frame_id) override;
+
+  std::vector<frame_id_t> EvictionCandidates(size_t max_frames) override;
+
   size_t Size() override;
 
+  void SetRetentionClass(frame_id_t frame_id, RetentionClass retention) override;
+
  private:
-  // a non-thread-safe implementation for unpinning page
-  void PinImpl(frame_id_t frame_id);
-
-  std::mutex mux_;
-  std::list<frame_id_t> frames_;
-  std::list<frame_id_t>::iterator clock_hand_;
-  std::unordered_map<frame_id_t, bool> ref_flag_;
-  std::unordered_map<frame_id_t, std::list<frame_id_t>::iterator> pin_pos_;
+  /** Set if the frame is unpinned and may be victimized. */
+  static constexpr uint8_t EVICTABLE = 0x1;
+  /** Set if the frame was unpinned since the clock hand last passed it. */
+  static constexpr uint8_t REFERENCED = 0x2;
+  /** The retention class of the frame. */
+  static constexpr uint8_t CLASS_SHIFT = 2;
+  static constexpr uint8_t CLASS_MASK = 0x3 << CLASS_SHIFT;
+
+  /** @return the retention class of a frame with the given state */
+  static size_t ClassOf(uint8_t state) { return (state & CLASS_MASK) >> CLASS_SHIFT; }
+
+  /** Makes a frame victimizable, setting the given extra bits, and keeps the evictable counts in step. */
+  void MakeEvictable(frame_id_t frame_id, uint8_t bits);
+
+  /** Adds to the number of evictable frames, in total and of the given class. */
+  void AddEvictable(size_t retention, int64_t delta);
+
+  /** @return the lowest retention class with an evictable frame, or NUM_RETENTION_CLASSES if there is none */
+  size_t LowestClass() const;
+
+  size_t num_pages_;
+  std::vector<std::atomic<uint8_t>> states_;
+  /** Position of the clock hand. Only ever incremented; the frame it points at is the value modulo num_pages_. */
+  std::atomic<size_t> clock_hand_{0};
+  /** Number of evictable frames. Signed, because a claim may be counted before the unpin that made it possible. */
+  std::atomic<int64_t> size_{0};
+  /** Number of evictable frames of every retention class, kept like size_. */
+  std::atomic<int64_t> class_sizes_[NUM_RETENTION_CLASSES];
 };
 
 }  // namespace bustub
@@ -0,0 +1,163 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compressed_page_cache.h
+//
+// Identification: src/include/buffer/compressed_page_cache.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * Counters of a CompressedPageCache.
+ */
+struct CompressedPageCacheStats {
+  /** Number of pages looked up on a buffer pool miss that were found, and did not have to be read from disk. */
+  uint64_t hits_{0};
+  /** Number of pages looked up on a buffer pool miss that were not found. */
+  uint64_t misses_{0};
+  /** Number of pages put into the cache. */
+  uint64_t insertions_{0};
+  /** Number of pages dropped to make room for others. */
+  uint64_t evictions_{0};
+  /** Total size of the pages put into the cache, before and after compression. */
+  uint64_t bytes_in_{0};
+  uint64_t bytes_stored_{0};
+  /** Number of pages in the cache. */
+  size_t num_pages_{0};
+  /** Memory used by those pages, and the memory the cache may use. */
+  size_t used_bytes_{0};
+  size_t capacity_bytes_{0};
+
+  /** @return the fraction of lookups that were hits, or 0 if there were none */
+  double HitRatio() const { return hits_ + misses_ == 0 ? 0 : static_cast<double>(hits_) / (hits_ + misses_); }
+
+  /** @return how many times smaller the pages got on average, or 0 if none were put into the cache */
+  double CompressionRatio() const {
+    return bytes_stored_ == 0 ? 0 : static_cast<double>(bytes_in_) / static_cast<double>(bytes_stored_);
+  }
+
+  /**
+   * Formats the counters in the Prometheus text format, one sample per line.
+   * @return the formatted counters
+   */
+  std::string ToString() const;
+};
+
+/**
+ * CompressedPageCache is a second tier below the buffer pool. It keeps pages that were evicted from the buffer pool,
+ * compressed, in a fixed amount of memory, so that bringing one back costs a decompression instead of a disk read.
+ *
+ * Evicted pages are clean, either because they were never changed or because they were written back first, so the
+ * cache never holds the only copy of a page and can drop pages at will. When the cache is full, the pages that were
+ * put in first are dropped first. A page that is brought back into the buffer pool is taken out of the cache: the
+ * copy in the buffer pool is the one that counts from then on.
+ *
+ * A page is compressed after the buffer pool has released its latch, by which time the page may have been brought
+ * back and changed already. To keep such stale copies out, the eviction reserves the page while the buffer pool still
+ * holds its latch, and Put() only stores the page if nobody removed it since.
+ *
+ * The memory is one arena, split into chunks of CHUNK_SIZE bytes, and a page takes as many chunks as it needs.
+ */
+class CompressedPageCache {
+ public:
+  /** Size of the pieces the memory of the cache is split into. */
+  static constexpr size_t CHUNK_SIZE = 256;
+
+  /**
+   * Creates an empty cache.
+   * @param capacity the memory the cache may use for pages, in bytes
+   */
+  explicit CompressedPageCache(size_t capacity);
+
+  ~CompressedPageCache();
+
+  DISALLOW_COPY_AND_MOVE(CompressedPageCache);
+
+  /**
+   * Announces that a page is about to be put into the cache. Must be called under the latch that protects the page
+   * in the buffer pool, when the page is evicted.
+   * @param page_id id of the evicted page
+   * @return the ticket to hand to Put()
+   */
+  uint64_t Reserve(page_id_t page_id);
+
+  /**
+   * Compresses a page and puts it into the cache, unless it was removed since it was reserved.
+   * @param page_id id of the page
+   * @param ticket the ticket Reserve() returned
+   * @param data the content of the page, PAGE_SIZE bytes
+   */
+  void Put(page_id_t page_id, uint64_t ticket, const char *data);
+
+  /**
+   * Takes a page out of the cache and cancels its reservation, if any. Must be called under the latch that protects
+   * the page in the buffer pool, whenever the page is brought into the buffer pool, created or deleted.
+   * @param page_id id of the page
+   * @param[out] compressed if not nullptr, receives the compressed page for Restore(), and the lookup is counted
+   * @return true if the page was in the cache
+   */
+  bool Remove(page_id_t page_id, std::string *compressed = nullptr);
+
+  /**
+   * Decompresses a page that Remove() handed out.
+   * @param compressed the compressed page
+   * @param[out] data receives the page, PAGE_SIZE bytes
+   * @return false if the page could not be decompressed
+   */
+  static bool Restore(const std::string &compressed, char *data);
+
+  /** @return a snapshot of the counters of the cache */
+  CompressedPageCacheStats GetStats();
+
+ private:
+  /** A page in the cache. */
+  struct Entry {
+    /** First chunk of the page; the others follow through next_chunk_. */
+    int32_t first_chunk_;
+    /** Size of the page in the cache. PAGE_SIZE means that it did not compress and is stored as is. */
+    size_t size_;
+    /** Position in fifo_. */
+    std::list<page_id_t>::iterator position_;
+  };
+
+  /** Drops a page, handing its chunks back. */
+  void erase(std::unordered_map<page_id_t, Entry>::iterator entry);
+
+  /** Number of chunks in the arena. */
+  size_t num_chunks_;
+  /** Memory for the pages. */
+  char *arena_;
+  /** The chunk after every chunk of a page, or -1 after its last chunk. */
+  std::vector<int32_t> next_chunk_;
+  /** Chunks that hold no page. */
+  std::vector<int32_t> free_chunks_;
+  /** The pages in the cache. */
+  std::unordered_map<page_id_t, Entry> entries_;
+  /** The pages in the cache, in the order they were put in. */
+  std::list<page_id_t> fifo_;
+  /** The ticket of every page that was reserved and not put into the cache or removed since. */
+  std::unordered_map<page_id_t, uint64_t> reservations_;
+  uint64_t next_ticket_{1};
+  CompressedPageCacheStats stats_;
+  /** Protects everything above. */
+  std::mutex latch_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,120 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.h
+//
+// Identification: src/include/buffer/lru_k_replacer.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <mutex>  // NOLINT
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * LRUKReplacer implements the LRU-K replacement policy (O'Neil et al., SIGMOD '93).
+ *
+ * Every frame remembers the logical times of the last K uncorrelated references to its page. The victim is the
+ * evictable frame whose K-th most recent reference lies furthest in the past (its backward K-distance is largest).
+ * Frames with fewer than K references have an infinite backward K-distance and are evicted first, oldest reference
+ * first. Pages touched once by a scan therefore leave before pages that are looked up again and again.
+ *
+ * References made within the correlated reference period of the previous one count as the same reference, so a page
+ * that is fetched several times in a row by one operation does not look hot. Frames that were referenced within the
+ * correlated reference period are not evicted unless there is no other choice.
+ *
+ * History is kept per frame and forgotten when the frame is victimized, i.e. there is no retained information
+ * period for pages that are no longer resident.
+ *
+ * Retention classes come before all of the above: a frame is only victimized if no frame of a lower class can be.
+ *
+ * The evictable frames are kept ordered by (retention class, K-th reference, last reference), so that finding the
+ * victim costs O(log n) rather than a pass over all frames. Whether a frame is within its correlated reference period
+ * depends on the current time and so cannot be part of the order, but at most correlated_reference_period frames can
+ * be within it at once, and those are skipped on the way.
+ */
+class LRUKReplacer : public Replacer {
+ public:
+  /**
+   * Create a new LRUKReplacer.
+   * @param num_frames the maximum number of frames the LRUKReplacer will be required to store
+   * @param k the number of references used to rank a frame
+   * @param correlated_reference_period references within this many accesses of the previous one are correlated
+   */
+  LRUKReplacer(size_t num_frames, size_t k, size_t correlated_reference_period = 0);
+
+  /**
+   * Destroys the LRUKReplacer.
+   */
+  ~LRUKReplacer() override;
+
+  bool Victim(frame_id_t *frame_id) override;
+
+  void Pin(frame_id_t frame_id) override;
+
+  void Unpin(frame_id_t frame_id) override;
+
+  size_t Size() override;
+
+  void RecordAccess(frame_id_t frame_id) override;
+
+  void SetRetentionClass(frame_id_t frame_id, RetentionClass retention) override;
+
+  void Remove(frame_id_t frame_id) override;
+
+  std::vector<frame_id_t> EvictionCandidates(size_t max_frames) override;
+
+ private:
+  /** What the replacer knows about one frame. */
+  struct FrameHistory {
+    /** Times of the last K uncorrelated references, most recent first. Unused entries are 0. */
+    std::vector<uint64_t> history_;
+    /** Time of the most recent reference, correlated or not. */
+    uint64_t last_ = 0;
+    /** True if the frame is unpinned and may be victimized. */
+    bool evictable_ = false;
+    /** The retention class of the page. */
+    RetentionClass retention_ = RetentionClass::HEAP;
+  };
+
+  /** Position of an evictable frame in the eviction order: retention class, K-th reference, last reference. */
+  using EvictionKey = std::tuple<RetentionClass, uint64_t, uint64_t, frame_id_t>;
+
+  /** @return the position of a frame in the eviction order. Must be called with the latch held. */
+  EvictionKey Key(frame_id_t frame_id) const {
+    const auto &frame = frames_[frame_id];
+    return {frame.retention_, frame.history_[k_ - 1], frame.last_, frame_id};
+  }
+
+  /**
+   * Finds the frames that are to be evicted first, in order. Must be called with the latch held.
+   * @param max_frames the largest number of frames to return
+   * @return the frames
+   */
+  std::vector<frame_id_t> NextVictims(size_t max_frames) const;
+
+  /** Forgets everything about a frame. Must be called with the latch held. */
+  void RemoveImpl(frame_id_t frame_id);
+
+  size_t k_;
+  size_t correlated_reference_period_;
+  /** Logical clock, advanced on every reference. */
+  uint64_t current_time_ = 0;
+  std::vector<FrameHistory> frames_;
+  /** The evictable frames, in eviction order but for the correlated reference period. */
+  std::set<EvictionKey> evictable_;
+  std::mutex latch_;
+};
+
+}  // namespace bustub
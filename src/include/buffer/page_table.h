@@ -0,0 +1,83 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_table.h
+//
+// Identification: src/include/buffer/page_table.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * PageTable maps the ids of the pages resident in a buffer pool instance to the frames that hold them.
+ *
+ * It is an open addressing hash table with linear probing. Its capacity is fixed at construction to at least twice the
+ * number of frames, so it never has to grow. Every slot is a single atomic word that holds both the page id and the
+ * frame id, so Find() takes no latch. Insert() and Erase() must be serialized by the caller.
+ *
+ * Erase() does not leave tombstones behind. It closes the gap by moving later entries of the probe sequence back
+ * instead, so lookups stay short no matter how many pages come and go. A Find() that races with an Erase() may miss
+ * an entry that is being moved, so a lookup without the writers' latch can only be trusted when it finds something.
+ */
+class PageTable {
+ public:
+  /**
+   * Creates an empty page table.
+   * @param num_frames the maximum number of entries the table will hold
+   */
+  explicit PageTable(size_t num_frames);
+
+  /**
+   * Looks up a page. Safe to call concurrently with everything.
+   * @param page_id id of the page to look for
+   * @return the frame holding the page, or -1 if it was not found
+   */
+  frame_id_t Find(page_id_t page_id) const;
+
+  /**
+   * Adds a page that is not in the table yet.
+   * @param page_id id of the page
+   * @param frame_id the frame holding the page
+   */
+  void Insert(page_id_t page_id, frame_id_t frame_id);
+
+  /**
+   * Removes a page.
+   * @param page_id id of the page
+   * @return true if the page was in the table
+   */
+  bool Erase(page_id_t page_id);
+
+ private:
+  /** Slot value of an empty slot. The invalid page id is never stored. */
+  static constexpr uint64_t EMPTY = ~uint64_t{0};
+
+  static uint64_t Pack(page_id_t page_id, frame_id_t frame_id) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(page_id)) << 32) | static_cast<uint32_t>(frame_id);
+  }
+  static page_id_t PageIdOf(uint64_t slot) { return static_cast<page_id_t>(slot >> 32); }
+  static frame_id_t FrameIdOf(uint64_t slot) { return static_cast<frame_id_t>(slot & 0xFFFFFFFF); }
+
+  /** @return the slot at which the probe sequence of the page starts */
+  size_t Home(page_id_t page_id) const;
+
+  /** Number of slots minus one. The number of slots is a power of two. */
+  size_t mask_;
+  /** log2 of the number of slots. */
+  int bits_;
+  std::vector<std::atomic<uint64_t>> slots_;
+};
+
+}  // namespace bustub
@@ -12,10 +12,32 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 #include "common/config.h"
 
 namespace bustub {
 
+/**
+ * How hard the buffer pool tries to keep a page, from the first to be evicted to the last. A frame is only victimized
+ * while no frame of a lower class can be. The class of a page is the one of its latest access.
+ */
+enum class RetentionClass : uint8_t {
+  /** Scratch pages that are written once and read back once, if at all. */
+  TEMP,
+  /** Table heap pages, and any page nobody said otherwise about. */
+  HEAP,
+  /** Index pages that a lookup reaches from another page, such as the blocks of a hash table. */
+  INDEX_BLOCK,
+  /** Index pages that every lookup goes through, such as the header page of a hash table. */
+  INDEX_HEADER,
+};
+
+/** Number of retention classes. */
+static constexpr size_t NUM_RETENTION_CLASSES = 4;
+
 /**
  * Replacer is an abstract class that tracks page usage.
  */
@@ -43,8 +65,42 @@ class Replacer {
    */
   virtual void Unpin(frame_id_t frame_id) = 0;
 
+  /**
+   * Makes a frame victimizable again after it was pinned for the buffer pool's own purposes, e.g. to write it back.
+   * Unlike Unpin(), this does not count as a use of the page.
+   * @param frame_id the id of the frame to release
+   */
+  virtual void Release(frame_id_t frame_id) { Unpin(frame_id); }
+
+  /**
+   * Lists the frames that are going to be victimized next, without changing the state of the replacer.
+   * @param max_frames the maximum number of frames to list
+   * @return up to max_frames victimizable frames, the most likely victim first. Empty if the policy cannot tell.
+   */
+  virtual std::vector<frame_id_t> EvictionCandidates(size_t max_frames) { return {}; }
+
   /** @return the number of elements in the replacer that can be victimized */
   virtual size_t Size() = 0;
+
+  /**
+   * Records that the page held by a frame was accessed. Policies that only care about the order of unpins can ignore
+   * this.
+   * @param frame_id the id of the frame that was accessed
+   */
+  virtual void RecordAccess(frame_id_t frame_id) {}
+
+  /**
+   * Sets the retention class of the page held by a frame. Policies that ignore it treat every frame alike.
+   * @param frame_id the id of the frame
+   * @param retention the retention class of its page
+   */
+  virtual void SetRetentionClass(frame_id_t frame_id, RetentionClass retention) {}
+
+  /**
+   * Removes a frame and everything known about it, because the frame no longer holds the page it was tracked for.
+   * @param frame_id the id of the frame to remove
+   */
+  virtual void Remove(frame_id_t frame_id) { Pin(frame_id); }
 };
 
 }  // namespace bustub
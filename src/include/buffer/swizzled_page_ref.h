@@ -0,0 +1,41 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// swizzled_page_ref.h
+//
+// Identification: src/include/buffer/swizzled_page_ref.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+
+#include "common/macros.h"
+#include "storage/page/page.h"
+
+namespace bustub {
+
+/**
+ * An in-memory reference from a parent to one of its child pages, such as from a hash table to one of its blocks, kept
+ * next to the page id the parent stores on disk. If the buffer pool swizzles pointers, the reference remembers the
+ * frame the child was last fetched into, and fetching the child through it goes straight to that frame instead of
+ * through the page table.
+ *
+ * Evicting the child does not clear the reference. Instead, fetching through the reference pins the frame and checks
+ * that it still holds the child, the same check a fetch does after looking the page up; if the child moved, the fetch
+ * goes through the page table and swizzles the reference again. Frames live as long as the buffer pool, so a stale
+ * reference is always safe to follow.
+ */
+struct SwizzledPageRef {
+  SwizzledPageRef() = default;
+  DISALLOW_COPY_AND_MOVE(SwizzledPageRef);
+
+  /** The frame the page was last fetched into, or nullptr if it is not swizzled. */
+  std::atomic<Page *> frame_{nullptr};
+};
+
+}  // namespace bustub
@@ -23,7 +23,17 @@ namespace bustub {
 
 class BustubInstance {
  public:
-  explicit BustubInstance(const std::string &db_file_name) {
+  /**
+   * Creates a database instance.
+   * @param db_file_name the database file
+   * @param buffer_pool_size the number of frames of the buffer pool
+   * @param max_buffer_pool_size the largest number of frames the buffer pool can be resized to while the instance
+   * runs, or 0 for buffer_pool_size
+   * @param extent_size the number of pages allocated on disk at a time for every table and index, or 0 to allocate
+   * them one by one
+   */
+  explicit BustubInstance(const std::string &db_file_name, size_t buffer_pool_size = BUFFER_POOL_SIZE,
+                          size_t max_buffer_pool_size = 0, size_t extent_size = 0) {
     enable_logging = false;
 
     // storage related
@@ -32,7 +42,10 @@ class BustubInstance {
     // log related
     log_manager_ = new LogManager(disk_manager_);
 
-    buffer_pool_manager_ = new BufferPoolManager(BUFFER_POOL_SIZE, disk_manager_, log_manager_);
+    BufferPoolOptions buffer_pool_options;
+    buffer_pool_options.max_pool_size_ = max_buffer_pool_size;
+    buffer_pool_options.extent_size_ = extent_size;
+    buffer_pool_manager_ = new BufferPoolManager(1, buffer_pool_size, disk_manager_, log_manager_, buffer_pool_options);
 
     // txn related
     lock_manager_ = new LockManager(TwoPLMode::STRICT, DeadlockMode::PREVENTION);  // S2PL
@@ -48,6 +61,8 @@ class BustubInstance {
     }
     delete checkpoint_manager_;
     delete log_manager_;
+    // The disk manager outlives the buffer pool, so the unused pages of the extents can still go back to it.
+    buffer_pool_manager_->ReleaseExtents();
     delete buffer_pool_manager_;
     delete lock_manager_;
     delete transaction_manager_;
@@ -32,9 +32,14 @@ static constexpr int INVALID_TXN_ID = -1;                                     //
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
 static constexpr int HEADER_PAGE_ID = 0;                                      // the header page id
 static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
-static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
+static constexpr int BUFFER_POOL_SIZE = 10;                                   // default size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int BULK_READ_RING_SIZE = 32;                                // frames recycled by a sequential scan
+static constexpr int BULK_WRITE_RING_SIZE = 64;                               // frames recycled by a bulk insert
+static constexpr int READ_AHEAD_PAGES = 16;                                   // pages a sequential scan reads ahead
+static constexpr int PREFETCH_QUEUE_SIZE = 64;                                // max. queued read-ahead requests
+static constexpr int WARM_START_BATCH_SIZE = 1024;                            // pages read per warm start batch
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
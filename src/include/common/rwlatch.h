@@ -12,25 +12,88 @@
 
 #pragma once
 
-#include <climits>
+#include <atomic>
 #include <condition_variable>  // NOLINT
-#include <mutex>               // NOLINT
+#include <cstddef>
+#include <cstdint>
+#include <mutex>  // NOLINT
 
 #include "common/macros.h"
 
 namespace bustub {
 
 /**
- * Reader-Writer latch backed by std::mutex.
+ * Where latches wait once spinning did not get them in. Waking up is cheap while nobody waits: it only reads a counter.
+ */
+class LatchParking {
+ public:
+  /** Number of times a latch checks again before it parks. */
+  static constexpr int SPIN_LIMIT = 64;
+
+  LatchParking() = default;
+
+  DISALLOW_COPY_AND_MOVE(LatchParking);
+
+  /**
+   * Spins for a while until the condition holds, then parks until it holds.
+   * @param condition checks, or tries to get, what the caller waits for; it is called under the parking latch
+   */
+  template <typename Condition>
+  void Await(Condition condition) {
+    for (int i = 0; i < SPIN_LIMIT; i++) {
+      if (condition()) {
+        return;
+      }
+      Pause();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiters_.fetch_add(1);
+    cond_.wait(lock, condition);
+    waiters_.fetch_sub(1);
+  }
+
+  /**
+   * Wakes up everybody who is parked, so that they check their conditions again. Must be called after every change
+   * that may make a condition hold.
+   */
+  void WakeAll() {
+    // The change and the counter are sequentially consistent, so either the waiter sees the change when it checks
+    // under mutex_, or we see the waiter and wait for it to park before notifying it.
+    if (waiters_.load() > 0) {
+      { std::lock_guard<std::mutex> guard(mutex_); }
+      cond_.notify_all();
+    }
+  }
+
+  /** Tells the CPU that we are spinning. */
+  static void Pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::atomic<uint32_t> waiters_{0};
+};
+
+/**
+ * Reader-Writer latch backed by a single atomic word.
+ *
+ * The word holds the number of readers and whether a writer entered. Taking and releasing the latch is one atomic
+ * operation while there is no contention; otherwise a thread spins for a bit, then parks. A writer that entered keeps
+ * new readers out while it waits for the readers that are in to leave, so writers are not starved by readers.
  */
 class ReaderWriterLatch {
-  using mutex_t = std::mutex;
-  using cond_t = std::condition_variable;
-  static const uint32_t MAX_READERS = UINT_MAX;
+  static constexpr uint32_t WRITER_ENTERED = 1U << 31;
+  static constexpr uint32_t MAX_READERS = WRITER_ENTERED - 1;
 
  public:
   ReaderWriterLatch() = default;
-  ~ReaderWriterLatch() { std::lock_guard<mutex_t> guard(mutex_); }
+  ~ReaderWriterLatch() = default;
 
   DISALLOW_COPY(ReaderWriterLatch);
 
@@ -38,13 +101,76 @@ class ReaderWriterLatch {
    * Acquire a write latch.
    */
   void WLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_) {
-      reader_.wait(latch);
+    uint32_t state = 0;
+    if (!state_.compare_exchange_strong(state, WRITER_ENTERED)) {
+      wlockSlow();
     }
-    writer_entered_ = true;
-    while (reader_count_ > 0) {
-      writer_.wait(latch);
+  }
+
+  /**
+   * Release a write latch.
+   */
+  void WUnlock() {
+    // Readers never get in while a writer is, so the word holds nothing else.
+    state_.store(0);
+    parking_.WakeAll();
+  }
+
+  /**
+   * Acquire a read latch.
+   */
+  void RLock() {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    if (state >= MAX_READERS || !state_.compare_exchange_weak(state, state + 1)) {
+      rlockSlow();
+    }
+  }
+
+  /**
+   * Release a read latch.
+   */
+  void RUnlock() {
+    uint32_t state = state_.fetch_sub(1);
+    // Wake up the writer when the last reader leaves, or a reader when there is room again.
+    if ((state & WRITER_ENTERED) != 0 ? state == (WRITER_ENTERED | 1) : state == MAX_READERS) {
+      parking_.WakeAll();
+    }
+  }
+
+ private:
+  void wlockSlow();
+  void rlockSlow();
+
+  std::atomic<uint32_t> state_{0};
+  LatchParking parking_;
+};
+
+/**
+ * Reader-Writer latch for latches that a lot of threads take for reading at the same time, with the same behaviour as
+ * ReaderWriterLatch.
+ *
+ * The readers count themselves in one of NUM_SLOTS counters, each on its own cache line, chosen per thread, so that
+ * readers on different cores do not fight over one cache line. In exchange, the latch is larger, and a writer has to
+ * look at every counter.
+ */
+class DistributedReaderWriterLatch {
+ public:
+  /** Number of reader counters. */
+  static constexpr size_t NUM_SLOTS = 16;
+
+  DistributedReaderWriterLatch() = default;
+  ~DistributedReaderWriterLatch() = default;
+
+  DISALLOW_COPY(DistributedReaderWriterLatch);
+
+  /**
+   * Acquire a write latch.
+   */
+  void WLock() {
+    bool expected = false;
+    bool entered = writer_entered_.compare_exchange_strong(expected, true);
+    if (!entered || !drained()) {
+      wlockSlow(entered);
     }
   }
 
@@ -52,45 +178,49 @@ class ReaderWriterLatch {
    * Release a write latch.
    */
   void WUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    writer_entered_ = false;
-    reader_.notify_all();
+    writer_entered_.store(false);
+    parking_.WakeAll();
   }
 
   /**
    * Acquire a read latch.
    */
   void RLock() {
-    std::unique_lock<mutex_t> latch(mutex_);
-    while (writer_entered_ || reader_count_ == MAX_READERS) {
-      reader_.wait(latch);
+    auto &readers = slots_[SlotIndex()].readers_;
+    readers.fetch_add(1);
+    // The counter and the flag are sequentially consistent, so either we see the writer, or it sees us.
+    if (writer_entered_.load()) {
+      rlockSlow(&readers);
     }
-    reader_count_++;
   }
 
   /**
    * Release a read latch.
    */
   void RUnlock() {
-    std::lock_guard<mutex_t> guard(mutex_);
-    reader_count_--;
-    if (writer_entered_) {
-      if (reader_count_ == 0) {
-        writer_.notify_one();
-      }
-    } else {
-      if (reader_count_ == MAX_READERS - 1) {
-        reader_.notify_one();
-      }
+    slots_[SlotIndex()].readers_.fetch_sub(1);
+    if (writer_entered_.load()) {
+      parking_.WakeAll();
     }
   }
 
+  /** @return the reader counter of the calling thread, which stays the same for the life of the thread */
+  static size_t SlotIndex();
+
  private:
-  mutex_t mutex_;
-  cond_t writer_;
-  cond_t reader_;
-  uint32_t reader_count_{0};
-  bool writer_entered_{false};
+  /** A reader counter, alone on its cache line. */
+  struct alignas(64) Slot {
+    std::atomic<uint32_t> readers_{0};
+  };
+
+  /** @return true if no reader is in */
+  bool drained() const;
+  void wlockSlow(bool entered);
+  void rlockSlow(std::atomic<uint32_t> *readers);
+
+  Slot slots_[NUM_SLOTS];
+  std::atomic<bool> writer_entered_{false};
+  LatchParking parking_;
 };
 
 }  // namespace bustub
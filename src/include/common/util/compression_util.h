@@ -0,0 +1,59 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compression_util.h
+//
+// Identification: src/include/common/util/compression_util.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+namespace bustub {
+
+/**
+ * CompressionUtil provides a fast LZ77 codec for buffers of up to 64 KB, such as pages.
+ *
+ * The format follows LZ4: a sequence of tokens, each made of a run of literals and a back reference to an earlier
+ * occurrence of the bytes that follow. The upper four bits of the token byte hold the number of literals, the lower
+ * four bits the length of the match minus MIN_MATCH. A nibble of 15 is continued by bytes that are added to it, up to
+ * and including the first byte below 255. The literals follow the token, then the distance back to the match in two
+ * bytes, little endian, then the continuation of the match length. The last token has literals only.
+ *
+ * Matches are found with a single hash table probe per position, and stretches of incompressible data are skipped
+ * over faster and faster, which trades some ratio for speed.
+ */
+class CompressionUtil {
+ public:
+  /** Shortest match worth a back reference. */
+  static constexpr size_t MIN_MATCH = 4;
+  /** Largest buffer that can be compressed, since distances have 16 bits. */
+  static constexpr size_t MAX_INPUT_SIZE = 65535;
+
+  /**
+   * Compresses a buffer.
+   * @param src the data to compress, at most MAX_INPUT_SIZE bytes
+   * @param src_size the size of the data
+   * @param[out] dst receives the compressed data
+   * @param dst_capacity the size of dst
+   * @return the size of the compressed data, or 0 if it does not fit into dst_capacity bytes
+   */
+  static size_t Compress(const char *src, size_t src_size, char *dst, size_t dst_capacity);
+
+  /**
+   * Decompresses a buffer compressed by Compress().
+   * @param src the compressed data
+   * @param src_size the size of the compressed data
+   * @param[out] dst receives the decompressed data
+   * @param dst_size the size the data had before it was compressed
+   * @return true if the data was decompressed to exactly dst_size bytes, false if it is corrupt
+   */
+  static bool Decompress(const char *src, size_t src_size, char *dst, size_t dst_size);
+};
+
+}  // namespace bustub
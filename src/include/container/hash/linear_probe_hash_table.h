@@ -14,9 +14,11 @@
 
 #include <queue>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/swizzled_page_ref.h"
 #include "concurrency/transaction.h"
 #include "container/hash/hash_function.h"
 #include "container/hash/hash_table.h"
@@ -75,7 +77,8 @@ class LinearProbeHashTable : public HashTable<KeyType, ValueType, KeyComparator>
   bool GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result) override;
 
   /**
-   * Resizes the table to at least twice the initial size provided.
+   * Resizes the table to at least twice the initial size provided, but to no more buckets than the header page can
+   * hold blocks for. The old blocks are read in batches with BufferPoolManager::FetchPages().
    * @param initial_size the initial size of the hash table
    */
   void Resize(size_t initial_size);
@@ -100,17 +103,48 @@ class LinearProbeHashTable : public HashTable<KeyType, ValueType, KeyComparator>
 
  private:
   void appendBuckets(HashTableHeaderPage* header_page, size_t num_buckets);
+  /** Fetches the page of a block through its swizzled reference. */
+  Page *fetchBlock(HashTableHeaderPage *header_page, size_t block_index);
+  /**
+   * GetValue() without the table latch, for callers that hold it already. Taking it again could wait behind a writer
+   * that waits for the caller.
+   */
+  void getValue(const KeyType &key, std::vector<ValueType> *result);
+  /**
+   * Looks for a key in a run of slots of a block. The block is read optimistically, and only latched if it is being
+   * written or was written during the read.
+   * @param page the pinned page of the block
+   * @param first_slot the first slot of the run, in the block
+   * @param num_slots the number of slots in the run
+   * @param key the key to look for
+   * @param[out] result receives the values of the key in the run
+   * @param copies room for the pairs an optimistic read copies out of the block
+   * @return true if the run ends at a slot that was never occupied, where the probe stops
+   */
+  bool probeBlock(Page *page, size_t first_slot, size_t num_slots, const KeyType &key, std::vector<ValueType> *result,
+                  std::vector<std::pair<KeyType, ValueType>> *copies);
+  /** Creates the blocks of a resized table, with the pairs in the slots linear probing would give them. */
+  void rebuildBlocks(HashTableHeaderPage *header_page, const std::vector<std::pair<KeyType, ValueType>> &pairs);
   // member variable
   std::string name_;
   page_id_t header_page_id_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
 
-  // Readers includes inserts and removes, writer is only resize
-  ReaderWriterLatch table_latch_;
+  // Readers includes inserts and removes, writer is only resize. Every operation reads it, so spread the readers out.
+  DistributedReaderWriterLatch table_latch_;
+
+  // References to the header page and to every block, by block index, through which the pages are fetched
+  SwizzledPageRef header_ref_;
+  std::vector<SwizzledPageRef> block_refs_;
 
   // Hash function
   HashFunction<KeyType> hash_fn_;
+
+  // How the hash table accesses its pages, charged to the index as their owner. The header page, which every operation
+  // goes through, is kept longer than the blocks.
+  AccessContext access_;
+  AccessContext header_access_;
 };
 
 }  // namespace bustub
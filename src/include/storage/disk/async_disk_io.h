@@ -0,0 +1,199 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// async_disk_io.h
+//
+// Identification: src/include/storage/disk/async_disk_io.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+/** The ways a DiskManager can do asynchronous I/O. */
+enum class DiskIOBackend {
+  /** io_uring if the kernel has it, or else the thread pool. */
+  AUTO,
+  /** Linux io_uring. */
+  IO_URING,
+  /** A pool of threads that do blocking I/O. */
+  THREAD_POOL,
+};
+
+/**
+ * A vectored read or write of a file, for AsyncDiskIO.
+ */
+struct DiskRequest {
+  /** True to write, false to read. */
+  bool is_write_;
+  /** The buffers, which have to stay valid until the callback runs. */
+  const iovec *iov_;
+  int iovcnt_;
+  /** Where in the file the first buffer goes. */
+  off_t offset_;
+  /**
+   * Called once the request is done, on a thread of the AsyncDiskIO, with the number of bytes transferred, which may
+   * be fewer than requested, or -errno on an error. It must not block on other requests.
+   */
+  std::function<void(ssize_t)> callback_;
+};
+
+/**
+ * AsyncDiskIO keeps many reads and writes of one file in flight at once. Requests are submitted in batches and
+ * complete in any order.
+ */
+class AsyncDiskIO {
+ public:
+  AsyncDiskIO() = default;
+
+  /** Waits for the requests in flight to complete. */
+  virtual ~AsyncDiskIO() = default;
+
+  DISALLOW_COPY_AND_MOVE(AsyncDiskIO);
+
+  /**
+   * Starts a batch of requests. May wait for room if too many requests are in flight already. Callbacks may run
+   * before this returns.
+   * @param requests the requests
+   */
+  virtual void Submit(const std::vector<DiskRequest> &requests) = 0;
+
+  /**
+   * Creates the asynchronous I/O of a file.
+   * @param fd descriptor of the file, which has to stay open for as long as the AsyncDiskIO lives
+   * @param backend how to do the I/O
+   * @param queue_depth the number of requests that may be in flight at once
+   * @return the AsyncDiskIO, or nullptr if the backend is not available, e.g. io_uring on an old kernel
+   */
+  static AsyncDiskIO *Create(int fd, DiskIOBackend backend, size_t queue_depth);
+};
+
+/**
+ * AsyncDiskIO with a pool of threads that each do one blocking preadv or pwritev at a time.
+ */
+class ThreadPoolDiskIO : public AsyncDiskIO {
+ public:
+  /**
+   * Starts the threads.
+   * @param fd descriptor of the file
+   * @param num_threads the number of threads, which is also the number of requests in flight
+   */
+  ThreadPoolDiskIO(int fd, size_t num_threads);
+
+  ~ThreadPoolDiskIO() override;
+
+  void Submit(const std::vector<DiskRequest> &requests) override;
+
+ private:
+  /** Takes requests off the queue and does them, until the pool shuts down. */
+  void work();
+
+  int fd_;
+  std::vector<std::thread> threads_;
+  /** Requests that were submitted and not taken by a thread yet. */
+  std::deque<DiskRequest> queue_;
+  bool shutdown_{false};
+  /** Protects queue_ and shutdown_. */
+  std::mutex latch_;
+  std::condition_variable cv_;
+};
+
+/**
+ * AsyncDiskIO on Linux io_uring, through the raw system calls. Submitters fill the submission ring under a latch and
+ * hand a whole batch to the kernel with one system call; a completion thread reaps the completion ring and runs the
+ * callbacks. At most as many requests as the submission ring holds are in flight, so the completion ring, which is
+ * twice as large, never overflows. If the kernel refuses a batch, the requests it did not take fail with its error; if
+ * it is only short of resources, the submitter waits for completions first. If the completions cannot be waited for,
+ * every request fails from then on.
+ */
+class IoUringDiskIO : public AsyncDiskIO {
+ public:
+  /**
+   * Sets up the rings, or fails if the kernel does not support io_uring. See Ok().
+   * @param fd descriptor of the file
+   * @param queue_depth the number of requests in flight at once
+   */
+  IoUringDiskIO(int fd, size_t queue_depth);
+
+  ~IoUringDiskIO() override;
+
+  /** @return true if the rings were set up */
+  bool Ok() const { return ring_fd_ >= 0; }
+
+  void Submit(const std::vector<DiskRequest> &requests) override;
+
+ private:
+  /** Reaps completions and runs their callbacks, until the shutdown request completes. */
+  void reap();
+  /**
+   * Hands the given number of entries of the submission ring to the kernel. While the kernel is short of resources,
+   * waits for completions with the latch dropped, keeping other submitters off the ring.
+   * @param to_submit the number of entries at the tail of the submission ring
+   * @param lock the lock on latch_
+   * @return 0, or -errno if the ring is broken. The entries the kernel did not take are still in the ring then.
+   */
+  int submitEntries(unsigned to_submit, std::unique_lock<std::mutex> *lock);
+  /**
+   * Fails every request that holds a slot, and every later one.
+   * @param error the -errno to fail them with
+   */
+  void failAll(int error);
+  /**
+   * Takes the entries the kernel has not taken out of the submission ring again, and frees their slots. Needs latch_.
+   * @return the callbacks of the entries
+   */
+  std::vector<std::function<void(ssize_t)>> unsubmit();
+  /** Unmaps the rings and closes the ring. */
+  void teardown();
+
+  int fd_;
+  int ring_fd_{-1};
+  /** The mappings of the rings. */
+  void *sq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  void *cq_ring_{nullptr};
+  size_t cq_ring_size_{0};
+  void *sqes_{nullptr};
+  size_t sqes_size_{0};
+  /** The fields of the rings, inside the mappings. */
+  uint32_t *sq_head_{nullptr};
+  uint32_t *sq_tail_{nullptr};
+  uint32_t sq_mask_{0};
+  uint32_t sq_entries_{0};
+  uint32_t *sq_array_{nullptr};
+  uint32_t *cq_head_{nullptr};
+  uint32_t *cq_tail_{nullptr};
+  uint32_t cq_mask_{0};
+  size_t cqes_offset_{0};
+  /** The callback of every slot, by the user data of its request, and the slots that are free. */
+  std::vector<std::function<void(ssize_t)>> callbacks_;
+  std::vector<uint32_t> free_slots_;
+  std::thread reaper_;
+  /** Set while a submitter waits for completions before it can hand over its entries. */
+  bool stalled_{false};
+  /** The -errno every request fails with once completions cannot be waited for, or 0. */
+  int error_{0};
+  /** Protects the submission ring, callbacks_, free_slots_, stalled_ and error_. */
+  std::mutex latch_;
+  /** Signalled when a slot becomes free, or stalled_ or error_ changes. */
+  std::condition_variable slot_freed_;
+};
+
+}  // namespace bustub
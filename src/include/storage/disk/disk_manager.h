@@ -12,28 +12,67 @@
 
 #pragma once
 
+#include <sys/types.h>
+#include <sys/uio.h>
+
 #include <atomic>
 #include <fstream>
+#include <functional>
 #include <future>  // NOLINT
+#include <mutex>  // NOLINT
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
+#include "storage/disk/async_disk_io.h"
 
 namespace bustub {
 
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * Pages are read and written with positional system calls on a file descriptor, which has no cursor to share, so any
+ * number of threads can do page I/O at once. The size of the database file is kept in memory, since only the disk
+ * manager makes the file grow.
+ *
+ * Pages can also be read and written asynchronously, with a callback or a future for the completion, so that callers
+ * keep many I/Os in flight. The asynchronous I/O is set up on first use, on io_uring where the kernel has it. The
+ * batched ReadPages() and WritePages() use it to have all their runs of pages in flight at once.
+ *
+ * In direct I/O mode the db file bypasses the kernel page cache, so that pages are only cached by the buffer pool.
+ * Direct I/O needs buffers aligned to DIRECT_IO_ALIGNMENT: buffer pool frames are, and other buffers go through an
+ * aligned copy.
+ *
+ * Which pages are allocated is kept in a free space map next to the db file, <name>.fsm, with one bit per page, so
+ * that deallocated pages are handed out again, also after a restart. Its first page is a header; every page after that
+ * is a bitmap page for the next PAGE_SIZE * 8 pages of the db file. Allocating and deallocating only change the map in
+ * memory; the bitmap pages that changed are written and synced by FlushFreeSpaceMap(), which WritePages() with sync
+ * calls before it syncs the db file, and by ShutDown().
+ *
+ * After a crash, the map is as of its last flush. Pages deallocated after that are allocated again, which only costs
+ * their space. Pages allocated after that are free again, except those that the db file grew by, which are taken to be
+ * in use: so a page may only be handed out twice if it filled a gap in the file and was written without a sync.
  */
 class DiskManager {
  public:
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
+   * @param backend how to do asynchronous I/O
+   * @param direct_io true to bypass the kernel page cache for the database file, if its file system allows that
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, DiskIOBackend backend = DiskIOBackend::AUTO,
+                       bool direct_io = false);
+
+  /** Shuts the disk manager down, unless ShutDown() was called already. */
+  ~DiskManager();
 
-  ~DiskManager() = default;
+  /** Number of asynchronous requests in flight at once. */
+  static constexpr size_t ASYNC_QUEUE_DEPTH = 32;
+  /** Alignment of buffers, and of offsets and sizes in the file, for direct I/O. */
+  static constexpr size_t DIRECT_IO_ALIGNMENT = PAGE_SIZE;
 
   /**
    * Shut down the disk manager and close all the file resources.
@@ -47,6 +86,14 @@ class DiskManager {
    */
   void WritePage(page_id_t page_id, const char *page_data);
 
+  /**
+   * Write several pages to the database file. The pages are written in page id order, and every run of adjacent
+   * pages goes to disk in a single vectored write.
+   * @param pages id and raw data of every page to write
+   * @param sync true to return only once the pages are on stable storage
+   */
+  void WritePages(std::vector<std::pair<page_id_t, const char *>> pages, bool sync);
+
   /**
    * Read a page from the database file.
    * @param page_id id of the page
@@ -54,6 +101,56 @@ class DiskManager {
    */
   void ReadPage(page_id_t page_id, char *page_data);
 
+  /**
+   * Read several pages from the database file. Like WritePages(), every run of adjacent pages is read with a single
+   * vectored read. Whatever lies beyond the end of the file reads as zeros.
+   * @param pages id and output buffer of every page to read
+   */
+  void ReadPages(std::vector<std::pair<page_id_t, char *>> pages);
+
+  /**
+   * Start reading a page from the database file. A page beyond the end of the file reads as zeros.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer, which has to stay valid until the callback runs
+   * @param callback called on an I/O thread once the page is read, with false on an I/O error
+   */
+  void ReadPageAsync(page_id_t page_id, char *page_data, std::function<void(bool)> callback);
+
+  /**
+   * Start reading a page from the database file.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer, which has to stay valid until the future is ready
+   * @return a future that holds false on an I/O error
+   */
+  std::future<bool> ReadPageAsync(page_id_t page_id, char *page_data);
+
+  /**
+   * Start writing a page to the database file.
+   * @param page_id id of the page
+   * @param page_data raw page data, which has to stay valid until the callback runs
+   * @param callback called on an I/O thread once the page is written, with false on an I/O error
+   */
+  void WritePageAsync(page_id_t page_id, const char *page_data, std::function<void(bool)> callback);
+
+  /**
+   * Start writing a page to the database file.
+   * @param page_id id of the page
+   * @param page_data raw page data, which has to stay valid until the future is ready
+   * @return a future that holds false on an I/O error
+   */
+  std::future<bool> WritePageAsync(page_id_t page_id, const char *page_data);
+
+  /**
+   * Write the bitmap pages of the free space map that changed since the last flush, and sync them.
+   */
+  void FlushFreeSpaceMap();
+
+  /** @return true if the database file bypasses the kernel page cache */
+  bool IsDirectIO() const { return direct_io_; }
+
+  /** @return the number of pages the database file holds */
+  size_t GetNumPages();
+
   /**
    * Flush the entire log buffer into disk.
    * @param log_data raw log data
@@ -71,17 +168,48 @@ class DiskManager {
   bool ReadLog(char *log_data, int size, int offset);
 
   /**
-   * Allocate a page on disk.
+   * Allocate a page on disk. The lowest free page is taken, to keep the file dense.
    * @return the id of the allocated page
    */
   page_id_t AllocatePage();
 
   /**
-   * Deallocate a page on disk.
+   * Allocate a run of adjacent pages on disk. The first run of free pages that is long enough is taken, or else the
+   * pages after the last allocated one.
+   * @param num_pages number of pages to allocate
+   * @return the id of the first allocated page
+   */
+  page_id_t AllocatePages(size_t num_pages);
+
+  /**
+   * Allocate an extent, i.e. a run of adjacent pages for one table or index, like AllocatePages(). The disk space of
+   * the extent is reserved right away, so that the file system can lay it out in one piece.
+   * @param num_pages number of pages in the extent
+   * @return the id of the first page of the extent
+   */
+  page_id_t AllocateExtent(size_t num_pages);
+
+  /**
+   * Deallocate a page on disk, so that it can be allocated again. Deallocating a page that is not allocated does
+   * nothing.
    * @param page_id id of the page to deallocate
    */
   void DeallocatePage(page_id_t page_id);
 
+  /**
+   * @param page_id id of the page
+   * @return true if the page is allocated
+   */
+  bool IsAllocated(page_id_t page_id);
+
+  /**
+   * Give the disk space of deallocated pages back to the file system: the file is truncated after the last allocated
+   * page, and runs of deallocated pages before it become holes, which read as zeros. The caller must make sure that
+   * no deallocated page is being read or written meanwhile.
+   * @return the number of pages whose space was given back
+   */
+  size_t Compact();
+
   /** @return the number of disk flushes */
   int GetNumFlushes() const;
 
@@ -101,16 +229,104 @@ class DiskManager {
   inline bool HasFlushLogFuture() { return flush_log_f_ != nullptr; }
 
  private:
+  /** A run of adjacent pages, in a single vectored read or write. */
+  struct PageRun {
+    std::vector<iovec> iov_;
+    off_t offset_;
+    /** For direct I/O: aligned copies that stand in for buffers that are not aligned, with the buffers they copy. */
+    std::vector<std::pair<char *, char *>> bounces_;
+  };
+
   int GetFileSize(const std::string &file_name);
+  /** @return the asynchronous I/O of the db file, which is set up on the first call */
+  AsyncDiskIO *asyncIO();
+  /**
+   * Reads or writes the runs asynchronously, all in one batch.
+   * @param is_write true to write, false to read
+   * @param runs the runs, which do not overlap
+   * @param callback called once every run is done, with false if any of them failed
+   */
+  void submitRuns(bool is_write, std::vector<PageRun> runs, std::function<void(bool)> callback);
+  /**
+   * Finishes a run after its asynchronous read or write completed, doing whatever it left over synchronously.
+   * @return false on an I/O error
+   */
+  bool finishRun(bool is_write, PageRun *run, ssize_t result);
+  /**
+   * For direct I/O, replaces the buffers of a run that are not aligned with aligned copies. Does nothing otherwise.
+   * @param is_write true if the run is to be written, so that the copies have to be filled
+   * @param run the run, whose iov_ is still untouched
+   */
+  void bounceIn(bool is_write, PageRun *run);
+  /**
+   * Frees the aligned copies of a run once its I/O is done, copying what was read into the original buffers.
+   * @param is_write true if the run was written
+   * @param run the run
+   */
+  static void bounceOut(bool is_write, PageRun *run);
+  /**
+   * Writes a run of adjacent pages, retrying after interrupts and short writes.
+   * @param iov the pages. They are consumed as they are written.
+   * @param offset where the first page goes in the db file
+   * @return false on an I/O error
+   */
+  bool writeRun(std::vector<iovec> *iov, off_t offset);
+  /**
+   * Reads a run of adjacent pages, retrying after interrupts and short reads. Whatever lies beyond the end of the file
+   * reads as zeros.
+   * @param iov the pages. They are consumed as they are read.
+   * @param offset where the first page is in the db file
+   */
+  void readRun(std::vector<iovec> *iov, off_t offset);
+  /**
+   * Skips the bytes that were transferred.
+   * @param iov the buffers
+   * @param[in,out] next the first buffer that is not done
+   * @param count the number of bytes transferred, starting at the buffer next
+   */
+  static void advance(std::vector<iovec> *iov, size_t *next, size_t count);
+  /** Loads the free space map, or starts a new one if there is none that goes with the db file. */
+  void openFreeSpaceMap();
+  /**
+   * Marks a run of pages allocated or free in the free space map, whose bitmap pages become dirty. Needs alloc_latch_.
+   * @param first id of the first page
+   * @param num_pages number of pages
+   * @param allocated true to allocate, false to free
+   */
+  void setAllocated(page_id_t first, size_t num_pages, bool allocated);
+  /** @return true if the page is allocated. Needs alloc_latch_. */
+  bool isAllocated(page_id_t page_id) const {
+    auto word = static_cast<size_t>(page_id) / 64;
+    return word < allocated_.size() && (allocated_[word] >> (page_id % 64) & 1) != 0;
+  }
   // stream to write log file
   std::fstream log_io_;
   std::string log_name_;
-  // stream to write db file
-  std::fstream db_io_;
+  // descriptor of the db file
+  int db_fd_{-1};
+  // size of the db file in bytes, which only grows through our writes
+  std::atomic<size_t> db_file_size_{0};
+  DiskIOBackend backend_;
+  bool direct_io_;
+  // asynchronous I/O of the db file, set up under async_io_latch_ by the first asynchronous request
+  std::atomic<AsyncDiskIO *> async_io_{nullptr};
+  std::mutex async_io_latch_;
   std::string file_name_;
-  std::atomic<page_id_t> next_page_id_;
+  // free space map: its file, one bit per page that is set while the page is allocated, which of its bitmap pages
+  // changed since they were last written, and the latch over the map in memory
+  std::string fsm_name_;
+  int fsm_fd_{-1};
+  std::vector<uint64_t> allocated_;
+  std::vector<bool> fsm_dirty_;
+  std::mutex alloc_latch_;
+  // serializes FlushFreeSpaceMap(), so that an older copy of a bitmap page is never written after a newer one
+  std::mutex fsm_flush_latch_;
+  // no word of allocated_ before this one has a free page
+  size_t first_free_word_{0};
+  // one past the last allocated page
+  page_id_t next_page_id_;
   int num_flushes_;
-  int num_writes_;
+  std::atomic<int> num_writes_;
   bool flush_log_;
   std::future<void> *flush_log_f_;
 };
@@ -55,6 +55,16 @@ class HashTableBlockPage {
    */
   ValueType ValueAt(slot_offset_t bucket_ind) const;
 
+  /**
+   * Copies the key and value at an index without checking that the index is readable, for optimistic readers of the
+   * page, which check that the page did not change before they use the copy.
+   *
+   * @param bucket_ind the index in the block to copy the pair at
+   * @param[out] key receives the key
+   * @param[out] value receives the value
+   */
+  void CopyPairAt(slot_offset_t bucket_ind, KeyType *key, ValueType *value) const;
+
   /**
    * Attempts to insert a key and value into an index in the block.
    * The insert is thread safe. It uses compare and swap to claim the index,
@@ -89,6 +89,11 @@ class HashTableHeaderPage {
    */
   size_t NumBlocks();
 
+  /**
+   * @return the number of block page_ids the header page has room for
+   */
+  size_t MaxBlocks() const;
+
   /**
    * Reset the block index (for resizing)
    */
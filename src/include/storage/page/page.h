@@ -12,8 +12,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <memory>
 
 #include "common/config.h"
 #include "common/rwlatch.h"
@@ -24,14 +28,22 @@ namespace bustub {
  * Page is the basic unit of storage within the database system. Page provides a wrapper for actual data pages being
  * held in main memory. Page also contains book-keeping information that is used by the buffer pool manager, e.g.
  * pin count, dirty flag, page id, etc.
+ *
+ * Besides the reader-writer latch, a page can be read optimistically, without writing to shared memory at all: the
+ * page has a version that is odd while a writer holds the write latch, and goes up every time the write latch is taken
+ * or released. A reader notes the version, reads, and then checks that the version did not change, in which case
+ * nothing was written meanwhile; otherwise it has to read again under the read latch. What such a reader sees before
+ * the check may be half-written, so it must copy what it needs, and must not follow offsets or sizes it read from the
+ * page without checking them against the page bounds first.
  */
 class Page {
   // There is book-keeping information inside the page that should only be relevant to the buffer pool manager.
   friend class BufferPoolManager;
+  friend class BufferPoolManagerInstance;
 
  public:
-  /** Constructor. Zeros out the page data. */
-  Page() { ResetMemory(); }
+  /** Constructor. Allocates and zeros out the page data. */
+  Page() : own_data_(new char[PAGE_SIZE]), data_(own_data_.get()) { ResetMemory(); }
 
   /** Default destructor. */
   ~Page() = default;
@@ -43,16 +55,24 @@ class Page {
   inline page_id_t GetPageId() { return page_id_; }
 
   /** @return the pin count of this page */
-  inline int GetPinCount() { return pin_count_; }
+  inline int GetPinCount() { return std::max(pin_count_.load(), 0); }
 
   /** @return true if the page in memory has been modified from the page on disk, false otherwise */
   inline bool IsDirty() { return is_dirty_; }
 
   /** Acquire the page write latch. */
-  inline void WLatch() { rwlatch_.WLock(); }
+  inline void WLatch() {
+    rwlatch_.WLock();
+    version_.fetch_add(1, std::memory_order_relaxed);
+    // The version has to be odd before the first write can be seen.
+    std::atomic_thread_fence(std::memory_order_release);
+  }
 
   /** Release the page write latch. */
-  inline void WUnlatch() { rwlatch_.WUnlock(); }
+  inline void WUnlatch() {
+    version_.fetch_add(1, std::memory_order_release);
+    rwlatch_.WUnlock();
+  }
 
   /** Acquire the page read latch. */
   inline void RLatch() { rwlatch_.RLock(); }
@@ -60,6 +80,27 @@ class Page {
   /** Release the page read latch. */
   inline void RUnlatch() { rwlatch_.RUnlock(); }
 
+  /**
+   * Starts an optimistic read of the page. The page must be pinned.
+   * @param[out] version receives the version to hand to ValidateOptimisticRead()
+   * @return false if a writer holds the write latch, in which case the caller should take the read latch instead
+   */
+  inline bool StartOptimisticRead(uint64_t *version) {
+    *version = version_.load(std::memory_order_acquire);
+    return (*version & 1) == 0;
+  }
+
+  /**
+   * Finishes an optimistic read of the page.
+   * @param version the version StartOptimisticRead() returned
+   * @return true if the page was not written since the read started, so that what was read is consistent
+   */
+  inline bool ValidateOptimisticRead(uint64_t version) {
+    // The reads of the page must be done before the version is read again.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version_.load(std::memory_order_relaxed) == version;
+  }
+
   /** @return the page LSN. */
   inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
 
@@ -75,19 +116,35 @@ class Page {
   static constexpr size_t OFFSET_LSN = 4;
 
  private:
+  /**
+   * Creates a buffer pool frame. Its data lives in memory the buffer pool owns, so that the buffer pool can give the
+   * memory of frames it no longer uses back to the operating system.
+   * @param data PAGE_SIZE bytes of zeroed memory
+   */
+  explicit Page(char *data) : data_(data) {}
+
   /** Zeroes out the data that is held within the page. */
   inline void ResetMemory() { memset(data_, OFFSET_PAGE_START, PAGE_SIZE); }
 
+  /** The data of a page that was not created by the buffer pool. */
+  std::unique_ptr<char[]> own_data_;
   /** The actual data that is stored within a page. */
-  char data_[PAGE_SIZE]{};
-  /** The ID of this page. */
-  page_id_t page_id_ = INVALID_PAGE_ID;
-  /** The pin count of this page. */
-  int pin_count_ = 0;
-  /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
-  bool is_dirty_ = false;
+  char *data_;
+  /** The ID of this page. Read without the buffer pool latch to validate lookups in the page table. */
+  std::atomic<page_id_t> page_id_ = INVALID_PAGE_ID;
+  /**
+   * The pin count of this page. -1 while the frame is free or being evicted: pinning without the buffer pool latch
+   * only succeeds on a non-negative count, so it can never resurrect a frame that is being reused.
+   */
+  std::atomic<int> pin_count_ = 0;
+  /** True if the page is dirty, i.e. it is different from its corresponding page on disk. Set without the latch. */
+  std::atomic<bool> is_dirty_ = false;
+  /** True while the buffer pool is reading the page in. The content of the frame is not valid until it is cleared. */
+  std::atomic<bool> io_in_progress_ = false;
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
+  /** Number of times the write latch was taken or released. Odd while it is held. */
+  std::atomic<uint64_t> version_ = 0;
 };
 
 }  // namespace bustub
@@ -137,6 +137,18 @@ class TablePage : public Page {
    */
   bool GetNextTupleRid(const RID &cur_rid, RID *next_rid);
 
+  /**
+   * Copies the tuple following the current one in this page, without a latch on the page or a lock on the tuple. This
+   * is for optimistic readers, which check that the page did not change before they use the copy, so unlike
+   * GetNextTupleRid() and GetTuple(), everything read from the page is checked against the page bounds first.
+   * @param cur_rid the RID of the current tuple
+   * @param[out] next_rid the RID of the next tuple
+   * @param[out] tuple receives the data of the next tuple, but not its RID
+   * @return true if the next tuple is in this page and was copied, false if it is not, or is deleted, or the page
+   * looks inconsistent
+   */
+  bool CopyNextTuple(const RID &cur_rid, RID *next_rid, Tuple *tuple);
+
  private:
   static_assert(sizeof(page_id_t) == 4);
 
@@ -36,9 +36,11 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param first_page_id the id of the first page
+   * @param owner_id the owner to charge the pages of the table to in the buffer pool, or NO_OWNER to register the table
+   * as "table:<first_page_id>", as the constructor that creates it does
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            page_id_t first_page_id);
+            page_id_t first_page_id, owner_id_t owner_id = NO_OWNER);
 
   /**
    * Create a table heap with a transaction. (create table)
@@ -46,18 +48,21 @@ class TableHeap {
    * @param lock_manager the lock manager
    * @param log_manager the log manager
    * @param txn the creating transaction
+   * @param owner_id the owner to charge the pages of the table to in the buffer pool, or NO_OWNER to register the table
+   * as "table:<first_page_id>" once its first page exists
    */
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-            Transaction *txn);
+            Transaction *txn, owner_id_t owner_id = NO_OWNER);
 
   /**
    * Insert a tuple into the table. If the tuple is too large (>= page_size), return false.
    * @param tuple tuple to insert
    * @param[out] rid the rid of the inserted tuple
    * @param txn the transaction performing the insert
+   * @param strategy the ring to bring in the pages walked by a bulk insert, or nullptr to use the whole buffer pool
    * @return true iff the insert is successful
    */
-  bool InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn);
+  bool InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
 
   /**
    * Mark the tuple as deleted. The actual delete will occur when ApplyDelete is called.
@@ -99,8 +104,12 @@ class TableHeap {
    */
   bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn);
 
-  /** @return the begin iterator of this table */
-  TableIterator Begin(Transaction *txn);
+  /**
+   * @param txn the transaction performing the scan
+   * @param strategy the ring to bring in the pages of a sequential scan, or nullptr to use the whole buffer pool
+   * @return the begin iterator of this table
+   */
+  TableIterator Begin(Transaction *txn, BufferAccessStrategy *strategy = nullptr);
 
   /** @return the end iterator of this table */
   TableIterator End();
@@ -108,11 +117,24 @@ class TableHeap {
   /** @return the id of the first page of this table */
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
+  /** @return the owner the pages of this table are charged to in the buffer pool */
+  inline owner_id_t GetOwnerId() const { return access_.owner_; }
+
  private:
+  /**
+   * Starts reading the pages of the table from the given one on in the background.
+   * @param page_id id of the first page to read ahead
+   * @param strategy the ring of the scan the pages are read for, or nullptr
+   * @return the number of pages asked for
+   */
+  size_t ReadAhead(page_id_t page_id, BufferAccessStrategy *strategy);
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  /** How the table accesses its pages, except in a scan. */
+  AccessContext access_;
 };
 
 }  // namespace bustub
@@ -20,6 +20,7 @@
 
 namespace bustub {
 
+class BufferAccessStrategy;
 class TableHeap;
 
 /**
@@ -29,10 +30,14 @@ class TableIterator {
   friend class Cursor;
 
  public:
-  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
+  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn, BufferAccessStrategy *strategy = nullptr);
 
   TableIterator(const TableIterator &other)
-      : table_heap_(other.table_heap_), tuple_(new Tuple(*other.tuple_)), txn_(other.txn_) {}
+      : table_heap_(other.table_heap_),
+        tuple_(new Tuple(*other.tuple_)),
+        txn_(other.txn_),
+        strategy_(other.strategy_),
+        pages_until_read_ahead_(other.pages_until_read_ahead_) {}
 
   ~TableIterator() { delete tuple_; }
 
@@ -52,6 +57,10 @@ class TableIterator {
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
+  /** Ring the pages of the scan are brought into, or nullptr to use the whole buffer pool. */
+  BufferAccessStrategy *strategy_;
+  /** Number of pages to move on before reading ahead again. */
+  size_t pages_until_read_ahead_{0};
 };
 
 }  // namespace bustub
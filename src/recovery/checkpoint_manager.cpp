@@ -18,6 +18,9 @@ void CheckpointManager::BeginCheckpoint() {
   // Block all the transactions and ensure that both the WAL and all dirty buffer pool pages are persisted to disk,
   // creating a consistent checkpoint. Do NOT allow transactions to resume at the end of this method, resume them
   // in CheckpointManager::EndCheckpoint() instead. This is for grading purposes.
+
+  // Remember the hot pages, so that a restart from this checkpoint starts with a warm buffer pool.
+  buffer_pool_manager_->SaveResidentPages();
 }
 
 void CheckpointManager::EndCheckpoint() {
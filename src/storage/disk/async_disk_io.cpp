@@ -0,0 +1,80 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// async_disk_io.cpp
+//
+// Identification: src/storage/disk/async_disk_io.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/async_disk_io.h"
+
+#include <sys/uio.h>
+#include <cerrno>
+
+namespace bustub {
+
+AsyncDiskIO *AsyncDiskIO::Create(int fd, DiskIOBackend backend, size_t queue_depth) {
+  if (backend != DiskIOBackend::THREAD_POOL) {
+    auto io_uring = new IoUringDiskIO(fd, queue_depth);
+    if (io_uring->Ok()) {
+      return io_uring;
+    }
+    delete io_uring;
+    if (backend == DiskIOBackend::IO_URING) {
+      return nullptr;
+    }
+  }
+  return new ThreadPoolDiskIO(fd, queue_depth);
+}
+
+ThreadPoolDiskIO::ThreadPoolDiskIO(int fd, size_t num_threads) : fd_(fd) {
+  for (size_t i = 0; i < num_threads; i++) {
+    threads_.emplace_back([this] { work(); });
+  }
+}
+
+ThreadPoolDiskIO::~ThreadPoolDiskIO() {
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    shutdown_ = true;
+  }
+  cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPoolDiskIO::Submit(const std::vector<DiskRequest> &requests) {
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    queue_.insert(queue_.end(), requests.begin(), requests.end());
+  }
+  cv_.notify_all();
+}
+
+void ThreadPoolDiskIO::work() {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (true) {
+    // Drain the queue before shutting down, so that every request gets its callback.
+    cv_.wait(lock, [this] { return shutdown_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    auto request = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    ssize_t result;
+    do {
+      result = request.is_write_ ? pwritev(fd_, request.iov_, request.iovcnt_, request.offset_)
+                                 : preadv(fd_, request.iov_, request.iovcnt_, request.offset_);
+    } while (result < 0 && errno == EINTR);
+    request.callback_(result < 0 ? -errno : result);
+    lock.lock();
+  }
+}
+
+}  // namespace bustub
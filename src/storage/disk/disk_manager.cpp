@@ -10,10 +10,19 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
+#include <linux/falloc.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <thread>  // NOLINT
 
@@ -25,18 +34,33 @@ namespace bustub {
 
 static char *buffer_used;
 
+/** Marks the header of a free space map file. */
+static constexpr uint64_t FSM_MAGIC = 0x4D53465F42555354ULL;
+/** Where the header of a free space map file says whether the map was written completely when it was closed. */
+static constexpr off_t FSM_CLEAN_OFFSET = sizeof(FSM_MAGIC);
+/** Number of words of the free space map in one of its bitmap pages. */
+static constexpr size_t FSM_WORDS_PER_PAGE = PAGE_SIZE / sizeof(uint64_t);
+
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), next_page_id_(0), num_flushes_(0), num_writes_(0), flush_log_(false), flush_log_f_(nullptr) {
+DiskManager::DiskManager(const std::string &db_file, DiskIOBackend backend, bool direct_io)
+    : backend_(backend),
+      direct_io_(direct_io),
+      file_name_(db_file),
+      next_page_id_(0),
+      num_flushes_(0),
+      num_writes_(0),
+      flush_log_(false),
+      flush_log_f_(nullptr) {
   std::string::size_type n = file_name_.rfind('.');
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
+  fsm_name_ = file_name_.substr(0, n) + ".fsm";
 
   log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
   // directory or file does not exist
@@ -52,76 +76,352 @@ DiskManager::DiskManager(const std::string &db_file)
     }
   }
 
-  db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
-  // directory or file does not exist
-  if (!db_io_.is_open()) {
-    db_io_.clear();
-    // create a new file
-    db_io_.open(db_file, std::ios::binary | std::ios::trunc | std::ios::out);
-    db_io_.close();
-    // reopen with original mode
-    db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
-    if (!db_io_.is_open()) {
-      throw Exception("can't open db file");
-    }
+  db_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT | (direct_io_ ? O_DIRECT : 0), 0644);
+  if (db_fd_ < 0 && direct_io_ && errno == EINVAL) {
+    // e.g. tmpfs, which has no page cache to bypass
+    LOG_WARN("%s does not allow direct I/O, falling back to the page cache", db_file.c_str());
+    direct_io_ = false;
+    db_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
   }
+  if (db_fd_ < 0) {
+    throw Exception("can't open db file");
+  }
+  struct stat stat_buf;
+  if (fstat(db_fd_, &stat_buf) == 0) {
+    db_file_size_ = static_cast<size_t>(stat_buf.st_size);
+  }
+  openFreeSpaceMap();
   buffer_used = nullptr;
 }
 
+/**
+ * Destructor: a disk manager that was not shut down still writes its free space map out completely
+ */
+DiskManager::~DiskManager() { ShutDown(); }
+
 /**
  * Close all file streams
  */
 void DiskManager::ShutDown() {
-  db_io_.close();
+  // the asynchronous I/O waits for what is in flight, which needs the descriptor
+  delete async_io_.exchange(nullptr);
   log_io_.close();
+  if (db_fd_ >= 0) {
+    close(db_fd_);
+    db_fd_ = -1;
+  }
+  if (fsm_fd_ >= 0) {
+    FlushFreeSpaceMap();
+    uint64_t clean = 1;
+    if (pwrite(fsm_fd_, &clean, sizeof(clean), FSM_CLEAN_OFFSET) != sizeof(clean) || fdatasync(fsm_fd_) != 0) {
+      LOG_DEBUG("I/O error while closing the free space map");
+    }
+    close(fsm_fd_);
+    fsm_fd_ = -1;
+  }
 }
 
 /**
  * Write the contents of the specified page into disk file
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
-  size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;
-  // set write cursor to offset
+  PageRun run{{{const_cast<char *>(page_data), PAGE_SIZE}}, static_cast<off_t>(page_id) * PAGE_SIZE, {}};
   num_writes_ += 1;
-  db_io_.seekp(offset);
-  db_io_.write(page_data, PAGE_SIZE);
-  // check for I/O error
-  if (db_io_.bad()) {
+  bounceIn(true, &run);
+  if (!writeRun(&run.iov_, run.offset_)) {
+    LOG_DEBUG("I/O error while writing");
+  }
+  bounceOut(true, &run);
+}
+
+/**
+ * Write the contents of several pages into disk file, coalescing adjacent pages
+ */
+void DiskManager::WritePages(std::vector<std::pair<page_id_t, const char *>> pages, bool sync) {
+  std::sort(pages.begin(), pages.end());
+  std::vector<PageRun> runs;
+  for (size_t begin = 0; begin < pages.size();) {
+    // gather the run of adjacent pages starting at begin
+    size_t end = begin;
+    PageRun run{{}, static_cast<off_t>(pages[begin].first) * PAGE_SIZE, {}};
+    do {
+      run.iov_.push_back({const_cast<char *>(pages[end].second), PAGE_SIZE});
+      end++;
+    } while (end < pages.size() && run.iov_.size() < IOV_MAX && pages[end].first == pages[end - 1].first + 1);
+    runs.push_back(std::move(run));
+    begin = end;
+  }
+  num_writes_ += static_cast<int>(pages.size());
+  bool ok = true;
+  if (runs.size() == 1) {
+    bounceIn(true, &runs[0]);
+    ok = writeRun(&runs[0].iov_, runs[0].offset_);
+    bounceOut(true, &runs[0]);
+  } else if (runs.size() > 1) {
+    // have every run in flight at once
+    std::promise<bool> done;
+    submitRuns(true, std::move(runs), [&done](bool runs_ok) { done.set_value(runs_ok); });
+    ok = done.get_future().get();
+  }
+  if (!ok) {
     LOG_DEBUG("I/O error while writing");
     return;
   }
-  // needs to flush to keep disk file in sync
-  db_io_.flush();
+  if (sync) {
+    FlushFreeSpaceMap();
+    if (fdatasync(db_fd_) != 0) {
+      LOG_DEBUG("I/O error while syncing");
+    }
+  }
 }
 
 /**
  * Read the contents of the specified page into the given memory area
  */
 void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
-  int offset = page_id * PAGE_SIZE;
-  // check if read beyond file length
-  if (offset > GetFileSize(file_name_)) {
-    LOG_DEBUG("I/O error reading past end of file");
-    // std::cerr << "I/O error while reading" << std::endl;
+  auto offset = static_cast<size_t>(page_id) * PAGE_SIZE;
+  // a page that was never written reads as zeros, without asking the file system
+  if (offset >= db_file_size_.load()) {
+    LOG_DEBUG("Read past end of file");
+    memset(page_data, 0, PAGE_SIZE);
+    return;
+  }
+  PageRun run{{{page_data, PAGE_SIZE}}, static_cast<off_t>(offset), {}};
+  bounceIn(false, &run);
+  readRun(&run.iov_, run.offset_);
+  bounceOut(false, &run);
+}
+
+/**
+ * Read the contents of several pages into the given memory areas, coalescing adjacent pages
+ */
+void DiskManager::ReadPages(std::vector<std::pair<page_id_t, char *>> pages) {
+  std::sort(pages.begin(), pages.end());
+  std::vector<PageRun> runs;
+  for (size_t begin = 0; begin < pages.size();) {
+    // gather the run of adjacent pages starting at begin
+    size_t end = begin;
+    PageRun run{{}, static_cast<off_t>(pages[begin].first) * PAGE_SIZE, {}};
+    do {
+      run.iov_.push_back({pages[end].second, PAGE_SIZE});
+      end++;
+    } while (end < pages.size() && run.iov_.size() < IOV_MAX && pages[end].first == pages[end - 1].first + 1);
+    runs.push_back(std::move(run));
+    begin = end;
+  }
+  if (runs.size() == 1) {
+    bounceIn(false, &runs[0]);
+    readRun(&runs[0].iov_, runs[0].offset_);
+    bounceOut(false, &runs[0]);
+  } else if (runs.size() > 1) {
+    // have every run in flight at once
+    std::promise<bool> done;
+    submitRuns(false, std::move(runs), [&done](bool runs_ok) { done.set_value(runs_ok); });
+    done.get_future().wait();
+  }
+}
+
+/**
+ * Start reading the specified page, and call back once it is in the given memory area
+ */
+void DiskManager::ReadPageAsync(page_id_t page_id, char *page_data, std::function<void(bool)> callback) {
+  std::vector<PageRun> runs{{{{page_data, PAGE_SIZE}}, static_cast<off_t>(page_id) * PAGE_SIZE, {}}};
+  submitRuns(false, std::move(runs), std::move(callback));
+}
+
+std::future<bool> DiskManager::ReadPageAsync(page_id_t page_id, char *page_data) {
+  auto done = std::make_shared<std::promise<bool>>();
+  ReadPageAsync(page_id, page_data, [done](bool ok) { done->set_value(ok); });
+  return done->get_future();
+}
+
+/**
+ * Start writing the contents of the specified page into disk file, and call back once it is written
+ */
+void DiskManager::WritePageAsync(page_id_t page_id, const char *page_data, std::function<void(bool)> callback) {
+  std::vector<PageRun> runs{
+      {{{const_cast<char *>(page_data), PAGE_SIZE}}, static_cast<off_t>(page_id) * PAGE_SIZE, {}}};
+  num_writes_ += 1;
+  submitRuns(true, std::move(runs), std::move(callback));
+}
+
+std::future<bool> DiskManager::WritePageAsync(page_id_t page_id, const char *page_data) {
+  auto done = std::make_shared<std::promise<bool>>();
+  WritePageAsync(page_id, page_data, [done](bool ok) { done->set_value(ok); });
+  return done->get_future();
+}
+
+AsyncDiskIO *DiskManager::asyncIO() {
+  auto async_io = async_io_.load();
+  if (async_io != nullptr) {
+    return async_io;
+  }
+  std::lock_guard<std::mutex> guard(async_io_latch_);
+  async_io = async_io_.load();
+  if (async_io == nullptr) {
+    async_io = AsyncDiskIO::Create(db_fd_, backend_, ASYNC_QUEUE_DEPTH);
+    if (async_io == nullptr) {
+      throw Exception("asynchronous I/O backend is not available");
+    }
+    async_io_.store(async_io);
+  }
+  return async_io;
+}
+
+void DiskManager::submitRuns(bool is_write, std::vector<PageRun> runs, std::function<void(bool)> callback) {
+  // the runs and their buffers live until the last of them is done
+  struct Batch {
+    std::vector<PageRun> runs_;
+    std::atomic<size_t> remaining_;
+    std::atomic<bool> ok_{true};
+    std::function<void(bool)> callback_;
+  };
+  auto batch = std::make_shared<Batch>();
+  batch->runs_ = std::move(runs);
+  batch->remaining_ = batch->runs_.size();
+  batch->callback_ = std::move(callback);
+  std::vector<DiskRequest> requests;
+  requests.reserve(batch->runs_.size());
+  for (auto &run : batch->runs_) {
+    bounceIn(is_write, &run);
+    auto *run_ptr = &run;
+    requests.push_back({is_write, run.iov_.data(), static_cast<int>(run.iov_.size()), run.offset_,
+                        [this, batch, is_write, run_ptr](ssize_t result) {
+                          if (!finishRun(is_write, run_ptr, result)) {
+                            batch->ok_ = false;
+                          }
+                          if (batch->remaining_.fetch_sub(1) == 1) {
+                            batch->callback_(batch->ok_.load());
+                          }
+                        }});
+  }
+  asyncIO()->Submit(requests);
+}
+
+bool DiskManager::finishRun(bool is_write, PageRun *run, ssize_t result) {
+  if (result < 0) {
+    LOG_DEBUG("I/O error in asynchronous %s", is_write ? "write" : "read");
+    if (!is_write) {
+      for (auto &entry : run->iov_) {
+        memset(entry.iov_base, 0, entry.iov_len);
+      }
+    }
+    bounceOut(is_write, run);
+    return false;
+  }
+  // a short transfer may stop in the middle of a page: finish the rest synchronously
+  size_t next = 0;
+  advance(&run->iov_, &next, static_cast<size_t>(result));
+  run->iov_.erase(run->iov_.begin(), run->iov_.begin() + next);
+  run->offset_ += result;
+  bool ok = true;
+  if (is_write) {
+    // also grows the file size to cover the run, when nothing is left
+    ok = writeRun(&run->iov_, run->offset_);
   } else {
-    // set read cursor to offset
-    db_io_.seekp(offset);
-    db_io_.read(page_data, PAGE_SIZE);
-    if (db_io_.bad()) {
-      LOG_DEBUG("I/O error while reading");
-      return;
+    readRun(&run->iov_, run->offset_);
+  }
+  bounceOut(is_write, run);
+  return ok;
+}
+
+void DiskManager::bounceIn(bool is_write, PageRun *run) {
+  if (!direct_io_) {
+    return;
+  }
+  for (auto &entry : run->iov_) {
+    if (reinterpret_cast<uintptr_t>(entry.iov_base) % DIRECT_IO_ALIGNMENT == 0) {
+      continue;
+    }
+    auto bounce = static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, PAGE_SIZE));
+    if (bounce == nullptr) {
+      throw Exception(ExceptionType::OUT_OF_MEMORY, "cannot allocate a buffer for direct I/O");
+    }
+    if (is_write) {
+      memcpy(bounce, entry.iov_base, PAGE_SIZE);
+    }
+    run->bounces_.emplace_back(bounce, static_cast<char *>(entry.iov_base));
+    entry.iov_base = bounce;
+  }
+}
+
+void DiskManager::bounceOut(bool is_write, PageRun *run) {
+  for (auto &bounce : run->bounces_) {
+    if (!is_write) {
+      memcpy(bounce.second, bounce.first, PAGE_SIZE);
+    }
+    std::free(bounce.first);
+  }
+  run->bounces_.clear();
+}
+
+void DiskManager::advance(std::vector<iovec> *iov, size_t *next, size_t count) {
+  while (count > 0) {
+    auto &entry = (*iov)[*next];
+    auto consumed = std::min(count, entry.iov_len);
+    entry.iov_base = static_cast<char *>(entry.iov_base) + consumed;
+    entry.iov_len -= consumed;
+    count -= consumed;
+    if (entry.iov_len == 0) {
+      (*next)++;
+    }
+  }
+}
+
+bool DiskManager::writeRun(std::vector<iovec> *iov, off_t offset) {
+  auto end = static_cast<size_t>(offset);
+  for (const auto &entry : *iov) {
+    end += entry.iov_len;
+  }
+  size_t next = 0;
+  while (next < iov->size()) {
+    auto written = pwritev(db_fd_, iov->data() + next, static_cast<int>(iov->size() - next), offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    // a short write may stop in the middle of a page: skip what made it to disk and retry with the rest
+    offset += written;
+    advance(iov, &next, static_cast<size_t>(written));
+  }
+  // the file only grows, so keep the largest end anyone wrote
+  auto size = db_file_size_.load();
+  while (size < end && !db_file_size_.compare_exchange_weak(size, end)) {
+    // somebody else grew the file meanwhile; size now holds how far
+  }
+  return true;
+}
+
+void DiskManager::readRun(std::vector<iovec> *iov, off_t offset) {
+  size_t next = 0;
+  while (next < iov->size()) {
+    auto read_count = preadv(db_fd_, iov->data() + next, static_cast<int>(iov->size() - next), offset);
+    if (read_count < 0 && errno == EINTR) {
+      continue;
     }
-    // if file ends before reading PAGE_SIZE
-    int read_count = db_io_.gcount();
-    if (read_count < PAGE_SIZE) {
-      LOG_DEBUG("Read less than a page");
-      db_io_.clear();
-      // std::cerr << "Read less than a page" << std::endl;
-      memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+    if (read_count <= 0) {
+      // end of file, or an I/O error: the rest of the run reads as zeros
+      if (read_count < 0) {
+        LOG_DEBUG("I/O error while reading");
+      }
+      for (; next < iov->size(); next++) {
+        memset((*iov)[next].iov_base, 0, (*iov)[next].iov_len);
+      }
+      return;
     }
+    // a short read may stop in the middle of a page: skip what was read and retry with the rest
+    offset += read_count;
+    advance(iov, &next, static_cast<size_t>(read_count));
   }
 }
 
+/**
+ * Return the number of pages in the db file
+ */
+size_t DiskManager::GetNumPages() { return db_file_size_.load() / PAGE_SIZE; }
+
 /**
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
@@ -186,16 +486,221 @@ bool DiskManager::ReadLog(char *log_data, int size, int offset) {
 
 /**
  * Allocate new page (operations like create index/table)
- * For now just keep an increasing counter
  */
-page_id_t DiskManager::AllocatePage() { return next_page_id_++; }
+page_id_t DiskManager::AllocatePage() { return AllocatePages(1); }
+
+/**
+ * Allocate a run of new pages, first fit
+ */
+page_id_t DiskManager::AllocatePages(size_t num_pages) {
+  std::lock_guard<std::mutex> guard(alloc_latch_);
+  while (first_free_word_ < allocated_.size() && allocated_[first_free_word_] == ~uint64_t{0}) {
+    first_free_word_++;
+  }
+  auto end = static_cast<size_t>(next_page_id_);
+  auto start = end;
+  size_t run = 0;
+  size_t page = first_free_word_ * 64;
+  for (; page < end && run < num_pages; page++) {
+    if (page % 64 == 0 && allocated_[page / 64] == ~uint64_t{0}) {
+      // a whole word of allocated pages
+      run = 0;
+      page += 63;
+    } else if (isAllocated(page)) {
+      run = 0;
+    } else if (run++ == 0) {
+      start = page;
+    }
+  }
+  // a run that is too short but reaches the last allocated page goes on with the free pages after it
+  if (run == 0) {
+    start = page;
+  }
+  setAllocated(static_cast<page_id_t>(start), num_pages, true);
+  return static_cast<page_id_t>(start);
+}
+
+/**
+ * Allocate a run of new pages for one owner, and reserve their disk space without growing the file
+ */
+page_id_t DiskManager::AllocateExtent(size_t num_pages) {
+  auto first = AllocatePages(num_pages);
+  if (fallocate(db_fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(first) * PAGE_SIZE,
+                static_cast<off_t>(num_pages) * PAGE_SIZE) != 0 &&
+      errno != EOPNOTSUPP) {
+    LOG_DEBUG("I/O error while reserving an extent");
+  }
+  return first;
+}
 
 /**
  * Deallocate page (operations like drop index/table)
- * Need bitmap in header page for tracking pages
- * This does not actually need to do anything for now.
  */
-void DiskManager::DeallocatePage(__attribute__((unused)) page_id_t page_id) {}
+void DiskManager::DeallocatePage(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(alloc_latch_);
+  if (page_id < 0 || !isAllocated(page_id)) {
+    return;
+  }
+  setAllocated(page_id, 1, false);
+}
+
+bool DiskManager::IsAllocated(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(alloc_latch_);
+  return page_id >= 0 && isAllocated(page_id);
+}
+
+/**
+ * Give the space of deallocated pages back: punch holes for them, and cut off the free tail of the file
+ */
+size_t DiskManager::Compact() {
+  std::lock_guard<std::mutex> guard(alloc_latch_);
+  auto file_pages = GetNumPages();
+  auto live_end = std::min(file_pages, static_cast<size_t>(next_page_id_));
+  size_t released = 0;
+  for (size_t page = 0; page < live_end;) {
+    if (isAllocated(page)) {
+      page++;
+      continue;
+    }
+    auto begin = page;
+    while (page < live_end && !isAllocated(page)) {
+      page++;
+    }
+    if (fallocate(db_fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(begin) * PAGE_SIZE,
+                  static_cast<off_t>(page - begin) * PAGE_SIZE) == 0) {
+      released += page - begin;
+    }
+  }
+  if (file_pages > live_end) {
+    if (ftruncate(db_fd_, static_cast<off_t>(live_end) * PAGE_SIZE) == 0) {
+      db_file_size_ = live_end * PAGE_SIZE;
+      released += file_pages - live_end;
+    } else {
+      LOG_DEBUG("I/O error while truncating");
+    }
+  }
+  return released;
+}
+
+/**
+ * Write the bitmap pages that changed, from copies, so that pages can be allocated meanwhile
+ */
+void DiskManager::FlushFreeSpaceMap() {
+  std::lock_guard<std::mutex> flush_guard(fsm_flush_latch_);
+  if (fsm_fd_ < 0) {
+    return;
+  }
+  std::vector<std::pair<size_t, std::vector<uint64_t>>> pages;
+  {
+    std::lock_guard<std::mutex> guard(alloc_latch_);
+    for (size_t page = 0; page < fsm_dirty_.size(); page++) {
+      if (fsm_dirty_[page]) {
+        auto words = allocated_.begin() + page * FSM_WORDS_PER_PAGE;
+        pages.emplace_back(page, std::vector<uint64_t>(words, words + FSM_WORDS_PER_PAGE));
+        fsm_dirty_[page] = false;
+      }
+    }
+  }
+  std::vector<size_t> failed;
+  for (const auto &[page, words] : pages) {
+    if (pwrite(fsm_fd_, words.data(), PAGE_SIZE, static_cast<off_t>((page + 1) * PAGE_SIZE)) != PAGE_SIZE) {
+      failed.push_back(page);
+    }
+  }
+  if (!failed.empty() || fdatasync(fsm_fd_) != 0) {
+    LOG_DEBUG("I/O error while writing the free space map");
+    // try again next time
+    std::lock_guard<std::mutex> guard(alloc_latch_);
+    for (auto page : failed) {
+      fsm_dirty_[page] = true;
+    }
+  }
+}
+
+void DiskManager::openFreeSpaceMap() {
+  fsm_fd_ = open(fsm_name_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fsm_fd_ < 0) {
+    throw Exception("can't open free space map file");
+  }
+  auto db_pages = GetNumPages();
+  uint64_t header[2] = {0, 0};
+  struct stat stat_buf;
+  bool crashed = false;
+  // A map next to an empty db file is left over from a database that was removed.
+  if (db_pages > 0 && pread(fsm_fd_, header, sizeof(header), 0) == sizeof(header) && header[0] == FSM_MAGIC &&
+      fstat(fsm_fd_, &stat_buf) == 0) {
+    auto map_size = static_cast<size_t>(stat_buf.st_size);
+    auto bytes = map_size > PAGE_SIZE ? (map_size - PAGE_SIZE) / sizeof(uint64_t) * sizeof(uint64_t) : 0;
+    allocated_.resize((bytes / sizeof(uint64_t) + FSM_WORDS_PER_PAGE - 1) / FSM_WORDS_PER_PAGE * FSM_WORDS_PER_PAGE);
+    fsm_dirty_.resize(allocated_.size() / FSM_WORDS_PER_PAGE);
+    if (bytes > 0 && pread(fsm_fd_, allocated_.data(), bytes, PAGE_SIZE) != static_cast<ssize_t>(bytes)) {
+      throw Exception("can't read free space map file");
+    }
+    crashed = header[1] == 0;
+  } else {
+    std::vector<char> header(PAGE_SIZE, 0);
+    memcpy(header.data(), &FSM_MAGIC, sizeof(FSM_MAGIC));
+    if (ftruncate(fsm_fd_, 0) != 0 || pwrite(fsm_fd_, header.data(), PAGE_SIZE, 0) != PAGE_SIZE) {
+      throw Exception("can't write free space map file");
+    }
+    allocated_.clear();
+    fsm_dirty_.clear();
+    next_page_id_ = 0;
+    // a db file from before there was a free space map: any page in it may be in use
+    if (db_pages > 0) {
+      setAllocated(0, db_pages, true);
+    }
+  }
+  next_page_id_ = static_cast<page_id_t>(allocated_.size() * 64);
+  while (next_page_id_ > 0 && !isAllocated(next_page_id_ - 1)) {
+    next_page_id_--;
+  }
+  // The pages the db file grew by after the map was last written are in use, as far as we know.
+  if (crashed && db_pages > static_cast<size_t>(next_page_id_)) {
+    setAllocated(next_page_id_, db_pages - next_page_id_, true);
+  }
+  // Until ShutDown() writes the whole map, a restart has to take it for out of date.
+  uint64_t clean = 0;
+  if (pwrite(fsm_fd_, &clean, sizeof(clean), FSM_CLEAN_OFFSET) != sizeof(clean) || fdatasync(fsm_fd_) != 0) {
+    throw Exception("can't write free space map file");
+  }
+}
+
+void DiskManager::setAllocated(page_id_t first, size_t num_pages, bool allocated) {
+  if (num_pages == 0) {
+    return;
+  }
+  auto begin = static_cast<size_t>(first);
+  auto end = begin + num_pages;
+  if (end > allocated_.size() * 64) {
+    // the map grows by whole bitmap pages
+    allocated_.resize(((end + 63) / 64 + FSM_WORDS_PER_PAGE - 1) / FSM_WORDS_PER_PAGE * FSM_WORDS_PER_PAGE, 0);
+    fsm_dirty_.resize(allocated_.size() / FSM_WORDS_PER_PAGE, false);
+  }
+  for (auto page = begin; page < end; page++) {
+    auto mask = uint64_t{1} << (page % 64);
+    if (allocated) {
+      allocated_[page / 64] |= mask;
+    } else {
+      allocated_[page / 64] &= ~mask;
+    }
+  }
+  auto first_word = begin / 64;
+  for (auto page = first_word / FSM_WORDS_PER_PAGE; page <= (end - 1) / 64 / FSM_WORDS_PER_PAGE; page++) {
+    fsm_dirty_[page] = true;
+  }
+  if (allocated) {
+    next_page_id_ = std::max(next_page_id_, static_cast<page_id_t>(end));
+  } else {
+    first_free_word_ = std::min(first_free_word_, first_word);
+    if (end >= static_cast<size_t>(next_page_id_)) {
+      next_page_id_ = std::min(next_page_id_, first);
+      while (next_page_id_ > 0 && !isAllocated(next_page_id_ - 1)) {
+        next_page_id_--;
+      }
+    }
+  }
+}
 
 /**
  * Returns number of flushes made so far
@@ -0,0 +1,310 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// io_uring_disk_io.cpp
+//
+// Identification: src/storage/disk/io_uring_disk_io.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>  // NOLINT
+#include <cstring>
+
+#include "common/logger.h"
+#include "storage/disk/async_disk_io.h"
+
+namespace bustub {
+
+namespace {
+
+/** User data of the request that tells the completion thread to stop. Slots are numbered from 0. */
+constexpr uint64_t SHUTDOWN_USER_DATA = UINT64_MAX;
+
+int IoUringSetup(unsigned entries, io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int IoUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+}  // namespace
+
+IoUringDiskIO::IoUringDiskIO(int fd, size_t queue_depth) : fd_(fd) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = IoUringSetup(static_cast<unsigned>(queue_depth), &params);
+  if (ring_fd_ < 0) {
+    return;
+  }
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  auto map = [this](size_t size, off_t offset) {
+    auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    return memory == MAP_FAILED ? nullptr : memory;
+  };
+  sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+  cq_ring_ = single_mmap ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = map(sqes_size_, IORING_OFF_SQES);
+  if (sq_ring_ == nullptr || cq_ring_ == nullptr || sqes_ == nullptr) {
+    teardown();
+    return;
+  }
+
+  auto sq = static_cast<char *>(sq_ring_);
+  sq_head_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_array_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+  auto cq = static_cast<char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+  cqes_offset_ = params.cq_off.cqes;
+
+  callbacks_.resize(sq_entries_);
+  for (uint32_t slot = sq_entries_; slot > 0; slot--) {
+    free_slots_.push_back(slot - 1);
+  }
+  reaper_ = std::thread([this] { reap(); });
+}
+
+IoUringDiskIO::~IoUringDiskIO() {
+  if (!Ok()) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(latch_);
+    slot_freed_.wait(lock, [this] { return free_slots_.size() == sq_entries_; });
+    if (error_ != 0) {
+      // The completion thread has stopped already.
+      lock.unlock();
+      reaper_.join();
+      teardown();
+      return;
+    }
+    // Nothing is in flight, so there is room for the request that stops the completion thread.
+    auto tail = *sq_tail_;
+    auto index = tail & sq_mask_;
+    auto sqe = static_cast<io_uring_sqe *>(sqes_) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = SHUTDOWN_USER_DATA;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    auto error = submitEntries(1, &lock);
+    while (error == -EAGAIN || error == -EBUSY) {
+      // Nothing is in flight, so only the kernel itself can make room; give it a moment.
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      lock.lock();
+      error = submitEntries(1, &lock);
+    }
+    if (error != 0) {
+      // A ring that refuses the request refuses to be waited on as well, so the completion thread stops by itself.
+      LOG_WARN("cannot stop io_uring completion thread: %s", strerror(-error));
+    }
+  }
+  reaper_.join();
+  teardown();
+}
+
+void IoUringDiskIO::Submit(const std::vector<DiskRequest> &requests) {
+  std::unique_lock<std::mutex> lock(latch_);
+  slot_freed_.wait(lock, [this] { return !stalled_; });
+  unsigned to_submit = 0;
+  int error = error_;
+  size_t next = 0;
+  for (; next < requests.size() && error == 0; next++) {
+    const auto &request = requests[next];
+    if (free_slots_.empty()) {
+      // Hand over what is queued, since our own requests may be the ones whose completion we are waiting for.
+      error = submitEntries(to_submit, &lock);
+      to_submit = 0;
+      if (error != 0) {
+        break;
+      }
+      slot_freed_.wait(lock, [this] { return (!free_slots_.empty() && !stalled_) || error_ != 0; });
+      error = error_;
+      if (error != 0) {
+        break;
+      }
+    }
+    auto slot = free_slots_.back();
+    free_slots_.pop_back();
+    callbacks_[slot] = request.callback_;
+    // At most sq_entries_ requests are in flight, and the kernel takes every entry it is handed right away, so the
+    // submission ring always has room.
+    auto tail = *sq_tail_;
+    auto index = tail & sq_mask_;
+    auto sqe = static_cast<io_uring_sqe *>(sqes_) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request.is_write_ ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(request.iov_);
+    sqe->len = static_cast<uint32_t>(request.iovcnt_);
+    sqe->off = static_cast<uint64_t>(request.offset_);
+    sqe->user_data = slot;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    to_submit++;
+  }
+  if (error == 0) {
+    error = submitEntries(to_submit, &lock);
+  }
+  if (error == 0) {
+    return;
+  }
+
+  // Take back what the kernel did not take, and fail it along with the requests that were not queued yet.
+  LOG_WARN("cannot submit io_uring requests: %s", strerror(-error));
+  auto failed = unsubmit();
+  lock.unlock();
+  slot_freed_.notify_all();
+  for (auto &callback : failed) {
+    callback(error);
+  }
+  for (; next < requests.size(); next++) {
+    requests[next].callback_(error);
+  }
+}
+
+int IoUringDiskIO::submitEntries(unsigned to_submit, std::unique_lock<std::mutex> *lock) {
+  while (to_submit > 0 && error_ == 0) {
+    auto submitted = IoUringEnter(ring_fd_, to_submit, 0, 0);
+    if (submitted >= 0) {
+      to_submit -= submitted;
+      continue;
+    }
+    auto error = errno;
+    if (error == EINTR) {
+      continue;
+    }
+    // The entries still in the ring hold slots as well, but are not in flight.
+    auto in_flight = static_cast<int64_t>(sq_entries_ - free_slots_.size()) - to_submit;
+    if ((error != EAGAIN && error != EBUSY) || in_flight <= 0) {
+      return -error;
+    }
+    // The kernel wants completions reaped first. Let the completion thread at the latch, but keep other submitters
+    // off the ring until our entries are in.
+    stalled_ = true;
+    auto free_slots = free_slots_.size();
+    slot_freed_.wait(*lock, [&] { return free_slots_.size() > free_slots || error_ != 0; });
+    stalled_ = false;
+    slot_freed_.notify_all();
+  }
+  return error_;
+}
+
+void IoUringDiskIO::failAll(int error) {
+  std::vector<std::function<void(ssize_t)>> failed;
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    error_ = error;
+    // Entries a stalled submitter has not handed over yet are failed here, and no longer in its way.
+    failed = unsubmit();
+    std::vector<bool> free(sq_entries_, false);
+    for (auto slot : free_slots_) {
+      free[slot] = true;
+    }
+    for (uint32_t slot = 0; slot < sq_entries_; slot++) {
+      if (!free[slot]) {
+        failed.push_back(std::move(callbacks_[slot]));
+        free_slots_.push_back(slot);
+      }
+    }
+  }
+  slot_freed_.notify_all();
+  for (auto &callback : failed) {
+    callback(error);
+  }
+}
+
+std::vector<std::function<void(ssize_t)>> IoUringDiskIO::unsubmit() {
+  // Without a kernel thread polling the ring, the kernel only takes entries during io_uring_enter().
+  auto head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  auto tail = *sq_tail_;
+  std::vector<std::function<void(ssize_t)>> callbacks;
+  for (auto entry = head; entry != tail; entry++) {
+    auto sqe = static_cast<io_uring_sqe *>(sqes_) + sq_array_[entry & sq_mask_];
+    auto slot = static_cast<uint32_t>(sqe->user_data);
+    callbacks.push_back(std::move(callbacks_[slot]));
+    free_slots_.push_back(slot);
+  }
+  __atomic_store_n(sq_tail_, head, __ATOMIC_RELEASE);
+  return callbacks;
+}
+
+void IoUringDiskIO::reap() {
+  auto cqes = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(cq_ring_) + cqes_offset_);
+  while (true) {
+    // Only this thread moves the head, and the kernel publishes the tail after the entries before it.
+    auto head = *cq_head_;
+    auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      // Waiting holds no latch, so it is simply retried while the kernel is short of resources.
+      if (IoUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN &&
+          errno != EBUSY) {
+        // Nothing that is in flight can be seen to complete anymore.
+        auto error = errno;
+        LOG_WARN("cannot wait for io_uring completions: %s", strerror(error));
+        failAll(-error);
+        return;
+      }
+      continue;
+    }
+    bool shutdown = false;
+    for (; head != tail; head++) {
+      const auto &cqe = cqes[head & cq_mask_];
+      if (cqe.user_data == SHUTDOWN_USER_DATA) {
+        shutdown = true;
+        continue;
+      }
+      auto slot = static_cast<uint32_t>(cqe.user_data);
+      std::function<void(ssize_t)> callback;
+      {
+        std::lock_guard<std::mutex> lock(latch_);
+        callback = std::move(callbacks_[slot]);
+        free_slots_.push_back(slot);
+      }
+      slot_freed_.notify_all();
+      callback(cqe.res);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    if (shutdown) {
+      return;
+    }
+  }
+}
+
+void IoUringDiskIO::teardown() {
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != nullptr) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  sqes_ = cq_ring_ = sq_ring_ = nullptr;
+  close(ring_fd_);
+  ring_fd_ = -1;
+}
+
+}  // namespace bustub
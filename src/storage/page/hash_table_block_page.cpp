@@ -36,6 +36,12 @@ ValueType HASH_TABLE_BLOCK_TYPE::ValueAt(slot_offset_t bucket_ind) const {
   return this->array_[bucket_ind].second;
 }
 
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_BLOCK_TYPE::CopyPairAt(slot_offset_t bucket_ind, KeyType *key, ValueType *value) const {
+  *key = this->array_[bucket_ind].first;
+  *value = this->array_[bucket_ind].second;
+}
+
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool HASH_TABLE_BLOCK_TYPE::Insert(slot_offset_t bucket_ind, const KeyType &key, const ValueType &value) {
   auto offset = bucket_ind / 8;
@@ -31,7 +31,7 @@ lsn_t HashTableHeaderPage::GetLSN() const { return this->lsn_; }
 void HashTableHeaderPage::SetLSN(lsn_t lsn) { this->lsn_ = lsn; }
 
 void HashTableHeaderPage::AddBlockPageId(page_id_t page_id) {
-  if (next_ind_ >= this->GetSize()) {
+  if (next_ind_ >= this->GetSize() || next_ind_ >= this->MaxBlocks()) {
     throw new Exception("Reach limit of block_page_ids_");
   }
   this->block_page_ids_[next_ind_] = page_id;
@@ -40,6 +40,11 @@ void HashTableHeaderPage::AddBlockPageId(page_id_t page_id) {
 
 size_t HashTableHeaderPage::NumBlocks() { return this->next_ind_; }
 
+size_t HashTableHeaderPage::MaxBlocks() const {
+  auto header_size = reinterpret_cast<const char *>(this->block_page_ids_) - reinterpret_cast<const char *>(this);
+  return (PAGE_SIZE - header_size) / sizeof(page_id_t);
+}
+
 void HashTableHeaderPage::ResetBlockIndex() { this->next_ind_ = 0; }
 
 void HashTableHeaderPage::SetSize(size_t size) { this->size_ = size; }
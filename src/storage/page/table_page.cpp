@@ -329,4 +329,35 @@ bool TablePage::GetNextTupleRid(const RID &cur_rid, RID *next_rid) {
   next_rid->Set(INVALID_PAGE_ID, 0);
   return false;
 }
+
+bool TablePage::CopyNextTuple(const RID &cur_rid, RID *next_rid, Tuple *tuple) {
+  uint32_t tuple_count = GetTupleCount();
+  if (tuple_count > (PAGE_SIZE - SIZE_TABLE_PAGE_HEADER) / SIZE_TUPLE) {
+    return false;
+  }
+  for (auto i = cur_rid.GetSlotNum() + 1; i < tuple_count; ++i) {
+    uint32_t tuple_size = GetTupleSize(i);
+    if (tuple_size == 0) {
+      continue;
+    }
+    uint32_t tuple_offset = GetTupleOffsetAtSlot(i);
+    if (IsDeleted(tuple_size) || tuple_size > PAGE_SIZE || tuple_offset < SIZE_TABLE_PAGE_HEADER ||
+        tuple_offset > PAGE_SIZE - tuple_size) {
+      return false;
+    }
+    // Scans mostly see tuples of the same size one after the other, which can reuse the buffer.
+    if (!tuple->allocated_ || tuple->size_ != tuple_size) {
+      if (tuple->allocated_) {
+        delete[] tuple->data_;
+      }
+      tuple->data_ = new char[tuple_size];
+      tuple->size_ = tuple_size;
+      tuple->allocated_ = true;
+    }
+    memcpy(tuple->data_, GetData() + tuple_offset, tuple_size);
+    next_rid->Set(GetTablePageId(), i);
+    return true;
+  }
+  return false;
+}
 }  // namespace bustub
@@ -10,7 +10,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
+#include <string>
 
 #include "common/logger.h"
 #include "storage/table/table_heap.h"
@@ -18,31 +20,45 @@
 namespace bustub {
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                     page_id_t first_page_id)
+                     page_id_t first_page_id, owner_id_t owner_id)
     : buffer_pool_manager_(buffer_pool_manager),
       lock_manager_(lock_manager),
       log_manager_(log_manager),
-      first_page_id_(first_page_id) {}
+      first_page_id_(first_page_id),
+      access_{nullptr, false, AccessCategory::TABLE, owner_id} {
+  if (access_.owner_ == NO_OWNER) {
+    access_.owner_ = buffer_pool_manager_->RegisterOwner("table:" + std::to_string(first_page_id_));
+  }
+}
 
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
-                     Transaction *txn)
-    : buffer_pool_manager_(buffer_pool_manager), lock_manager_(lock_manager), log_manager_(log_manager) {
+                     Transaction *txn, owner_id_t owner_id)
+    : buffer_pool_manager_(buffer_pool_manager),
+      lock_manager_(lock_manager),
+      log_manager_(log_manager),
+      access_{nullptr, false, AccessCategory::TABLE, owner_id} {
   // Initialize the first table page.
-  auto first_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(&first_page_id_));
+  auto first_page = reinterpret_cast<TablePage *>(buffer_pool_manager_->NewPage(&first_page_id_, access_));
   BUSTUB_ASSERT(first_page != nullptr, "Couldn't create a page for the table heap.");
   first_page->WLatch();
   first_page->Init(first_page_id_, PAGE_SIZE, INVALID_LSN, log_manager_, txn);
   first_page->WUnlatch();
+  // The table is named after its first page, so only the pages after that one can be allocated for it.
+  if (access_.owner_ == NO_OWNER) {
+    access_.owner_ = buffer_pool_manager_->RegisterOwner("table:" + std::to_string(first_page_id_));
+    buffer_pool_manager_->ChargePage(first_page_id_, access_.owner_);
+  }
   buffer_pool_manager_->UnpinPage(first_page_id_, true);
 }
 
-bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
+bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, BufferAccessStrategy *strategy) {
   if (tuple.size_ + 32 > PAGE_SIZE) {  // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
 
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
+  AccessContext context{strategy, false, AccessCategory::TABLE, access_.owner_};
+  auto cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_, context));
   if (cur_page == nullptr) {
     txn->SetState(TransactionState::ABORTED);
     return false;
@@ -59,11 +75,11 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
       cur_page->WUnlatch();
       buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), false);
       // And repeat the process with the next page.
-      cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(next_page_id));
+      cur_page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(next_page_id, context));
       cur_page->WLatch();
     } else {
       // Otherwise we have run out of valid pages. We need to create a new page.
-      auto new_page = static_cast<TablePage *>(buffer_pool_manager_->NewPage(&next_page_id));
+      auto new_page = static_cast<TablePage *>(buffer_pool_manager_->NewPage(&next_page_id, context));
       // If we could not create a new page,
       if (new_page == nullptr) {
         // Then life sucks and we abort the transaction.
@@ -93,7 +109,7 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   // TODO(Amadou): remove empty page
   // Find the page which contains the tuple.
-  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), access_));
   // If the page could not be found, then abort the transaction.
   if (page == nullptr) {
     txn->SetState(TransactionState::ABORTED);
@@ -111,7 +127,7 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) {
   // Find the page which contains the tuple.
-  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), access_));
   // If the page could not be found, then abort the transaction.
   if (page == nullptr) {
     txn->SetState(TransactionState::ABORTED);
@@ -132,7 +148,7 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
 
 void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
   // Find the page which contains the tuple.
-  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), access_));
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Delete the tuple from the page.
   page->WLatch();
@@ -144,7 +160,7 @@ void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
 
 void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   // Find the page which contains the tuple.
-  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), access_));
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Rollback the delete.
   page->WLatch();
@@ -155,7 +171,7 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
 
 bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   // Find the page which contains the tuple.
-  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId(), access_));
   // If the page could not be found, then abort the transaction.
   if (page == nullptr) {
     txn->SetState(TransactionState::ABORTED);
@@ -169,16 +185,32 @@ bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   return res;
 }
 
-TableIterator TableHeap::Begin(Transaction *txn) {
+TableIterator TableHeap::Begin(Transaction *txn, BufferAccessStrategy *strategy) {
   // Start an iterator from the first page.
-  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
+  AccessContext context{strategy, false, AccessCategory::TABLE_SCAN, access_.owner_};
+  auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_, context));
   page->RLatch();
   RID rid;
   // If this fails because there is no tuple, then RID will be the default-constructed value, which means EOF.
   page->GetFirstTupleRid(&rid);
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(first_page_id_, false);
-  return TableIterator(this, rid, txn);
+  return TableIterator(this, rid, txn, strategy);
+}
+
+size_t TableHeap::ReadAhead(page_id_t page_id, BufferAccessStrategy *strategy) {
+  // Don't read so far ahead that the pages are pushed out again before the scan gets to them.
+  auto num_pages = std::min<size_t>(READ_AHEAD_PAGES, buffer_pool_manager_->GetPoolSize() / 4);
+  if (strategy != nullptr) {
+    num_pages = std::min(num_pages, strategy->GetRingSize() / 2);
+  }
+  if (page_id == INVALID_PAGE_ID || num_pages == 0) {
+    return 0;
+  }
+  buffer_pool_manager_->PrefetchPageChain(
+      page_id, num_pages, [](Page *page) { return static_cast<TablePage *>(page)->GetNextPageId(); },
+      AccessContext{strategy, false, AccessCategory::TABLE_SCAN, access_.owner_});
+  return num_pages;
 }
 
 TableIterator TableHeap::End() { return TableIterator(this, RID(INVALID_PAGE_ID, 0), nullptr); }
@@ -16,8 +16,8 @@
 
 namespace bustub {
 
-TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
-    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
+TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn, BufferAccessStrategy *strategy)
+    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn), strategy_(strategy) {
   if (rid.GetPageId() != INVALID_PAGE_ID) {
     table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
   }
@@ -35,19 +35,38 @@ Tuple *TableIterator::operator->() {
 
 TableIterator &TableIterator::operator++() {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
-  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
-  cur_page->RLatch();
+  AccessContext context{strategy_, false, AccessCategory::TABLE_SCAN, table_heap_->access_.owner_};
+  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId(), context));
   assert(cur_page != nullptr);  // all pages are pinned
 
+  // Most steps stay on the same page. Without logging they take no locks on the tuples, so unless somebody is writing
+  // the page, they can read it without latching it.
+  uint64_t version;
   RID next_tuple_rid;
+  if (!enable_logging && cur_page->StartOptimisticRead(&version) &&
+      cur_page->CopyNextTuple(tuple_->rid_, &next_tuple_rid, tuple_) && cur_page->ValidateOptimisticRead(version)) {
+    tuple_->rid_ = next_tuple_rid;
+    buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
+    return *this;
+  }
+
+  cur_page->RLatch();
+
   if (!cur_page->GetNextTupleRid(tuple_->rid_,
                                  &next_tuple_rid)) {  // end of this page
     while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
+      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(cur_page->GetNextPageId(), context));
       cur_page->RUnlatch();
       buffer_pool_manager->UnpinPage(cur_page->GetTablePageId(), false);
       cur_page = next_page;
       cur_page->RLatch();
+      // Keep the pages after this one coming in while we work on it. Reading ahead again halfway through the last
+      // window keeps the disk busy without asking for the same pages over and over.
+      if (pages_until_read_ahead_ == 0) {
+        pages_until_read_ahead_ = table_heap_->ReadAhead(cur_page->GetNextPageId(), strategy_) / 2;
+      } else {
+        pages_until_read_ahead_--;
+      }
       if (cur_page->GetFirstTupleRid(&next_tuple_rid)) {
         break;
       }
@@ -55,8 +74,10 @@ TableIterator &TableIterator::operator++() {
   }
   tuple_->rid_ = next_tuple_rid;
 
+  // The tuple is read through the latch we hold. Going through the table heap would latch the page again, which waits
+  // behind any writer that queued up for the page meanwhile, while the writer waits for us.
   if (*this != table_heap_->End()) {
-    table_heap_->GetTuple(tuple_->rid_, tuple_, txn_);
+    cur_page->GetTuple(tuple_->rid_, tuple_, txn_, table_heap_->lock_manager_);
   }
   // release until copy the tuple
   cur_page->RUnlatch();
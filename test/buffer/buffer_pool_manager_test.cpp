@@ -11,8 +11,16 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/buffer_pool_manager.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
+#include <deque>
+#include <fstream>
+#include <random>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 #include "common/logger.h"
 #include "gtest/gtest.h"
 
@@ -77,6 +85,7 @@ TEST(BufferPoolManagerTest, BinaryDataTest) {
   // Shutdown the disk manager and remove the temporary file we created.
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.fsm");
 
   delete bpm;
   delete disk_manager;
@@ -141,9 +150,1531 @@ TEST(BufferPoolManagerTest, SampleTest) {
   // Shutdown the disk manager and remove the temporary file we created.
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.fsm");
 
   delete bpm;
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, ParallelSampleTest) {
+  const std::string db_name = "test.db";
+  const size_t num_instances = 5;
+  const size_t buffer_pool_size = 10;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+  EXPECT_EQ(num_instances, bpm->GetNumInstances());
+  EXPECT_EQ(buffer_pool_size, bpm->GetPoolSize());
+
+  // Scenario: every instance owns two frames, and consecutive page ids land in consecutive instances, so the whole
+  // pool can be filled with new pages.
+  page_id_t page_id_temp;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(static_cast<page_id_t>(i), page_id_temp);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id_temp);
+  }
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id_temp));
+
+  // Scenario: unpinning a page frees a frame in its own instance only, and NewPage finds it.
+  EXPECT_TRUE(bpm->UnpinPage(3, true));
+  auto *page = bpm->NewPage(&page_id_temp);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(3, page_id_temp % static_cast<page_id_t>(num_instances));
+  EXPECT_TRUE(bpm->UnpinPage(page_id_temp, false));
+
+  // Scenario: the evicted page was written back and can be read again.
+  page = bpm->FetchPage(3);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(0, strcmp(page->GetData(), "page 3"));
+
+  // Scenario: a resident page is a hit in its instance, a page that had to be read is a miss.
+  page = bpm->FetchPage(4);
+  ASSERT_NE(nullptr, page);
+  auto stats = bpm->GetInstanceStats(4);
+  EXPECT_EQ(1, stats.hits_);
+  EXPECT_EQ(0, stats.misses_);
+  stats = bpm->GetInstanceStats(3);
+  EXPECT_EQ(0, stats.hits_);
+  EXPECT_EQ(1, stats.misses_);
+  EXPECT_EQ(2, stats.evictions_);
+  EXPECT_EQ(1, stats.writebacks_);
+  EXPECT_EQ(1, bpm->GetStats().hits_);
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, ParallelConcurrencyTest) {
+  const std::string db_name = "test.db";
+  const size_t num_instances = 4;
+  const size_t buffer_pool_size = 16;
+  const int num_pages = 64;
+  const int num_threads = 8;
+  const int rounds = 200;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  page_id_t page_id_temp;
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    *reinterpret_cast<page_id_t *>(page->GetData()) = page_id_temp;
+    EXPECT_TRUE(bpm->UnpinPage(page_id_temp, true));
+  }
+
+  // Scenario: many threads fetch a working set that is larger than the pool. Every page they get must hold its own
+  // id, no matter which instance it went through or how often it was evicted in between.
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.emplace_back([bpm, tid]() {
+      for (int round = 0; round < rounds; ++round) {
+        page_id_t page_id = (tid * 7 + round) % num_pages;
+        auto *page = bpm->FetchPage(page_id);
+        if (page == nullptr) {
+          continue;
+        }
+        EXPECT_EQ(page_id, *reinterpret_cast<page_id_t *>(page->GetData()));
+        EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto stats = bpm->GetStats();
+  EXPECT_GT(stats.hits_ + stats.misses_, 0);
+  EXPECT_LE(stats.hits_ + stats.misses_, static_cast<uint64_t>(num_threads * rounds));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, ConcurrentDirtyEvictionTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+  const int pages_per_thread = 4;
+  const int num_threads = 4;
+  const int rounds = 100;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(buffer_pool_size, disk_manager);
+
+  std::vector<page_id_t> page_ids;
+  for (int i = 0; i < pages_per_thread * num_threads; ++i) {
+    page_id_t page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+    page_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+
+  // Scenario: every thread keeps bumping a counter on its own pages. The pool is half the size of the working set,
+  // so pages are constantly written back and read in again while other threads hit on resident pages. No update may
+  // be lost on the way to disk and back.
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.emplace_back([bpm, tid, &page_ids]() {
+      for (int round = 0; round < rounds; ++round) {
+        page_id_t page_id = page_ids[tid * pages_per_thread + round % pages_per_thread];
+        Page *page = nullptr;
+        while ((page = bpm->FetchPage(page_id)) == nullptr) {
+          std::this_thread::yield();
+        }
+        page->WLatch();
+        ++*reinterpret_cast<int *>(page->GetData());
+        page->WUnlatch();
+        EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (auto page_id : page_ids) {
+    auto *page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(rounds / pages_per_thread, *reinterpret_cast<int *>(page->GetData()));
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+  EXPECT_GT(bpm->GetStats().writebacks_, 0);
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, ConcurrentHitTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 64;
+  const size_t num_instances = 2;
+  const int num_hot_pages = 16;
+  const int num_cold_pages = 256;
+  const int num_threads = 4;
+  const int fetches_per_thread = 100000;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  std::vector<page_id_t> page_ids;
+  for (int i = 0; i < num_hot_pages + num_cold_pages; ++i) {
+    page_id_t page_id;
+    auto *page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id);
+    page_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+
+  // Scenario: readers hammer a small hot set while another thread streams through cold pages, so that frames keep
+  // changing hands right next to the hits. Every fetch must return the frame that holds the requested page.
+  std::atomic<bool> done{false};
+  std::thread scanner([bpm, &page_ids, &done]() {
+    while (!done) {
+      for (int i = num_hot_pages; i < num_hot_pages + num_cold_pages; ++i) {
+        auto *page = bpm->FetchPage(page_ids[i]);
+        if (page != nullptr) {
+          EXPECT_EQ("page " + std::to_string(page_ids[i]), page->GetData());
+          EXPECT_TRUE(bpm->UnpinPage(page_ids[i], false));
+        }
+      }
+    }
+  });
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.emplace_back([bpm, tid, &page_ids]() {
+      std::mt19937 generator(tid);
+      std::uniform_int_distribution<int> distribution(0, num_hot_pages - 1);
+      for (int i = 0; i < fetches_per_thread; ++i) {
+        auto page_id = page_ids[distribution(generator)];
+        auto *page = bpm->FetchPage(page_id);
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ(page_id, page->GetPageId());
+        EXPECT_EQ("page " + std::to_string(page_id), page->GetData());
+        EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  done = true;
+  scanner.join();
+
+  auto stats = bpm->GetStats();
+  LOG_INFO("%.0f fetches/s next to a scan, %lu hits, %lu misses, %lu evictions",
+           num_threads * fetches_per_thread / elapsed, stats.hits_, stats.misses_, stats.evictions_);
+  EXPECT_GT(stats.evictions_, 0);
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, ConcurrentUnpinTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 16;
+  const int num_pages = 8;
+  const int num_threads = 4;
+  const int rounds = 1000;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(buffer_pool_size, disk_manager);
+
+  std::vector<page_id_t> page_ids;
+  for (int i = 0; i < num_pages; ++i) {
+    page_id_t page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+    page_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+  // Scenario: a page that is not pinned cannot be unpinned.
+  EXPECT_FALSE(bpm->UnpinPage(page_ids[0], false));
+
+  // Scenario: all threads pin and unpin the same pages at the same time, and one of them writes to them. When they
+  // are done, no pin may be left behind and no dirty flag may be lost.
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; ++tid) {
+    threads.emplace_back([bpm, tid, &page_ids]() {
+      for (int round = 0; round < rounds; ++round) {
+        for (auto page_id : page_ids) {
+          auto *page = bpm->FetchPage(page_id);
+          ASSERT_NE(nullptr, page);
+          if (tid == 0) {
+            page->WLatch();
+            snprintf(page->GetData(), PAGE_SIZE, "round %d", round);
+            page->WUnlatch();
+          }
+        }
+        for (auto page_id : page_ids) {
+          EXPECT_TRUE(bpm->UnpinPage(page_id, tid == 0));
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto page_id : page_ids) {
+    auto *page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(1, page->GetPinCount());
+    EXPECT_TRUE(page->IsDirty());
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+
+  // Scenario: every frame can be reused, and the pages that were pushed out reached the disk.
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    page_id_t page_id;
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id));
+  }
+  std::vector<char> data(PAGE_SIZE);
+  for (auto page_id : page_ids) {
+    disk_manager->ReadPage(page_id, data.data());
+    EXPECT_EQ("round " + std::to_string(rounds - 1), data.data());
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, ResizeTest) {
+  const std::string db_name = "test.db";
+  const size_t num_instances = 2;
+  BufferPoolOptions options;
+  options.max_pool_size_ = 64;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, 16, disk_manager, nullptr, options);
+  EXPECT_EQ(16, bpm->GetPoolSize());
+  EXPECT_EQ(64, bpm->GetMaxPoolSize());
+
+  // Scenario: after growing, every frame up to the new size can hold a pinned page.
+  ASSERT_TRUE(bpm->Resize(64));
+  std::vector<page_id_t> page_ids;
+  for (int i = 0; i < 64; ++i) {
+    page_id_t page_id;
+    auto *page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id);
+    page_ids.push_back(page_id);
+  }
+  page_id_t page_id;
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id));
+
+  // Scenario: a shrink waits for pinned pages to be unpinned, and gives up if that takes too long.
+  EXPECT_FALSE(bpm->Resize(8, std::chrono::milliseconds(10)));
+  EXPECT_EQ(64, bpm->GetPoolSize());
+  std::thread unpinner([bpm, &page_ids]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (auto page_id : page_ids) {
+      EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+    }
+  });
+  EXPECT_TRUE(bpm->Resize(8));
+  unpinner.join();
+  EXPECT_EQ(8, bpm->GetPoolSize());
+
+  // Scenario: the evicted pages were written back, and only the remaining frames can be pinned.
+  for (auto page_id : page_ids) {
+    auto *page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ("page " + std::to_string(page_id), page->GetData());
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+  for (size_t i = 0; i < 8; ++i) {
+    EXPECT_NE(nullptr, bpm->FetchPage(page_ids[i]));
+  }
+  EXPECT_EQ(nullptr, bpm->FetchPage(page_ids[8]));
+  for (size_t i = 0; i < 8; ++i) {
+    EXPECT_TRUE(bpm->UnpinPage(page_ids[i], false));
+  }
+
+  // Scenario: the pool keeps changing size under a running workload.
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < 4; ++tid) {
+    threads.emplace_back([bpm, tid, &page_ids, &done]() {
+      std::mt19937 generator(tid);
+      std::uniform_int_distribution<size_t> distribution(0, page_ids.size() - 1);
+      while (!done) {
+        auto page_id = page_ids[distribution(generator)];
+        auto *page = bpm->FetchPage(page_id);
+        if (page != nullptr) {
+          EXPECT_EQ("page " + std::to_string(page_id), page->GetData());
+          EXPECT_TRUE(bpm->UnpinPage(page_id, tid % 2 == 0));
+        }
+      }
+    });
+  }
+  for (int round = 0; round < 20; ++round) {
+    EXPECT_TRUE(bpm->Resize(round % 2 == 0 ? 64 : 8));
+  }
+  done = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(8, bpm->GetPoolSize());
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, AccessStrategyTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 64;
+  const size_t num_instances = 2;
+  const int num_hot_pages = 32;
+  const int num_bulk_pages = 256;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  std::vector<page_id_t> hot_pages;
+  for (int i = 0; i < num_hot_pages; ++i) {
+    page_id_t page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+    hot_pages.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  auto hot_page_hits = [bpm, &hot_pages]() {
+    auto before = bpm->GetStats().hits_;
+    for (auto page_id : hot_pages) {
+      EXPECT_NE(nullptr, bpm->FetchPage(page_id));
+      EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+    }
+    return bpm->GetStats().hits_ - before;
+  };
+
+  // Scenario: a bulk load creates many more pages than fit in the pool. They all go through a ring of 8 frames and
+  // are written out as the ring wraps around, so the hot pages stay resident.
+  BufferAccessStrategy bulk_write(8);
+  std::vector<page_id_t> bulk_pages;
+  for (int i = 0; i < num_bulk_pages; ++i) {
+    page_id_t page_id;
+    auto *page = bpm->NewPage(&page_id, AccessContext{&bulk_write});
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id);
+    bulk_pages.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  EXPECT_EQ(num_hot_pages, hot_page_hits());
+
+  // Scenario: a scan pins the next page before it lets go of the current one, like TableIterator does. It reads
+  // everything back correctly and again leaves the hot pages alone.
+  BufferAccessStrategy bulk_read(8);
+  page_id_t prev_page_id = INVALID_PAGE_ID;
+  for (auto page_id : bulk_pages) {
+    auto *page = bpm->FetchPage(page_id, AccessContext{&bulk_read});
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(std::to_string(page_id), page->GetData());
+    if (prev_page_id != INVALID_PAGE_ID) {
+      EXPECT_TRUE(bpm->UnpinPage(prev_page_id, false));
+    }
+    prev_page_id = page_id;
+  }
+  EXPECT_TRUE(bpm->UnpinPage(prev_page_id, false));
+  EXPECT_EQ(num_hot_pages, hot_page_hits());
+
+  // Scenario: the same scan without a strategy cycles every page through the whole pool and pushes the hot pages out.
+  for (auto page_id : bulk_pages) {
+    ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+  EXPECT_GT(num_hot_pages, hot_page_hits());
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, PrefetchTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 64;
+  const size_t num_instances = 2;
+  const int num_pages = 48;
+  const int chain_length = 32;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Link the pages into a chain: every page starts with the id of the next one.
+  std::vector<page_id_t> page_ids;
+  std::vector<Page *> pages;
+  for (int i = 0; i < num_pages; ++i) {
+    page_id_t page_id;
+    pages.push_back(bpm->NewPage(&page_id));
+    ASSERT_NE(nullptr, pages.back());
+    page_ids.push_back(page_id);
+  }
+  for (int i = 0; i < num_pages; ++i) {
+    *reinterpret_cast<page_id_t *>(pages[i]->GetData()) = i + 1 < num_pages ? page_ids[i + 1] : INVALID_PAGE_ID;
+    EXPECT_TRUE(bpm->UnpinPage(page_ids[i], true));
+  }
+  bpm->FlushAllPages();
+  delete bpm;
+
+  // Scenario: on a cold buffer pool, read the first part of the chain and a few separate pages ahead of their use.
+  bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+  bpm->PrefetchPageChain(page_ids[0], chain_length,
+                         [](Page *page) { return *reinterpret_cast<page_id_t *>(page->GetData()); });
+  bpm->PrefetchPages(std::vector<page_id_t>(page_ids.begin() + 40, page_ids.end()));
+  const size_t num_prefetched = chain_length + 8;
+  for (int i = 0; i < 5000 && bpm->GetStats().prefetches_ < num_prefetched; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(num_prefetched, bpm->GetStats().prefetches_);
+
+  // Scenario: only the pages that were not read ahead have to come from disk now.
+  for (int i = 0; i < num_pages; ++i) {
+    auto *page = bpm->FetchPage(page_ids[i]);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(i + 1 < num_pages ? page_ids[i + 1] : INVALID_PAGE_ID, *reinterpret_cast<page_id_t *>(page->GetData()));
+    EXPECT_TRUE(bpm->UnpinPage(page_ids[i], false));
+  }
+  auto stats = bpm->GetStats();
+  EXPECT_EQ(num_prefetched, stats.hits_);
+  EXPECT_EQ(num_pages - num_prefetched, stats.misses_);
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+namespace {
+
+/**
+ * Keeps updating random pages of a working set eight times the size of the buffer pool, so that almost every miss
+ * has to evict a dirty page.
+ * @param enable_page_cleaner whether to run the page cleaner
+ * @param[out] stats the counters of the buffer pool at the end
+ * @return the 99th percentile of the FetchPage latency, in microseconds
+ */
+double WriteHeavyFetchLatencyP99(bool enable_page_cleaner, BufferPoolStats *stats) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 64;
+  const int num_pages = 512;
+  const int num_fetches = 20000;
+
+  auto *disk_manager = new DiskManager(db_name);
+  BufferPoolOptions options;
+  options.enable_page_cleaner_ = enable_page_cleaner;
+  options.page_cleaner_interval_ = std::chrono::milliseconds(1);
+  auto *bpm = new BufferPoolManager(1, buffer_pool_size, disk_manager, nullptr, options);
+
+  std::vector<page_id_t> page_ids;
+  for (int i = 0; i < num_pages; ++i) {
+    page_id_t page_id;
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id));
+    page_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+
+  std::mt19937 generator(15445);
+  std::uniform_int_distribution<int> page_distribution(0, num_pages - 1);
+  std::vector<double> latencies;
+  latencies.reserve(num_fetches);
+  for (int i = 0; i < num_fetches; ++i) {
+    auto page_id = page_ids[page_distribution(generator)];
+    auto start = std::chrono::steady_clock::now();
+    auto *page = bpm->FetchPage(page_id);
+    latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    EXPECT_NE(nullptr, page);
+    // Rewrite the whole page, so that there is some work between two fetches.
+    memset(page->GetData(), i, PAGE_SIZE);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  *stats = bpm->GetStats();
+
+  disk_manager->ShutDown();
+  remove(db_name.c_str());
+  remove("test.fsm");
+  delete bpm;
+  delete disk_manager;
+
+  std::nth_element(latencies.begin(), latencies.begin() + num_fetches * 99 / 100, latencies.end());
+  return latencies[num_fetches * 99 / 100];
+}
+
+/**
+ * Runs a skewed workload against the buffer pool: most fetches go to a hot set of pages, the rest anywhere.
+ * @return the number of fetches until the hit ratio over the last 100 fetches reached the given ratio
+ */
+size_t FetchesUntilHitRatio(BufferPoolManager *bpm, const std::vector<page_id_t> &page_ids, size_t num_hot_pages,
+                            double hit_ratio, size_t max_fetches) {
+  std::mt19937 generator(15445);
+  std::uniform_int_distribution<size_t> hot_distribution(0, num_hot_pages - 1);
+  std::uniform_int_distribution<size_t> any_distribution(0, page_ids.size() - 1);
+  std::uniform_real_distribution<double> coin(0, 1);
+  const size_t window = 100;
+  std::deque<bool> hits;
+  size_t num_hits = 0;
+  for (size_t fetches = 1; fetches <= max_fetches; fetches++) {
+    auto page_id = page_ids[coin(generator) < 0.9 ? hot_distribution(generator) : any_distribution(generator)];
+    auto hits_before = bpm->GetStats().hits_;
+    auto *page = bpm->FetchPage(page_id);
+    EXPECT_NE(nullptr, page);
+    EXPECT_EQ("page " + std::to_string(page_id), page->GetData());
+    bpm->UnpinPage(page_id, false);
+    hits.push_back(bpm->GetStats().hits_ > hits_before);
+    num_hits += hits.back() ? 1 : 0;
+    if (hits.size() > window) {
+      num_hits -= hits.front() ? 1 : 0;
+      hits.pop_front();
+    }
+    if (hits.size() == window && num_hits >= hit_ratio * window) {
+      return fetches;
+    }
+  }
+  return max_fetches;
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, PageCleanerTest) {
+  BufferPoolStats stats_without_cleaner;
+  BufferPoolStats stats_with_cleaner;
+  auto p99_without_cleaner = WriteHeavyFetchLatencyP99(false, &stats_without_cleaner);
+  auto p99_with_cleaner = WriteHeavyFetchLatencyP99(true, &stats_with_cleaner);
+  LOG_INFO("p99 FetchPage latency %.1f us without the page cleaner, %.1f us with it", p99_without_cleaner,
+           p99_with_cleaner);
+  LOG_INFO("Writebacks on the fetch path: %lu without the page cleaner, %lu with it", stats_without_cleaner.writebacks_,
+           stats_with_cleaner.writebacks_ - stats_with_cleaner.cleaner_writebacks_);
+
+  // Scenario: the page cleaner does write pages back, and fetches have fewer dirty victims to write themselves.
+  EXPECT_EQ(0, stats_without_cleaner.cleaner_writebacks_);
+  EXPECT_GT(stats_with_cleaner.cleaner_writebacks_, 0);
+  EXPECT_LT(stats_with_cleaner.writebacks_ - stats_with_cleaner.cleaner_writebacks_, stats_without_cleaner.writebacks_);
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, FlushAllPagesTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 2048;
+  const size_t num_instances = 4;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Scenario: fill the pool with dirty pages, leaving some of them clean and some of them pinned.
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    page_id_t page_id;
+    auto *page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id);
+    page_ids.push_back(page_id);
+  }
+  for (auto page_id : page_ids) {
+    if (page_id % 100 == 0) {
+      // Keep the page pinned, but dirty.
+      EXPECT_NE(nullptr, bpm->FetchPage(page_id));
+      EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+    } else {
+      EXPECT_TRUE(bpm->UnpinPage(page_id, page_id % 10 != 0));
+    }
+  }
+  auto start = std::chrono::steady_clock::now();
+  bpm->FlushAllPages();
+  auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  LOG_INFO("Flushed %lu dirty pages in %.1f ms", bpm->GetStats().writebacks_, elapsed);
+
+  // Scenario: every page reached the disk, and the pages are still resident and pinned as before.
+  std::vector<char> data(PAGE_SIZE);
+  for (auto page_id : page_ids) {
+    if (page_id % 10 == 0 && page_id % 100 != 0) {
+      continue;
+    }
+    disk_manager->ReadPage(page_id, data.data());
+    EXPECT_EQ("page " + std::to_string(page_id), data.data());
+  }
+  EXPECT_EQ(0, bpm->GetStats().misses_);
+  for (auto page_id : page_ids) {
+    if (page_id % 100 == 0) {
+      EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+    }
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, WarmStartTest) {
+  const std::string db_name = "test.db";
+  const std::string warm_start_file = "test.warm";
+  const size_t buffer_pool_size = 128;
+  const size_t num_instances = 2;
+  const size_t num_hot_pages = 96;
+  const size_t num_pages = 1024;
+  const double steady_hit_ratio = 0.85;
+  BufferPoolOptions options;
+  options.warm_start_file_ = warm_start_file;
+  remove(warm_start_file.c_str());
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager, nullptr, options);
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < num_pages; ++i) {
+    page_id_t page_id;
+    auto *page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id);
+    page_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  // Scatter the hot set over the file.
+  std::shuffle(page_ids.begin(), page_ids.end(), std::mt19937(15445));
+  FetchesUntilHitRatio(bpm, page_ids, num_hot_pages, 1.0, 5000);
+  bpm->FlushAllPages();
+  // Scenario: a clean shutdown remembers the hot pages.
+  delete bpm;
+
+  // Scenario: after a restart without the warm start file, the hot pages come back one miss at a time.
+  bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+  auto start = std::chrono::steady_clock::now();
+  auto cold_fetches = FetchesUntilHitRatio(bpm, page_ids, num_hot_pages, steady_hit_ratio, 10000);
+  auto cold_elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  auto cold_misses = bpm->GetStats().misses_;
+  delete bpm;
+
+  // Scenario: with the warm start file, they are read back in batches before the first request.
+  start = std::chrono::steady_clock::now();
+  bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+  auto num_loaded = bpm->LoadResidentPages(warm_start_file);
+  auto warm_fetches = FetchesUntilHitRatio(bpm, page_ids, num_hot_pages, steady_hit_ratio, 10000);
+  auto warm_elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  auto warm_misses = bpm->GetStats().misses_;
+  delete bpm;
+  LOG_INFO("Steady state after %zu fetches (%.2f ms, %lu misses) cold, %zu fetches (%.2f ms, %lu misses) warm",
+           cold_fetches, cold_elapsed, cold_misses, warm_fetches, warm_elapsed, warm_misses);
+  EXPECT_EQ(buffer_pool_size, num_loaded);
+  EXPECT_LT(warm_fetches, cold_fetches);
+  EXPECT_LT(warm_misses, cold_misses / 2);
+
+  // Scenario: a buffer pool created with the warm start file loads it in the background while it serves requests.
+  bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager, nullptr, options);
+  FetchesUntilHitRatio(bpm, page_ids, num_hot_pages, steady_hit_ratio, 10000);
+  delete bpm;
+
+  // Scenario: a damaged warm start file, whose page count is far beyond its size, loads nothing.
+  {
+    std::fstream file(warm_start_file, std::ios::binary | std::ios::in | std::ios::out);
+    uint32_t num_saved = UINT32_MAX;
+    file.seekp(sizeof(uint32_t));
+    file.write(reinterpret_cast<const char *>(&num_saved), sizeof(num_saved));
+    ASSERT_TRUE(file.good());
+  }
+  bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager, nullptr, options);
+  EXPECT_EQ(0, bpm->LoadResidentPages(warm_start_file));
+  delete bpm;
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  remove(warm_start_file.c_str());
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, MetricsTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+  const size_t num_instances = 2;
+  const int num_threads = 4;
+  const int num_waves = 2;
+  const int rounds = 100;
+
+  // Time every call, so that the histograms can be checked exactly.
+  BufferPoolOptions options;
+  options.latency_sample_interval_ = 1;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager, nullptr, options);
+  const AccessContext index_access{nullptr, false, AccessCategory::INDEX};
+  const AccessContext table_access{nullptr, false, AccessCategory::TABLE};
+
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < 2 * buffer_pool_size; ++i) {
+    page_id_t page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id, table_access));
+    page_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  auto stats = bpm->GetStats();
+  EXPECT_EQ(2 * buffer_pool_size, stats.new_page_latency_.count_);
+  EXPECT_EQ(buffer_pool_size, stats.evictions_);
+  EXPECT_EQ(buffer_pool_size, stats.writebacks_);
+
+  // Scenario: the counters of every thread add up, whether the thread is still around or not. The second wave of
+  // threads takes over the counters of the first.
+  for (int wave = 0; wave < num_waves; ++wave) {
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; ++tid) {
+      threads.emplace_back([bpm, &page_ids, &index_access]() {
+        for (int round = 0; round < rounds; ++round) {
+          auto page_id = page_ids.back();
+          ASSERT_NE(nullptr, bpm->FetchPage(page_id, index_access));
+          EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+  // Scenario: a page that was evicted is a miss of the category that fetched it.
+  ASSERT_NE(nullptr, bpm->FetchPage(page_ids.front(), table_access));
+  EXPECT_TRUE(bpm->UnpinPage(page_ids.front(), false));
+
+  stats = bpm->GetStats();
+  auto index = static_cast<size_t>(AccessCategory::INDEX);
+  auto table = static_cast<size_t>(AccessCategory::TABLE);
+  EXPECT_EQ(num_waves * num_threads * rounds, stats.category_hits_[index]);
+  EXPECT_EQ(0, stats.category_misses_[index]);
+  EXPECT_EQ(0, stats.category_hits_[table]);
+  EXPECT_EQ(1, stats.category_misses_[table]);
+  EXPECT_EQ(num_waves * num_threads * rounds, stats.hits_);
+  EXPECT_EQ(1, stats.misses_);
+  EXPECT_EQ(num_waves * num_threads * rounds + 1, stats.fetch_latency_.count_);
+  EXPECT_GT(stats.fetch_latency_.Quantile(0.99), 0);
+  EXPECT_LE(stats.fetch_latency_.Quantile(0.5), stats.fetch_latency_.Quantile(0.99));
+  auto instance_stats = bpm->GetInstanceStats(0);
+  instance_stats += bpm->GetInstanceStats(1);
+  EXPECT_EQ(stats.hits_, instance_stats.hits_);
+  EXPECT_EQ(stats.evictions_, instance_stats.evictions_);
+
+  // Scenario: the dump has one sample per line, ready to be scraped.
+  auto dump = bpm->DumpMetrics();
+  EXPECT_NE(std::string::npos, dump.find("bustub_buffer_pool_hits_total{category=\"index\"} " +
+                                         std::to_string(num_waves * num_threads * rounds)));
+  EXPECT_NE(std::string::npos, dump.find("bustub_buffer_pool_misses_total{category=\"table\"} 1\n"));
+  EXPECT_NE(std::string::npos, dump.find("bustub_buffer_pool_evictions_total " + std::to_string(stats.evictions_)));
+  EXPECT_NE(std::string::npos, dump.find("bustub_buffer_pool_fetch_latency_nanoseconds_bucket{le=\"+Inf\"} " +
+                                         std::to_string(num_waves * num_threads * rounds + 1)));
+  EXPECT_NE(std::string::npos, dump.find("bustub_buffer_pool_size 8\n"));
+
+  // Scenario: latencies land in power of two buckets.
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, LatencyHistogram::BucketOf(0));
+  EXPECT_EQ(1, LatencyHistogram::BucketOf(1));
+  EXPECT_EQ(11, LatencyHistogram::BucketOf(1024));
+  EXPECT_EQ(LatencyHistogram::NUM_BUCKETS - 1, LatencyHistogram::BucketOf(UINT64_MAX));
+  for (uint64_t ns : {100, 100, 100, 5000}) {
+    histogram.buckets_[LatencyHistogram::BucketOf(ns)]++;
+    histogram.count_++;
+  }
+  EXPECT_EQ(128, histogram.Quantile(0.5));
+  EXPECT_EQ(8192, histogram.Quantile(0.99));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, FetchPagesTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+  const size_t num_instances = 2;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < 3 * buffer_pool_size; ++i) {
+    page_id_t page_id;
+    auto page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id);
+    page_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  bpm->FlushAllPages();
+  auto stats = bpm->GetStats();
+
+  // Scenario: a batch of resident and evicted pages, with a duplicate and an invalid id, comes back in order.
+  std::vector<page_id_t> batch = {page_ids[0], page_ids.back(), INVALID_PAGE_ID, page_ids[1], page_ids[0]};
+  auto pages = bpm->FetchPages(batch);
+  ASSERT_EQ(batch.size(), pages.size());
+  EXPECT_EQ(nullptr, pages[2]);
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (batch[i] == INVALID_PAGE_ID) {
+      continue;
+    }
+    ASSERT_NE(nullptr, pages[i]);
+    EXPECT_EQ(batch[i], pages[i]->GetPageId());
+    EXPECT_EQ(0, strcmp(pages[i]->GetData(), ("page " + std::to_string(batch[i])).c_str()));
+  }
+  EXPECT_EQ(pages[0], pages[4]);
+  // The last page was resident, the first two were not, and the duplicate is a hit.
+  auto after = bpm->GetStats();
+  EXPECT_EQ(stats.misses_ + 2, after.misses_);
+  EXPECT_EQ(stats.hits_ + 2, after.hits_);
+  // Every occurrence pins the page once.
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (batch[i] != INVALID_PAGE_ID) {
+      EXPECT_TRUE(bpm->UnpinPage(batch[i], false));
+    }
+  }
+  EXPECT_FALSE(bpm->UnpinPage(page_ids[0], false));
+
+  // Scenario: a batch larger than the pool fetches as many pages as there are frames, and no more.
+  pages = bpm->FetchPages(page_ids);
+  size_t fetched = 0;
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    if (pages[i] != nullptr) {
+      EXPECT_EQ(page_ids[i], pages[i]->GetPageId());
+      EXPECT_EQ(0, strcmp(pages[i]->GetData(), ("page " + std::to_string(page_ids[i])).c_str()));
+      fetched++;
+    }
+  }
+  EXPECT_EQ(buffer_pool_size, fetched);
+  page_id_t page_id;
+  EXPECT_EQ(nullptr, bpm->NewPage(&page_id));
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    if (pages[i] != nullptr) {
+      EXPECT_TRUE(bpm->UnpinPage(page_ids[i], false));
+    }
+  }
+  EXPECT_NE(nullptr, bpm->NewPage(&page_id));
+  EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, OwnerTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+  const size_t num_instances = 2;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+
+  // Scenario: owners are registered once by name.
+  auto table_a = bpm->RegisterOwner("table:a");
+  auto table_b = bpm->RegisterOwner("table:b");
+  EXPECT_NE(NO_OWNER, table_a);
+  EXPECT_NE(table_a, table_b);
+  EXPECT_EQ(table_a, bpm->RegisterOwner("table:a"));
+  const AccessContext access_a{nullptr, false, AccessCategory::TABLE, table_a};
+  const AccessContext access_b{nullptr, false, AccessCategory::TABLE, table_b};
+
+  // Scenario: the pages of A fill the whole pool and are charged to A.
+  std::vector<page_id_t> pages_a;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    page_id_t page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id, access_a));
+    pages_a.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+  auto stats = bpm->GetOwnerStats();
+  ASSERT_EQ(3, stats.size());
+  EXPECT_EQ("none", stats[NO_OWNER].name_);
+  EXPECT_EQ("table:a", stats[table_a].name_);
+  EXPECT_EQ(buffer_pool_size, stats[table_a].resident_frames_);
+  EXPECT_EQ(0, stats[table_b].resident_frames_);
+
+  // Scenario: B may hold a fifth of the pool, one frame per instance. Once it holds its share, it replaces its own
+  // pages instead of those of A.
+  bpm->SetOwnerQuota(table_b, 0.2);
+  std::vector<page_id_t> pages_b;
+  for (size_t i = 0; i < buffer_pool_size; ++i) {
+    page_id_t page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id, access_b));
+    pages_b.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  stats = bpm->GetOwnerStats();
+  EXPECT_EQ(0.2, stats[table_b].quota_);
+  EXPECT_EQ(buffer_pool_size - 2, stats[table_a].resident_frames_);
+  EXPECT_EQ(2, stats[table_b].resident_frames_);
+  EXPECT_EQ(2, stats[table_a].evictions_);
+  EXPECT_EQ(buffer_pool_size - 2, stats[table_b].evictions_);
+  EXPECT_EQ(buffer_pool_size - 2, stats[table_b].quota_evictions_);
+  EXPECT_EQ(0, stats[table_a].quota_evictions_);
+
+  // Scenario: hits and misses are charged to the owner of the access. B reads its pages back without pushing out any
+  // more of A, so every read replaces the page B read before it and misses. A has no quota, and takes the frames of B
+  // back for the pages it lost, though which of its pages it loses on the way is up to the replacer.
+  for (auto page_id : pages_b) {
+    ASSERT_NE(nullptr, bpm->FetchPage(page_id, access_b));
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+  stats = bpm->GetOwnerStats();
+  EXPECT_EQ(buffer_pool_size, stats[table_b].misses_);
+  EXPECT_EQ(0, stats[table_b].hits_);
+  EXPECT_EQ(2 * buffer_pool_size - 2, stats[table_b].quota_evictions_);
+  EXPECT_EQ(2, stats[table_b].resident_frames_);
+  EXPECT_EQ(buffer_pool_size - 2, stats[table_a].resident_frames_);
+  for (auto page_id : pages_a) {
+    ASSERT_NE(nullptr, bpm->FetchPage(page_id, access_a));
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+  stats = bpm->GetOwnerStats();
+  EXPECT_EQ(buffer_pool_size, stats[table_a].hits_ + stats[table_a].misses_);
+  EXPECT_LE(2, stats[table_a].misses_);
+  EXPECT_EQ(buffer_pool_size, stats[table_a].resident_frames_ + stats[table_b].resident_frames_);
+
+  // Scenario: an owner whose pages are all in use goes over its quota rather than failing.
+  std::vector<page_id_t> pinned;
+  for (size_t i = 0; i < 4; ++i) {
+    page_id_t page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id, access_b));
+    pinned.push_back(page_id);
+  }
+  stats = bpm->GetOwnerStats();
+  EXPECT_EQ(4, stats[table_b].resident_frames_);
+  for (auto page_id : pinned) {
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+
+  // Scenario: deleted pages are taken off their owner's account.
+  EXPECT_TRUE(bpm->DeletePage(pinned.back()));
+  stats = bpm->GetOwnerStats();
+  EXPECT_EQ(3, stats[table_b].resident_frames_);
+  size_t resident = 0;
+  for (const auto &owner : stats) {
+    resident += owner.resident_frames_;
+  }
+  EXPECT_EQ(buffer_pool_size - 1, resident);
+
+  // Scenario: the dump labels the counters with the owners' names.
+  auto dump = bpm->DumpMetrics();
+  EXPECT_NE(std::string::npos, dump.find("bustub_buffer_pool_owner_resident_frames{owner=\"table:b\"} 3\n"));
+  EXPECT_NE(std::string::npos, dump.find("bustub_buffer_pool_owner_quota_evictions_total{owner=\"table:b\"} " +
+                                         std::to_string(stats[table_b].quota_evictions_) + "\n"));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, CompressedCacheTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 8;
+  const size_t num_instances = 2;
+  const size_t num_pages = 4 * buffer_pool_size;
+
+  BufferPoolOptions options;
+  options.compressed_cache_size_ = 64 * 1024;
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager, nullptr, options);
+  auto expected = [](page_id_t page_id) { return "page " + std::to_string(page_id); };
+
+  // Scenario: the pages pushed out by new pages go to the cache, written back first, and take little room there.
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < num_pages; ++i) {
+    page_id_t page_id;
+    auto page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%s", expected(page_id).c_str());
+    page_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  auto cache_stats = bpm->GetCompressedCacheStats();
+  EXPECT_EQ(num_pages - buffer_pool_size, cache_stats.insertions_);
+  EXPECT_EQ(num_pages - buffer_pool_size, cache_stats.num_pages_);
+  EXPECT_EQ(num_pages - buffer_pool_size, disk_manager->GetNumWrites());
+  EXPECT_LT(10, cache_stats.CompressionRatio());
+  EXPECT_GE(options.compressed_cache_size_, cache_stats.used_bytes_);
+
+  // Scenario: every miss of a scan is served from the cache, and what the scan pushes out goes there in turn.
+  auto stats = bpm->GetStats();
+  for (auto page_id : page_ids) {
+    auto page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(expected(page_id), page->GetData());
+    EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  }
+  cache_stats = bpm->GetCompressedCacheStats();
+  EXPECT_EQ(bpm->GetStats().misses_ - stats.misses_, cache_stats.hits_);
+  EXPECT_EQ(0, cache_stats.misses_);
+  EXPECT_LT(0, cache_stats.hits_);
+  EXPECT_EQ(num_pages - buffer_pool_size, cache_stats.num_pages_);
+
+  // Scenario: batches are served from the cache too, together with pages that are resident.
+  std::vector<page_id_t> batch(page_ids.begin(), page_ids.begin() + buffer_pool_size / 2);
+  batch.push_back(page_ids.back());
+  auto pages = bpm->FetchPages(batch);
+  for (size_t i = 0; i < batch.size(); ++i) {
+    ASSERT_NE(nullptr, pages[i]);
+    EXPECT_EQ(expected(batch[i]), pages[i]->GetData());
+    EXPECT_TRUE(bpm->UnpinPage(batch[i], false));
+  }
+  EXPECT_EQ(cache_stats.hits_ + buffer_pool_size / 2, bpm->GetCompressedCacheStats().hits_);
+
+  // Scenario: a page that is changed after coming back from the cache is not served stale later.
+  auto page = bpm->FetchPage(page_ids[0]);
+  ASSERT_NE(nullptr, page);
+  snprintf(page->GetData(), PAGE_SIZE, "changed");
+  EXPECT_TRUE(bpm->UnpinPage(page_ids[0], true));
+  for (size_t i = 1; i < num_pages; ++i) {
+    ASSERT_NE(nullptr, bpm->FetchPage(page_ids[i]));
+    EXPECT_TRUE(bpm->UnpinPage(page_ids[i], false));
+  }
+  page = bpm->FetchPage(page_ids[0]);
+  ASSERT_NE(nullptr, page);
+  EXPECT_STREQ("changed", page->GetData());
+  EXPECT_TRUE(bpm->UnpinPage(page_ids[0], false));
+
+  // Scenario: a deleted page leaves the cache.
+  auto num_cached = bpm->GetCompressedCacheStats().num_pages_;
+  EXPECT_TRUE(bpm->DeletePage(page_ids[1]));
+  EXPECT_EQ(num_cached - 1, bpm->GetCompressedCacheStats().num_pages_);
+
+  // Scenario: pages that do not compress are kept as they are, and push older pages out of the full cache.
+  std::mt19937 generator(15445);
+  std::vector<std::string> random_data;
+  std::vector<page_id_t> random_ids;
+  for (size_t i = 0; i < num_pages; ++i) {
+    page_id_t page_id;
+    page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    std::string data(PAGE_SIZE, '\0');
+    for (auto &byte : data) {
+      byte = static_cast<char>(generator());
+    }
+    memcpy(page->GetData(), data.data(), PAGE_SIZE);
+    random_data.push_back(data);
+    random_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  cache_stats = bpm->GetCompressedCacheStats();
+  EXPECT_LT(0, cache_stats.evictions_);
+  EXPECT_GE(options.compressed_cache_size_, cache_stats.used_bytes_);
+  for (size_t i = 0; i < num_pages; ++i) {
+    page = bpm->FetchPage(random_ids[i]);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(0, memcmp(random_data[i].data(), page->GetData(), PAGE_SIZE));
+    EXPECT_TRUE(bpm->UnpinPage(random_ids[i], false));
+  }
+  EXPECT_LT(0, bpm->GetCompressedCacheStats().misses_);
+
+  // Scenario: the dump includes the counters of the cache.
+  auto dump = bpm->DumpMetrics();
+  EXPECT_NE(std::string::npos, dump.find("bustub_compressed_cache_hits_total " +
+                                         std::to_string(bpm->GetCompressedCacheStats().hits_) + "\n"));
+
+  // Scenario: threads that keep changing their own pages never get a stale copy back from the cache, though each
+  // one's pages are evicted and brought back by the others all the time.
+  const size_t num_threads = 4;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 thread_generator(t);
+      std::vector<int> versions(buffer_pool_size, 0);
+      for (int round = 0; round < 500; ++round) {
+        auto i = thread_generator() % buffer_pool_size;
+        auto page_id = page_ids[t * buffer_pool_size + i];
+        if (page_id == page_ids[1]) {
+          continue;
+        }
+        auto page = bpm->FetchPage(page_id);
+        if (page == nullptr) {
+          continue;
+        }
+        if (versions[i] > 0) {
+          EXPECT_EQ(std::to_string(versions[i]), page->GetData());
+        }
+        snprintf(page->GetData(), PAGE_SIZE, "%d", ++versions[i]);
+        EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, SwizzleTest) {
+  const size_t buffer_pool_size = 4;
+  const size_t num_instances = 2;
+
+  BufferPoolOptions options;
+  options.enable_pointer_swizzling_ = true;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager, nullptr, options);
+  std::vector<page_id_t> page_ids;
+  for (size_t i = 0; i < 2 * buffer_pool_size; ++i) {
+    page_id_t page_id;
+    auto page = bpm->NewPage(&page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "%d", page_id);
+    page_ids.push_back(page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+
+  // Scenario: the first fetch through a reference swizzles it, and later fetches find the page through it, as hits.
+  SwizzledPageRef ref;
+  auto page_id = page_ids[0];
+  auto page = bpm->FetchPage(page_id, &ref);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(page, ref.frame_.load());
+  EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+  auto stats = bpm->GetStats();
+  EXPECT_EQ(page, bpm->FetchPage(page_id, &ref));
+  EXPECT_EQ(std::to_string(page_id), page->GetData());
+  EXPECT_EQ(stats.hits_ + 1, bpm->GetStats().hits_);
+  EXPECT_EQ(stats.misses_, bpm->GetStats().misses_);
+  EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+
+  // Scenario: once the page is evicted, the reference leads to a frame that holds another page or none, which is
+  // noticed, and the page is fetched again and the reference swizzled anew.
+  for (auto other_page_id : page_ids) {
+    if (other_page_id != page_id) {
+      ASSERT_NE(nullptr, bpm->FetchPage(other_page_id));
+      EXPECT_TRUE(bpm->UnpinPage(other_page_id, false));
+    }
+  }
+  EXPECT_NE(page_id, ref.frame_.load()->GetPageId());
+  stats = bpm->GetStats();
+  page = bpm->FetchPage(page_id, &ref);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(page_id, page->GetPageId());
+  EXPECT_EQ(std::to_string(page_id), page->GetData());
+  EXPECT_EQ(page, ref.frame_.load());
+  EXPECT_EQ(stats.misses_ + 1, bpm->GetStats().misses_);
+  EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+
+  // Scenario: a deleted page is not found through its reference either.
+  EXPECT_TRUE(bpm->DeletePage(page_id));
+  EXPECT_NE(page_id, ref.frame_.load()->GetPageId());
+  delete bpm;
+
+  // Scenario: without swizzling, references are left alone.
+  bpm = new BufferPoolManager(num_instances, buffer_pool_size, disk_manager);
+  SwizzledPageRef unused;
+  ASSERT_NE(nullptr, bpm->FetchPage(page_ids[1], &unused));
+  EXPECT_EQ(nullptr, unused.frame_.load());
+  EXPECT_TRUE(bpm->UnpinPage(page_ids[1], false));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+
+  delete bpm;
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, RetentionClassTest) {
+  const size_t buffer_pool_size = 8;
+  const size_t num_heap_pages = 50;
+
+  for (auto replacer_type : {ReplacerType::CLOCK, ReplacerType::LRU_K}) {
+    BufferPoolOptions options;
+    options.replacer_type_ = replacer_type;
+    auto *disk_manager = new DiskManager("test.db");
+    auto *bpm = new BufferPoolManager(1, buffer_pool_size, disk_manager, nullptr, options);
+    AccessContext header_access{nullptr, false, AccessCategory::INDEX, NO_OWNER, RetentionClass::INDEX_HEADER};
+    AccessContext block_access{nullptr, false, AccessCategory::INDEX, NO_OWNER, RetentionClass::INDEX_BLOCK};
+    AccessContext heap_access{nullptr, false, AccessCategory::TABLE_SCAN, NO_OWNER, RetentionClass::HEAP};
+
+    page_id_t header_page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(&header_page_id, header_access));
+    EXPECT_TRUE(bpm->UnpinPage(header_page_id, true));
+    std::vector<page_id_t> block_page_ids(2);
+    for (auto &page_id : block_page_ids) {
+      ASSERT_NE(nullptr, bpm->NewPage(&page_id, block_access));
+      EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+    }
+    std::vector<page_id_t> heap_page_ids(num_heap_pages);
+    for (auto &page_id : heap_page_ids) {
+      ASSERT_NE(nullptr, bpm->NewPage(&page_id, heap_access));
+      EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+    }
+
+    // Scenario: a scan that goes through far more pages than there are frames between two lookups pushes out its own
+    // pages only, and the lookups never miss.
+    auto misses = bpm->GetStats().misses_;
+    for (size_t round = 0; round < 3; round++) {
+      for (size_t i = 0; i < num_heap_pages; i++) {
+        ASSERT_NE(nullptr, bpm->FetchPage(heap_page_ids[i], heap_access));
+        EXPECT_TRUE(bpm->UnpinPage(heap_page_ids[i], false));
+        if (i % (2 * buffer_pool_size) == 0) {
+          auto before = bpm->GetStats().misses_;
+          ASSERT_NE(nullptr, bpm->FetchPage(header_page_id, header_access));
+          EXPECT_TRUE(bpm->UnpinPage(header_page_id, false));
+          auto block_page_id = block_page_ids[i % block_page_ids.size()];
+          ASSERT_NE(nullptr, bpm->FetchPage(block_page_id, block_access));
+          EXPECT_TRUE(bpm->UnpinPage(block_page_id, false));
+          EXPECT_EQ(before, bpm->GetStats().misses_);
+        }
+      }
+    }
+    EXPECT_LT(misses, bpm->GetStats().misses_);
+
+    // Scenario: the index pages go once nothing of a lower class is left to evict.
+    std::vector<page_id_t> pinned;
+    for (size_t i = 0; i < buffer_pool_size; i++) {
+      page_id_t page_id;
+      ASSERT_NE(nullptr, bpm->NewPage(&page_id, heap_access));
+      pinned.push_back(page_id);
+    }
+    for (auto page_id : pinned) {
+      EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+    }
+    auto before = bpm->GetStats().misses_;
+    ASSERT_NE(nullptr, bpm->FetchPage(header_page_id, header_access));
+    EXPECT_TRUE(bpm->UnpinPage(header_page_id, false));
+    EXPECT_EQ(before + 1, bpm->GetStats().misses_);
+
+    disk_manager->ShutDown();
+    remove("test.db");
+    remove("test.fsm");
+    delete bpm;
+    delete disk_manager;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, DirectIOTest) {
+  const size_t buffer_pool_size = 10;
+  const size_t num_pages = 40;
+
+  for (bool use_huge_pages : {false, true}) {
+    BufferPoolOptions options;
+    options.max_pool_size_ = 2 * buffer_pool_size;
+    options.use_huge_pages_ = use_huge_pages;
+    auto *disk_manager = new DiskManager("test.db", DiskIOBackend::AUTO, true);
+    auto *bpm = new BufferPoolManager(2, buffer_pool_size, disk_manager, nullptr, options);
+
+    // Scenario: every frame is aligned for direct I/O, and pages that are evicted and read again keep their data.
+    for (size_t i = 0; i < num_pages; i++) {
+      page_id_t page_id;
+      auto *page = bpm->NewPage(&page_id);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(0, reinterpret_cast<uintptr_t>(page->GetData()) % DiskManager::DIRECT_IO_ALIGNMENT);
+      snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id);
+      EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+    }
+    for (size_t round = 0; round < 2; round++) {
+      for (page_id_t page_id = 0; page_id < static_cast<page_id_t>(num_pages); page_id++) {
+        auto *page = bpm->FetchPage(page_id);
+        ASSERT_NE(nullptr, page);
+        EXPECT_STREQ(("page " + std::to_string(page_id)).c_str(), page->GetData());
+        EXPECT_TRUE(bpm->UnpinPage(page_id, false));
+      }
+      // Scenario: the pool grows, then shrinks back, and the frames it gains are read into the same way.
+      EXPECT_TRUE(bpm->Resize(2 * buffer_pool_size - round * buffer_pool_size));
+    }
+    // Scenario: a batch of adjacent pages is read in one go.
+    auto pages = bpm->FetchPages({0, 1, 2, 3});
+    for (size_t i = 0; i < pages.size(); i++) {
+      ASSERT_NE(nullptr, pages[i]);
+      EXPECT_STREQ(("page " + std::to_string(i)).c_str(), pages[i]->GetData());
+      EXPECT_TRUE(bpm->UnpinPage(i, false));
+    }
+
+    disk_manager->ShutDown();
+    remove("test.db");
+    remove("test.fsm");
+    delete bpm;
+    delete disk_manager;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, ExtentTest) {
+  const size_t buffer_pool_size = 10;
+  const size_t extent_size = 8;
+  const size_t num_pages = 20;
+
+  BufferPoolOptions options;
+  options.extent_size_ = extent_size;
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManager(2, buffer_pool_size, disk_manager, nullptr, options);
+  std::vector<AccessContext> accesses;
+  for (const auto &name : {"table:a", "index:b"}) {
+    accesses.push_back({nullptr, false, AccessCategory::TABLE, bpm->RegisterOwner(name)});
+  }
+  accesses.emplace_back();
+
+  // Scenario: owners that create pages in turn each get pages that are adjacent on disk, a whole extent at a time,
+  // while pages without an owner are allocated one by one.
+  std::vector<std::vector<page_id_t>> page_ids(accesses.size());
+  for (size_t i = 0; i < num_pages; i++) {
+    for (size_t owner = 0; owner < accesses.size(); owner++) {
+      page_id_t page_id;
+      ASSERT_NE(nullptr, bpm->NewPage(&page_id, accesses[owner]));
+      EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+      page_ids[owner].push_back(page_id);
+    }
+  }
+  std::vector<page_id_t> all_page_ids;
+  for (size_t owner = 0; owner < accesses.size(); owner++) {
+    for (size_t i = 1; i < num_pages; i++) {
+      if (owner != accesses.size() - 1 && i % extent_size != 0) {
+        EXPECT_EQ(page_ids[owner][i - 1] + 1, page_ids[owner][i]) << "page " << i << " of owner " << owner;
+      }
+    }
+    all_page_ids.insert(all_page_ids.end(), page_ids[owner].begin(), page_ids[owner].end());
+  }
+  EXPECT_EQ(static_cast<page_id_t>(2 * extent_size), page_ids[2][0]);
+  std::sort(all_page_ids.begin(), all_page_ids.end());
+  EXPECT_EQ(all_page_ids.end(), std::adjacent_find(all_page_ids.begin(), all_page_ids.end()));
+
+  // Scenario: a page of an extent whose instance is full stays with its owner, instead of going to other owners.
+  auto full_page_id = page_ids[0].back() + 1;
+  std::vector<page_id_t> pinned_page_ids;
+  for (auto page_id : all_page_ids) {
+    if (page_id % 2 == full_page_id % 2 && pinned_page_ids.size() < buffer_pool_size / 2) {
+      ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+      pinned_page_ids.push_back(page_id);
+    }
+  }
+  page_id_t page_id;
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id, accesses[0]));
+  EXPECT_EQ(full_page_id + 1, page_id);
+  EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  for (size_t i = 0; i < 2; i++) {
+    ASSERT_NE(nullptr, bpm->NewPage(&page_id, accesses[2]));
+    EXPECT_NE(full_page_id, page_id);
+    EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+  }
+  EXPECT_TRUE(disk_manager->IsAllocated(full_page_id));
+  for (auto pinned_page_id : pinned_page_ids) {
+    EXPECT_TRUE(bpm->UnpinPage(pinned_page_id, false));
+  }
+  ASSERT_NE(nullptr, bpm->NewPage(&page_id, accesses[0]));
+  EXPECT_EQ(full_page_id, page_id);
+  EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+
+  // Scenario: what the owners did not use of their extents is deallocated on request, also in the free space map on
+  // disk, whenever the buffer pool goes away.
+  auto unused_page_id = full_page_id + 2;
+  EXPECT_TRUE(disk_manager->IsAllocated(unused_page_id));
+  bpm->ReleaseExtents();
+  EXPECT_FALSE(disk_manager->IsAllocated(unused_page_id));
+  EXPECT_TRUE(disk_manager->IsAllocated(full_page_id));
+  disk_manager->ShutDown();
+  delete bpm;
+  delete disk_manager;
+  disk_manager = new DiskManager("test.db");
+  EXPECT_FALSE(disk_manager->IsAllocated(unused_page_id));
+  EXPECT_TRUE(disk_manager->IsAllocated(full_page_id));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  delete disk_manager;
+}
+
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerTest, UnpinRaceTest) {
+  const size_t buffer_pool_size = 4;
+  const int num_hot_threads = 3;
+  const int num_cold_pages = 50;
+
+  for (auto replacer_type : {ReplacerType::CLOCK, ReplacerType::LRU_K}) {
+    BufferPoolOptions options;
+    options.replacer_type_ = replacer_type;
+    auto *disk_manager = new DiskManager("test.db");
+    auto *bpm = new BufferPoolManager(1, buffer_pool_size, disk_manager, nullptr, options);
+    page_id_t page_id;
+    for (int i = 0; i <= num_cold_pages; i++) {
+      ASSERT_NE(nullptr, bpm->NewPage(&page_id));
+      EXPECT_TRUE(bpm->UnpinPage(page_id, true));
+    }
+
+    // Scenario: threads pin and unpin a hot page as fast as they can, so that its last pin goes away just as it is
+    // pinned again. The replacer must never take the pinned frame for an evictable one, or a fetch that needs a
+    // victim fails although at most two frames are ever pinned.
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_hot_threads; t++) {
+      threads.emplace_back([bpm, &done] {
+        while (!done) {
+          ASSERT_NE(nullptr, bpm->FetchPage(0));
+          bpm->UnpinPage(0, false);
+        }
+      });
+    }
+    for (int round = 0; round < 20; round++) {
+      for (page_id_t cold = 1; cold <= num_cold_pages; cold++) {
+        ASSERT_NE(nullptr, bpm->FetchPage(cold)) << "page " << cold;
+        EXPECT_TRUE(bpm->UnpinPage(cold, false));
+      }
+    }
+    done = true;
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    disk_manager->ShutDown();
+    remove("test.db");
+    remove("test.fsm");
+    delete bpm;
+    delete disk_manager;
+  }
+}
+
 }  // namespace bustub
@@ -10,11 +10,13 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <chrono>  // NOLINT
 #include <cstdio>
 #include <thread>  // NOLINT
 #include <vector>
 
 #include "buffer/clock_replacer.h"
+#include "common/logger.h"
 #include "gtest/gtest.h"
 
 namespace bustub {
@@ -59,4 +61,96 @@ TEST(ClockReplacerTest, SampleTest) {
   EXPECT_EQ(4, value);
 }
 
+// NOLINTNEXTLINE
+TEST(ClockReplacerTest, ConcurrencyTest) {
+  const int num_frames = 1024;
+  const int num_threads = 4;
+  const int rounds = 100000;
+  ClockReplacer clock_replacer(num_frames);
+
+  // Scenario: every thread keeps pinning and unpinning its own frames while another thread victimizes. Whatever is
+  // left unpinned at the end must be victimized exactly once.
+  std::vector<std::thread> threads;
+  std::atomic<bool> done{false};
+  std::atomic<int> num_victims{0};
+  auto start = std::chrono::steady_clock::now();
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&clock_replacer, tid]() {
+      for (int round = 0; round < rounds; round++) {
+        frame_id_t frame_id = tid + (round % (num_frames / num_threads)) * num_threads;
+        clock_replacer.Pin(frame_id);
+        clock_replacer.Unpin(frame_id);
+      }
+    });
+  }
+  std::thread victim_thread([&clock_replacer, &done, &num_victims]() {
+    frame_id_t frame_id;
+    while (!done) {
+      if (clock_replacer.Victim(&frame_id)) {
+        num_victims++;
+      }
+    }
+  });
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  done = true;
+  victim_thread.join();
+  LOG_INFO("%d pin/unpin pairs in %.3f s (%.0f pairs/s)", num_threads * rounds, elapsed,
+           num_threads * rounds / elapsed);
+
+  std::vector<bool> victimized(num_frames, false);
+  frame_id_t frame_id;
+  size_t remaining = clock_replacer.Size();
+  for (size_t i = 0; i < remaining; i++) {
+    ASSERT_TRUE(clock_replacer.Victim(&frame_id));
+    EXPECT_FALSE(victimized[frame_id]);
+    victimized[frame_id] = true;
+  }
+  EXPECT_FALSE(clock_replacer.Victim(&frame_id));
+  EXPECT_EQ(0, clock_replacer.Size());
+  EXPECT_GT(num_victims + remaining, 0);
+}
+
+// NOLINTNEXTLINE
+TEST(ClockReplacerTest, RetentionClassTest) {
+  ClockReplacer clock_replacer(8);
+
+  // Scenario: frames of lower classes are victimized first, in clock order within a class.
+  clock_replacer.SetRetentionClass(1, RetentionClass::INDEX_HEADER);
+  clock_replacer.SetRetentionClass(2, RetentionClass::INDEX_BLOCK);
+  clock_replacer.SetRetentionClass(4, RetentionClass::TEMP);
+  clock_replacer.SetRetentionClass(6, RetentionClass::INDEX_BLOCK);
+  for (frame_id_t frame_id = 1; frame_id <= 6; frame_id++) {
+    clock_replacer.Unpin(frame_id);
+  }
+  EXPECT_EQ((std::vector<frame_id_t>{4, 3, 5, 2, 6, 1}), clock_replacer.EvictionCandidates(8));
+  int value;
+  ASSERT_TRUE(clock_replacer.Victim(&value));
+  EXPECT_EQ(4, value);
+  ASSERT_TRUE(clock_replacer.Victim(&value));
+  EXPECT_EQ(5, value);
+
+  // Scenario: a frame that is accessed with another class moves to that class.
+  clock_replacer.Pin(6);
+  clock_replacer.SetRetentionClass(6, RetentionClass::HEAP);
+  clock_replacer.Unpin(6);
+  EXPECT_EQ(4, clock_replacer.Size());
+  ASSERT_TRUE(clock_replacer.Victim(&value));
+  EXPECT_EQ(3, value);
+  ASSERT_TRUE(clock_replacer.Victim(&value));
+  EXPECT_EQ(6, value);
+
+  // Scenario: a class is victimized once the classes below it have nothing left, even if they have pinned frames.
+  clock_replacer.Unpin(7);
+  clock_replacer.Pin(7);
+  ASSERT_TRUE(clock_replacer.Victim(&value));
+  EXPECT_EQ(2, value);
+  ASSERT_TRUE(clock_replacer.Victim(&value));
+  EXPECT_EQ(1, value);
+  EXPECT_FALSE(clock_replacer.Victim(&value));
+  EXPECT_EQ(0, clock_replacer.Size());
+}
+
 }  // namespace bustub
@@ -0,0 +1,291 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer_test.cpp
+//
+// Identification: test/buffer/lru_k_replacer_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/lru_k_replacer.h"
+#include "common/logger.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+TEST(LRUKReplacerTest, SampleTest) {
+  LRUKReplacer lru_replacer(7, 2);
+
+  // Scenario: frames 1-6 are referenced once, frame 1 twice. Only frame 1 has a finite backward 2-distance.
+  for (int fid = 1; fid <= 6; fid++) {
+    lru_replacer.RecordAccess(fid);
+  }
+  lru_replacer.RecordAccess(1);
+  for (int fid = 1; fid <= 6; fid++) {
+    lru_replacer.Unpin(fid);
+  }
+  EXPECT_EQ(6, lru_replacer.Size());
+
+  // Scenario: frames with a single reference go first, least recently referenced first.
+  int value;
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(2, value);
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(3, value);
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(4, value);
+  EXPECT_EQ(3, lru_replacer.Size());
+
+  // Scenario: pinned frames are not victimized, but they keep their history.
+  lru_replacer.Pin(5);
+  lru_replacer.Pin(6);
+  EXPECT_EQ(1, lru_replacer.Size());
+  lru_replacer.RecordAccess(5);
+  lru_replacer.Unpin(5);
+  lru_replacer.Unpin(6);
+
+  // Scenario: 6 still has a single reference. 1 was referenced twice before 5 was, so its 2nd reference is older.
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(6, value);
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(1, value);
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(5, value);
+  EXPECT_FALSE(lru_replacer.Victim(&value));
+  EXPECT_EQ(0, lru_replacer.Size());
+}
+
+TEST(LRUKReplacerTest, CorrelatedReferenceTest) {
+  LRUKReplacer lru_replacer(4, 2, 3);
+
+  // Scenario: frame 0 is referenced three times in a row, frames 1 and 2 twice with other references in between.
+  lru_replacer.RecordAccess(0);
+  lru_replacer.RecordAccess(0);
+  lru_replacer.RecordAccess(0);
+  lru_replacer.RecordAccess(1);
+  lru_replacer.RecordAccess(2);
+  lru_replacer.RecordAccess(3);
+  lru_replacer.RecordAccess(3);
+  lru_replacer.RecordAccess(3);
+  lru_replacer.RecordAccess(1);
+  lru_replacer.RecordAccess(2);
+  for (int fid = 0; fid < 3; fid++) {
+    lru_replacer.Unpin(fid);
+  }
+
+  // Scenario: the references to frame 0 were correlated, so it only counts as referenced once and goes first, even
+  // though it was referenced more often than the others.
+  int value;
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(0, value);
+
+  // Scenario: frames 1 and 2 were referenced within the correlated reference period, but nothing else is left.
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(1, value);
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(2, value);
+}
+
+namespace {
+
+/**
+ * Runs a sequential scan over a large table interleaved with point lookups on a small hot set, and returns the hit
+ * ratio of the point lookups.
+ */
+double MixedWorkloadHitRatio(ReplacerType replacer_type) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 64;
+  const int num_hot_pages = 48;
+  const int num_scan_pages = 1024;
+  const int num_lookups_per_scan_page = 1;
+
+  auto *disk_manager = new DiskManager(db_name);
+  BufferPoolOptions options;
+  options.replacer_type_ = replacer_type;
+  auto *bpm = new BufferPoolManager(1, buffer_pool_size, disk_manager, nullptr, options);
+
+  std::vector<page_id_t> hot_pages;
+  std::vector<page_id_t> scan_pages;
+  page_id_t page_id;
+  for (int i = 0; i < num_hot_pages + num_scan_pages; i++) {
+    EXPECT_NE(nullptr, bpm->NewPage(&page_id));
+    bpm->UnpinPage(page_id, true);
+    (i < num_hot_pages ? hot_pages : scan_pages).push_back(page_id);
+  }
+
+  std::mt19937 generator(15445);
+  std::uniform_int_distribution<int> hot_page_distribution(0, num_hot_pages - 1);
+  auto fetch = [bpm](page_id_t page_id) {
+    EXPECT_NE(nullptr, bpm->FetchPage(page_id));
+    bpm->UnpinPage(page_id, false);
+  };
+  // Warm up the hot set.
+  for (int i = 0; i < 4 * num_hot_pages; i++) {
+    fetch(hot_pages[hot_page_distribution(generator)]);
+  }
+
+  uint64_t lookup_hits = 0;
+  uint64_t lookups = 0;
+  for (auto scan_page : scan_pages) {
+    fetch(scan_page);
+    for (int i = 0; i < num_lookups_per_scan_page; i++) {
+      auto before = bpm->GetStats().hits_;
+      fetch(hot_pages[hot_page_distribution(generator)]);
+      lookup_hits += bpm->GetStats().hits_ - before;
+      lookups++;
+    }
+  }
+
+  disk_manager->ShutDown();
+  remove(db_name.c_str());
+  remove("test.fsm");
+  delete bpm;
+  delete disk_manager;
+  return static_cast<double>(lookup_hits) / lookups;
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(LRUKReplacerTest, ScanResistanceTest) {
+  auto clock_hit_ratio = MixedWorkloadHitRatio(ReplacerType::CLOCK);
+  auto lru_k_hit_ratio = MixedWorkloadHitRatio(ReplacerType::LRU_K);
+  LOG_INFO("Point lookup hit ratio next to a scan: clock %.3f, lru-k %.3f", clock_hit_ratio, lru_k_hit_ratio);
+  EXPECT_GT(lru_k_hit_ratio, clock_hit_ratio);
+  EXPECT_GT(lru_k_hit_ratio, 0.9);
+}
+
+// NOLINTNEXTLINE
+TEST(LRUKReplacerTest, RetentionClassTest) {
+  LRUKReplacer lru_replacer(7, 2);
+
+  // Scenario: a frame of a higher class outlives colder frames of lower classes, however often they are referenced.
+  for (frame_id_t frame_id = 1; frame_id <= 4; frame_id++) {
+    lru_replacer.RecordAccess(frame_id);
+  }
+  for (int i = 0; i < 3; i++) {
+    lru_replacer.RecordAccess(2);
+    lru_replacer.RecordAccess(3);
+  }
+  lru_replacer.SetRetentionClass(1, RetentionClass::INDEX_HEADER);
+  lru_replacer.SetRetentionClass(2, RetentionClass::INDEX_BLOCK);
+  lru_replacer.SetRetentionClass(4, RetentionClass::TEMP);
+  for (frame_id_t frame_id = 1; frame_id <= 4; frame_id++) {
+    lru_replacer.Unpin(frame_id);
+  }
+  EXPECT_EQ((std::vector<frame_id_t>{4, 3, 2, 1}), lru_replacer.EvictionCandidates(4));
+  int value;
+  for (frame_id_t expected : {4, 3, 2, 1}) {
+    ASSERT_TRUE(lru_replacer.Victim(&value));
+    EXPECT_EQ(expected, value);
+  }
+
+  // Scenario: a victimized frame forgets its class.
+  lru_replacer.RecordAccess(1);
+  lru_replacer.RecordAccess(5);
+  lru_replacer.Unpin(1);
+  lru_replacer.Unpin(5);
+  ASSERT_TRUE(lru_replacer.Victim(&value));
+  EXPECT_EQ(1, value);
+}
+
+// NOLINTNEXTLINE
+TEST(LRUKReplacerTest, MatchesFullScanTest) {
+  const size_t num_frames = 64;
+  const size_t k = 3;
+  const uint64_t period = 2;
+  LRUKReplacer lru_replacer(num_frames, k, period);
+
+  // A replacer that looks at every frame for every victim, as the definition goes.
+  struct Frame {
+    std::vector<uint64_t> history_ = std::vector<uint64_t>(k, 0);
+    uint64_t last_ = 0;
+    bool evictable_ = false;
+    RetentionClass retention_ = RetentionClass::HEAP;
+  };
+  std::vector<Frame> frames(num_frames);
+  uint64_t now = 0;
+  auto access = [&](Frame *frame) {
+    now++;
+    if (frame->history_[0] != 0 && now - frame->last_ <= period) {
+      frame->last_ = now;
+      return;
+    }
+    uint64_t correlated_period = frame->history_[0] != 0 ? frame->last_ - frame->history_[0] : 0;
+    for (size_t i = k - 1; i > 0; i--) {
+      frame->history_[i] = frame->history_[i - 1] != 0 ? frame->history_[i - 1] + correlated_period : 0;
+    }
+    frame->history_[0] = now;
+    frame->last_ = now;
+  };
+  auto evicts_before = [&](const Frame &a, const Frame &b) {
+    if (a.retention_ != b.retention_) {
+      return a.retention_ < b.retention_;
+    }
+    bool eligible_a = now - a.last_ > period;
+    bool eligible_b = now - b.last_ > period;
+    if (eligible_a != eligible_b) {
+      return eligible_a;
+    }
+    if (a.history_[k - 1] != b.history_[k - 1]) {
+      return a.history_[k - 1] < b.history_[k - 1];
+    }
+    return a.last_ < b.last_;
+  };
+
+  // Scenario: random references, pins, unpins and class changes pick the same victims as the full scan.
+  std::mt19937 rng(15445);
+  for (int op = 0; op < 20000; op++) {
+    auto fid = static_cast<frame_id_t>(rng() % num_frames);
+    auto &frame = frames[fid];
+    switch (rng() % 6) {
+      case 0:
+      case 1:
+        lru_replacer.RecordAccess(fid);
+        access(&frame);
+        break;
+      case 2:
+        lru_replacer.Pin(fid);
+        frame.evictable_ = false;
+        break;
+      case 3:
+        lru_replacer.Unpin(fid);
+        frame.evictable_ = true;
+        break;
+      case 4: {
+        auto retention = static_cast<RetentionClass>(rng() % NUM_RETENTION_CLASSES);
+        lru_replacer.SetRetentionClass(fid, retention);
+        frame.retention_ = retention;
+        break;
+      }
+      default: {
+        int expected = -1;
+        for (size_t i = 0; i < num_frames; i++) {
+          if (frames[i].evictable_ && (expected == -1 || evicts_before(frames[i], frames[expected]))) {
+            expected = static_cast<int>(i);
+          }
+        }
+        frame_id_t victim;
+        ASSERT_EQ(expected != -1, lru_replacer.Victim(&victim));
+        if (expected != -1) {
+          ASSERT_EQ(expected, victim) << "operation " << op;
+          frames[expected] = Frame();
+        }
+      }
+    }
+    auto num_evictable = std::count_if(frames.begin(), frames.end(), [](const Frame &f) { return f.evictable_; });
+    ASSERT_EQ(static_cast<size_t>(num_evictable), lru_replacer.Size());
+  }
+}
+
+}  // namespace bustub
@@ -0,0 +1,132 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_table_test.cpp
+//
+// Identification: test/buffer/page_table_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <random>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/page_table.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+TEST(PageTableTest, SampleTest) {
+  const size_t num_frames = 16;
+  PageTable page_table(num_frames);
+
+  // Scenario: a full table finds every page, and nothing else.
+  for (size_t i = 0; i < num_frames; i++) {
+    page_table.Insert(static_cast<page_id_t>(i * 4), static_cast<frame_id_t>(i));
+  }
+  for (size_t i = 0; i < num_frames; i++) {
+    EXPECT_EQ(static_cast<frame_id_t>(i), page_table.Find(static_cast<page_id_t>(i * 4)));
+    EXPECT_EQ(-1, page_table.Find(static_cast<page_id_t>(i * 4 + 1)));
+  }
+
+  // Scenario: erasing pages does not lose the ones that collided with them.
+  for (size_t i = 0; i < num_frames; i += 2) {
+    EXPECT_TRUE(page_table.Erase(static_cast<page_id_t>(i * 4)));
+    EXPECT_FALSE(page_table.Erase(static_cast<page_id_t>(i * 4)));
+  }
+  for (size_t i = 0; i < num_frames; i++) {
+    EXPECT_EQ(i % 2 == 0 ? -1 : static_cast<frame_id_t>(i), page_table.Find(static_cast<page_id_t>(i * 4)));
+  }
+}
+
+TEST(PageTableTest, ChurnTest) {
+  const size_t num_frames = 64;
+  PageTable page_table(num_frames);
+  std::unordered_map<page_id_t, frame_id_t> expected;
+  std::vector<frame_id_t> free_frames;
+  for (size_t i = 0; i < num_frames; i++) {
+    free_frames.push_back(static_cast<frame_id_t>(i));
+  }
+
+  // Scenario: pages come and go at random, as they do in a buffer pool. The table always agrees with a reference map.
+  std::mt19937 generator(15445);
+  std::uniform_int_distribution<page_id_t> page_distribution(0, 1000);
+  for (int round = 0; round < 100000; round++) {
+    auto page_id = page_distribution(generator);
+    auto iterator = expected.find(page_id);
+    if (iterator != expected.end()) {
+      ASSERT_EQ(iterator->second, page_table.Find(page_id));
+      ASSERT_TRUE(page_table.Erase(page_id));
+      free_frames.push_back(iterator->second);
+      expected.erase(iterator);
+    } else if (!free_frames.empty()) {
+      ASSERT_EQ(-1, page_table.Find(page_id));
+      page_table.Insert(page_id, free_frames.back());
+      expected[page_id] = free_frames.back();
+      free_frames.pop_back();
+    }
+  }
+  for (const auto &entry : expected) {
+    EXPECT_EQ(entry.second, page_table.Find(entry.first));
+  }
+}
+
+TEST(PageTableTest, ConcurrentFindTest) {
+  const size_t num_frames = 32;
+  PageTable page_table(num_frames);
+  // Pages that never leave the table, mixed with pages that are inserted and erased all the time.
+  const int num_stable_pages = num_frames / 2;
+  for (int i = 0; i < num_stable_pages; i++) {
+    page_table.Insert(i, i);
+  }
+
+  // Scenario: lookups run while a writer churns the rest of the table. They may miss a page that is being moved,
+  // but they never return a wrong frame.
+  std::atomic<bool> done{false};
+  std::thread writer([&page_table, &done]() {
+    std::mt19937 generator(15445);
+    std::uniform_int_distribution<page_id_t> page_distribution(1000, 2000);
+    std::vector<page_id_t> resident;
+    while (!done) {
+      if (resident.size() < num_frames - num_stable_pages) {
+        auto page_id = page_distribution(generator);
+        if (page_table.Find(page_id) < 0) {
+          page_table.Insert(page_id, page_id % num_frames);
+          resident.push_back(page_id);
+        }
+      } else {
+        auto index = generator() % resident.size();
+        page_table.Erase(resident[index]);
+        resident[index] = resident.back();
+        resident.pop_back();
+      }
+    }
+  });
+  std::vector<std::thread> readers;
+  for (int tid = 0; tid < 2; tid++) {
+    readers.emplace_back([&page_table]() {
+      for (int round = 0; round < 100000; round++) {
+        auto page_id = round % num_stable_pages;
+        auto frame_id = page_table.Find(page_id);
+        if (frame_id >= 0) {
+          ASSERT_EQ(page_id, frame_id);
+        }
+      }
+    });
+  }
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  done = true;
+  writer.join();
+  for (int i = 0; i < num_stable_pages; i++) {
+    EXPECT_EQ(i, page_table.Find(i));
+  }
+}
+
+}  // namespace bustub
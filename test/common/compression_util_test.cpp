@@ -0,0 +1,106 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compression_util_test.cpp
+//
+// Identification: test/common/compression_util_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "common/util/compression_util.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+/** Compresses and decompresses the data, and checks that it comes back unchanged. @return the compressed size */
+size_t RoundTrip(const std::string &data) {
+  std::vector<char> compressed(data.size() + data.size() / 255 + 16);
+  auto size = CompressionUtil::Compress(data.data(), data.size(), compressed.data(), compressed.size());
+  EXPECT_LT(0, size);
+  std::string decompressed(data.size(), '\0');
+  EXPECT_TRUE(CompressionUtil::Decompress(compressed.data(), size, &decompressed[0], decompressed.size()));
+  EXPECT_EQ(data, decompressed);
+  return size;
+}
+
+// NOLINTNEXTLINE
+TEST(CompressionUtilTest, RoundTripTest) {
+  std::mt19937 generator(15445);
+
+  // An empty page shrinks to almost nothing.
+  EXPECT_GT(64, RoundTrip(std::string(PAGE_SIZE, '\0')));
+
+  // So do short runs and repeated patterns of any period, including ones shorter than a match.
+  std::string pattern;
+  for (size_t i = 0; i < PAGE_SIZE; i++) {
+    pattern.push_back(static_cast<char>('a' + i % 3));
+  }
+  EXPECT_GT(64, RoundTrip(pattern));
+  std::string records;
+  while (records.size() < PAGE_SIZE) {
+    records += "tuple " + std::to_string(records.size() % 1000) + " | name=bustub | value=42;";
+  }
+  records.resize(PAGE_SIZE);
+  EXPECT_GT(PAGE_SIZE / 4, RoundTrip(records));
+
+  // Random data does not shrink, but still comes back.
+  std::string random(PAGE_SIZE, '\0');
+  for (auto &byte : random) {
+    byte = static_cast<char>(generator());
+  }
+  EXPECT_LE(PAGE_SIZE, RoundTrip(random));
+
+  // A page that is half data and half zeros, like a typical slotted page.
+  std::string half = random.substr(0, PAGE_SIZE / 2) + std::string(PAGE_SIZE / 2, '\0');
+  EXPECT_GT(PAGE_SIZE * 3 / 4, RoundTrip(half));
+
+  // Tiny inputs, shorter than a match, and the largest input.
+  RoundTrip("a");
+  RoundTrip("abcabc");
+  std::string largest(CompressionUtil::MAX_INPUT_SIZE, '\0');
+  for (size_t i = 0; i < largest.size(); i += 7) {
+    largest[i] = static_cast<char>(generator());
+  }
+  RoundTrip(largest);
+}
+
+// NOLINTNEXTLINE
+TEST(CompressionUtilTest, BoundsTest) {
+  std::mt19937 generator(15445);
+  std::string random(PAGE_SIZE, '\0');
+  for (auto &byte : random) {
+    byte = static_cast<char>(generator());
+  }
+  std::vector<char> compressed(2 * PAGE_SIZE);
+
+  // Output that would not fit is refused rather than written past the end.
+  EXPECT_EQ(0, CompressionUtil::Compress(random.data(), random.size(), compressed.data(), PAGE_SIZE - 1));
+  std::string zeros(PAGE_SIZE, '\0');
+  EXPECT_EQ(0, CompressionUtil::Compress(zeros.data(), zeros.size(), compressed.data(), 4));
+
+  // Corrupt or truncated input is detected rather than read or written out of bounds.
+  auto size = CompressionUtil::Compress(zeros.data(), zeros.size(), compressed.data(), compressed.size());
+  ASSERT_LT(0, size);
+  std::string decompressed(PAGE_SIZE, '\0');
+  EXPECT_FALSE(CompressionUtil::Decompress(compressed.data(), size - 2, &decompressed[0], PAGE_SIZE));
+  EXPECT_FALSE(CompressionUtil::Decompress(compressed.data(), size, &decompressed[0], PAGE_SIZE - 1));
+  EXPECT_FALSE(CompressionUtil::Decompress(compressed.data(), size, &decompressed[0], PAGE_SIZE + 1));
+  for (size_t i = 0; i < 1000; i++) {
+    std::vector<char> garbage(1 + generator() % 64);
+    for (auto &byte : garbage) {
+      byte = static_cast<char>(generator());
+    }
+    // The result does not matter, as long as nothing is touched outside of the buffers.
+    CompressionUtil::Decompress(garbage.data(), garbage.size(), &decompressed[0], PAGE_SIZE);
+  }
+}
+
+}  // namespace bustub
@@ -10,6 +10,13 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <climits>
+#include <condition_variable>  // NOLINT
+#include <iomanip>
+#include <iostream>
+#include <mutex>   // NOLINT
 #include <thread>  // NOLINT
 #include <vector>
 
@@ -57,4 +64,179 @@ TEST(RWLatchTest, BasicTest) {
   }
   EXPECT_EQ(counter.Read(), 55);
 }
+
+/** The latch as it was before it got a fast path, for the benchmark to compare against. */
+class MutexReaderWriterLatch {
+ public:
+  void WLock() {
+    std::unique_lock<std::mutex> latch(mutex_);
+    while (writer_entered_) {
+      reader_.wait(latch);
+    }
+    writer_entered_ = true;
+    while (reader_count_ > 0) {
+      writer_.wait(latch);
+    }
+  }
+  void WUnlock() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    writer_entered_ = false;
+    reader_.notify_all();
+  }
+  void RLock() {
+    std::unique_lock<std::mutex> latch(mutex_);
+    while (writer_entered_ || reader_count_ == UINT_MAX) {
+      reader_.wait(latch);
+    }
+    reader_count_++;
+  }
+  void RUnlock() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    reader_count_--;
+    if (writer_entered_ ? reader_count_ == 0 : reader_count_ == UINT_MAX - 1) {
+      (writer_entered_ ? writer_ : reader_).notify_one();
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable writer_;
+  std::condition_variable reader_;
+  uint32_t reader_count_{0};
+  bool writer_entered_{false};
+};
+
+template <typename Latch>
+class RWLatchTypedTest : public ::testing::Test {};
+
+using LatchTypes = ::testing::Types<ReaderWriterLatch, DistributedReaderWriterLatch>;
+TYPED_TEST_CASE(RWLatchTypedTest, LatchTypes);
+
+// NOLINTNEXTLINE
+TYPED_TEST(RWLatchTypedTest, ExclusionTest) {
+  TypeParam latch;
+  std::atomic<int> readers{0};
+  std::atomic<int> writers{0};
+  std::atomic<bool> violated{false};
+  int64_t count = 0;
+  const int num_threads = 8;
+  const int num_ops = 20000;
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&, tid] {
+      for (int i = 0; i < num_ops; i++) {
+        if ((i + tid) % 8 == 0) {
+          latch.WLock();
+          if (writers.fetch_add(1) != 0 || readers.load() != 0) {
+            violated = true;
+          }
+          count++;
+          writers.fetch_sub(1);
+          latch.WUnlock();
+        } else {
+          latch.RLock();
+          readers.fetch_add(1);
+          if (writers.load() != 0) {
+            violated = true;
+          }
+          readers.fetch_sub(1);
+          latch.RUnlock();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_FALSE(violated);
+  EXPECT_EQ(num_threads * num_ops / 8, count);
+}
+
+// NOLINTNEXTLINE
+TYPED_TEST(RWLatchTypedTest, WriterPreferenceTest) {
+  // A writer that waits for a reader keeps new readers out, so that it is not starved.
+  TypeParam latch;
+  std::atomic<bool> writer_in{false};
+  std::atomic<bool> reader_in{false};
+  latch.RLock();
+  std::thread writer([&] {
+    latch.WLock();
+    writer_in = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    writer_in = false;
+    latch.WUnlock();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(writer_in);
+  std::thread reader([&] {
+    latch.RLock();
+    reader_in = true;
+    EXPECT_FALSE(writer_in);
+    latch.RUnlock();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(reader_in);
+  latch.RUnlock();
+  writer.join();
+  reader.join();
+  EXPECT_TRUE(reader_in);
+}
+
+/**
+ * Runs threads that take the latch in a loop for a while, each time for writing with the given probability, and
+ * returns the number of times it was taken per second.
+ */
+template <typename Latch>
+double MeasureLatch(int num_threads, int write_percent, std::chrono::milliseconds duration) {
+  Latch latch;
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> total{0};
+  uint64_t shared = 0;
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.emplace_back([&, tid] {
+      uint64_t ops = 0;
+      uint32_t random = tid * 2654435761U + 1;
+      uint64_t sink = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        random = random * 1103515245 + 12345;
+        if ((random >> 16) % 100 < static_cast<uint32_t>(write_percent)) {
+          latch.WLock();
+          shared++;
+          latch.WUnlock();
+        } else {
+          latch.RLock();
+          sink += shared;
+          latch.RUnlock();
+        }
+        ops++;
+      }
+      total += ops + (sink & 0);
+    });
+  }
+  std::this_thread::sleep_for(duration);
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return static_cast<double>(total) * 1000 / duration.count();
+}
+
+// A microbenchmark rather than a test. Run it with --gtest_also_run_disabled_tests.
+// NOLINTNEXTLINE
+TEST(RWLatchTest, DISABLED_BenchmarkTest) {
+  const std::chrono::milliseconds duration(200);
+  std::cout << std::setw(8) << "threads" << std::setw(8) << "writes" << std::setw(14) << "mutex" << std::setw(14)
+            << "atomic" << std::setw(14) << "distributed" << "   (million latches per second)" << std::endl;
+  for (int write_percent : {0, 1, 10, 50}) {
+    for (int num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+      std::cout << std::setw(8) << num_threads << std::setw(7) << write_percent << "%" << std::fixed
+                << std::setprecision(2) << std::setw(14)
+                << MeasureLatch<MutexReaderWriterLatch>(num_threads, write_percent, duration) / 1e6 << std::setw(14)
+                << MeasureLatch<ReaderWriterLatch>(num_threads, write_percent, duration) / 1e6 << std::setw(14)
+                << MeasureLatch<DistributedReaderWriterLatch>(num_threads, write_percent, duration) / 1e6 << std::endl;
+    }
+  }
+}
+
 }  // namespace bustub
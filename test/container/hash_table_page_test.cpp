@@ -56,6 +56,7 @@ TEST(HashTablePageTest, HeaderPageSampleTest) {
   bpm->UnpinPage(header_page_id, true, nullptr);
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.fsm");
   delete disk_manager;
   delete bpm;
 }
@@ -128,6 +129,7 @@ TEST(HashTablePageTest, BlockPageSampleTest) {
   bpm->UnpinPage(block_page_id, true, nullptr);
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.fsm");
   delete disk_manager;
   delete bpm;
 }
@@ -10,6 +10,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <iomanip>
+#include <iostream>
 #include <thread>  // NOLINT
 #include <vector>
 
@@ -34,6 +39,7 @@ TEST(HashTableTest, HashTable_Constructor) {
 
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.fsm");
   delete disk_manager;
   delete bpm;
 }
@@ -66,6 +72,7 @@ TEST(HashTableTest, HashTable_FullInsert) {
 
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.fsm");
   delete disk_manager;
   delete bpm;
 }
@@ -113,6 +120,7 @@ TEST(HashTableTest, HashTable_InsertAndSearch) {
 
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.fsm");
   delete disk_manager;
   delete bpm;
 }
@@ -197,8 +205,205 @@ TEST(HashTableTest, SampleTest) {
   }
   disk_manager->ShutDown();
   remove("test.db");
+  remove("test.fsm");
   delete disk_manager;
   delete bpm;
 }
 
+// NOLINTNEXTLINE
+TEST(HashTableTest, ResizeTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  // Far fewer frames than blocks, so that the blocks have to be read back while resizing.
+  auto *bpm = new BufferPoolManager(10, disk_manager);
+
+  LinearProbeHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), 1000, HashFunction<int>());
+
+  // Scenario: filling the table grows it, and every pair survives every resize.
+  const int num_keys = 5000;
+  for (int i = 0; i < num_keys; i++) {
+    EXPECT_TRUE(ht.Insert(nullptr, i, i));
+    EXPECT_TRUE(ht.Insert(nullptr, i, num_keys + i));
+  }
+  EXPECT_LE(static_cast<size_t>(2 * num_keys), ht.GetSize());
+  size_t size = ht.GetSize();
+  ht.Resize(size);
+  EXPECT_EQ(2 * size, ht.GetSize());
+  for (int i = 0; i < num_keys; i++) {
+    std::vector<int> result;
+    ht.GetValue(nullptr, i, &result);
+    ASSERT_EQ(2, result.size()) << "Lost key " << i;
+    EXPECT_EQ(i, std::min(result[0], result[1]));
+    EXPECT_EQ(num_keys + i, std::max(result[0], result[1]));
+  }
+  EXPECT_TRUE(ht.Remove(nullptr, 0, 0));
+
+  // Scenario: the table stops growing when the header page has no room for more blocks.
+  for (size = 0; size != ht.GetSize();) {
+    size = ht.GetSize();
+    ht.Resize(size);
+  }
+  auto header_page = ht.HeaderPage();
+  EXPECT_EQ(header_page->MaxBlocks(), header_page->NumBlocks());
+  bpm->UnpinPage(header_page->GetPageId(), false);
+  std::vector<int> result;
+  ht.GetValue(nullptr, num_keys - 1, &result);
+  EXPECT_EQ(2, result.size());
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, ConcurrentGetValueTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  auto *bpm = new BufferPoolManager(30, disk_manager);
+
+  LinearProbeHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), 1000, HashFunction<int>());
+  const int num_keys = 300;
+  for (int i = 0; i < num_keys; i++) {
+    EXPECT_TRUE(ht.Insert(nullptr, i, i));
+  }
+
+  // Scenario: lookups that read the blocks optimistically always see every pair that is there all along, while other
+  // pairs are inserted into and removed from the same blocks.
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int round = 0; round < 3; round++) {
+      for (int i = 0; i < num_keys; i++) {
+        EXPECT_TRUE(ht.Insert(nullptr, num_keys + i, i));
+      }
+      for (int i = 0; i < num_keys; i++) {
+        EXPECT_TRUE(ht.Remove(nullptr, num_keys + i, i));
+      }
+    }
+    done = true;
+  });
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 2; t++) {
+    readers.emplace_back([&] {
+      do {
+        for (int i = 0; i < num_keys; i++) {
+          std::vector<int> result;
+          ASSERT_TRUE(ht.GetValue(nullptr, i, &result));
+          ASSERT_EQ(1, result.size());
+          EXPECT_EQ(i, result[0]);
+        }
+      } while (!done);
+    });
+  }
+  writer.join();
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  std::vector<int> result;
+  EXPECT_FALSE(ht.GetValue(nullptr, num_keys, &result));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  delete disk_manager;
+  delete bpm;
+}
+
+// NOLINTNEXTLINE
+TEST(HashTableTest, SwizzleTest) {
+  auto *disk_manager = new DiskManager("test.db");
+  // Fewer frames than blocks, so that blocks are evicted under their swizzled references all the time.
+  BufferPoolOptions options;
+  options.enable_pointer_swizzling_ = true;
+  auto *bpm = new BufferPoolManager(2, 10, disk_manager, nullptr, options);
+
+  LinearProbeHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), 1000, HashFunction<int>());
+
+  // Scenario: inserts, lookups and resizes through swizzled references, from several threads at once.
+  const int num_threads = 4;
+  const int num_keys = 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = t; i < num_keys; i += num_threads) {
+        EXPECT_TRUE(ht.Insert(nullptr, i, i));
+        std::vector<int> result;
+        EXPECT_TRUE(ht.GetValue(nullptr, i, &result));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  ht.Resize(ht.GetSize());
+  for (int i = 0; i < num_keys; i++) {
+    std::vector<int> result;
+    ht.GetValue(nullptr, i, &result);
+    ASSERT_EQ(1, result.size()) << "Lost key " << i;
+    EXPECT_EQ(i, result[0]);
+    EXPECT_TRUE(ht.Remove(nullptr, i, i));
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  delete disk_manager;
+  delete bpm;
+}
+
+/** @return the number of lookups per second of threads that look up the keys of a resident hash table */
+double MeasureGetValue(bool enable_pointer_swizzling, int num_threads, std::chrono::milliseconds duration) {
+  auto *disk_manager = new DiskManager("test.db");
+  BufferPoolOptions options;
+  options.enable_pointer_swizzling_ = enable_pointer_swizzling;
+  auto *bpm = new BufferPoolManager(4, 64, disk_manager, nullptr, options);
+  const int num_keys = 10000;
+  double ops;
+  {
+    LinearProbeHashTable<int, int, IntComparator> ht("blah", bpm, IntComparator(), 2 * num_keys, HashFunction<int>());
+    for (int i = 0; i < num_keys; i++) {
+      ht.Insert(nullptr, i, i);
+    }
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> total{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] {
+        uint64_t count = 0;
+        std::vector<int> result;
+        for (int i = t; !stop.load(std::memory_order_relaxed); i = (i + 7919) % num_keys) {
+          result.clear();
+          ht.GetValue(nullptr, i, &result);
+          count++;
+        }
+        total += count;
+      });
+    }
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    ops = static_cast<double>(total) * 1000 / duration.count();
+  }
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  delete bpm;
+  delete disk_manager;
+  return ops;
+}
+
+// A microbenchmark rather than a test. Run it with --gtest_also_run_disabled_tests.
+// NOLINTNEXTLINE
+TEST(HashTableTest, DISABLED_SwizzleBenchmarkTest) {
+  const std::chrono::milliseconds duration(500);
+  std::cout << std::setw(8) << "threads" << std::setw(16) << "page table" << std::setw(16) << "swizzled"
+            << "   (thousand lookups per second)" << std::endl;
+  for (int num_threads : {1, 2, 4, 8}) {
+    std::cout << std::setw(8) << num_threads << std::fixed << std::setprecision(1) << std::setw(16)
+              << MeasureGetValue(false, num_threads, duration) / 1e3 << std::setw(16)
+              << MeasureGetValue(true, num_threads, duration) / 1e3 << std::endl;
+  }
+}
+
 }  // namespace bustub
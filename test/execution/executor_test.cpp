@@ -60,6 +60,7 @@ class ExecutorTest : public ::testing::Test {
     // Shut down the disk manager and clean up the transaction.
     disk_manager_->ShutDown();
     remove("executor_test.db");
+    remove("executor_test.fsm");
     delete txn_;
   };
 
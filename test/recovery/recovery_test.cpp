@@ -29,6 +29,7 @@ namespace bustub {
 // NOLINTNEXTLINE
 TEST(RecoveryTest, DISABLED_RedoTest) {
   remove("test.db");
+  remove("test.fsm");
   remove("test.log");
 
   BustubInstance *bustub_instance = new BustubInstance("test.db");
@@ -118,12 +119,14 @@ TEST(RecoveryTest, DISABLED_RedoTest) {
   delete bustub_instance;
   LOG_INFO("Tearing down the system..");
   remove("test.db");
+  remove("test.fsm");
   remove("test.log");
 }
 
 // NOLINTNEXTLINE
 TEST(RecoveryTest, DISABLED_UndoTest) {
   remove("test.db");
+  remove("test.fsm");
   remove("test.log");
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
@@ -202,12 +205,14 @@ TEST(RecoveryTest, DISABLED_UndoTest) {
   delete bustub_instance;
   LOG_INFO("Tearing down the system..");
   remove("test.db");
+  remove("test.fsm");
   remove("test.log");
 }
 
 // NOLINTNEXTLINE
 TEST(RecoveryTest, DISABLED_CheckpointTest) {
   remove("test.db");
+  remove("test.fsm");
   remove("test.log");
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
@@ -312,6 +317,7 @@ TEST(RecoveryTest, DISABLED_CheckpointTest) {
 
   LOG_INFO("Tearing down the system..");
   remove("test.db");
+  remove("test.fsm");
   remove("test.log");
 }
 }  // namespace bustub
@@ -10,10 +10,18 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <cstring>
+#include <future>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
+#include "storage/disk/async_disk_io.h"
 #include "storage/disk/disk_manager.h"
 
 namespace bustub {
@@ -39,6 +47,7 @@ TEST(DiskManagerTest, ReadWritePageTest) {
 
   dm.ShutDown();
   remove(db_file.c_str());
+  remove("test.fsm");
 }
 
 TEST(DiskManagerTest, ReadWriteLogTest) {
@@ -56,6 +65,298 @@ TEST(DiskManagerTest, ReadWriteLogTest) {
 
   dm.ShutDown();
   remove(db_file.c_str());
+  remove("test.fsm");
+}
+
+// NOLINTNEXTLINE
+TEST(DiskManagerTest, ConcurrentReadWritePageTest) {
+  std::string db_file("test.db");
+  auto *dm = new DiskManager(db_file);
+  const int num_threads = 8;
+  const int num_rounds = 50;
+  const int pages_per_thread = 16;
+
+  // Scenario: threads read and write pages at once, with nothing in between. Every page holds what was last written
+  // to it, and nobody reads another thread's page by mistake.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([dm, t] {
+      char data[PAGE_SIZE];
+      char buf[PAGE_SIZE];
+      for (int round = 0; round < num_rounds; round++) {
+        for (int i = 0; i < pages_per_thread; i++) {
+          page_id_t page_id = i * num_threads + t;
+          memset(data, 0, PAGE_SIZE);
+          snprintf(data, PAGE_SIZE, "page %d round %d", page_id, round);
+          dm->WritePage(page_id, data);
+          dm->ReadPage(page_id, buf);
+          ASSERT_EQ(0, std::memcmp(buf, data, PAGE_SIZE)) << "page " << page_id;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(num_threads * pages_per_thread, dm->GetNumPages());
+  EXPECT_EQ(num_threads * num_rounds * pages_per_thread, dm->GetNumWrites());
+
+  // Scenario: pages past the end of the file read as zeros.
+  char buf[PAGE_SIZE];
+  memset(buf, 1, PAGE_SIZE);
+  dm->ReadPage(num_threads * pages_per_thread + 3, buf);
+  EXPECT_EQ(std::string(PAGE_SIZE, '\0'), std::string(buf, PAGE_SIZE));
+  dm->ShutDown();
+  delete dm;
+
+  // Scenario: the size of the file is known again when it is opened again.
+  dm = new DiskManager(db_file);
+  EXPECT_EQ(num_threads * pages_per_thread, dm->GetNumPages());
+  dm->ReadPage(num_threads * pages_per_thread - 1, buf);
+  EXPECT_STREQ(("page " + std::to_string(num_threads * pages_per_thread - 1) + " round " +
+                std::to_string(num_rounds - 1)).c_str(), buf);
+  dm->ShutDown();
+  delete dm;
+  remove(db_file.c_str());
+  remove("test.fsm");
+}
+
+// NOLINTNEXTLINE
+TEST(DiskManagerTest, AsyncReadWritePageTest) {
+  std::string db_file("test.db");
+  const int num_pages = 100;
+  std::vector<DiskIOBackend> backends{DiskIOBackend::THREAD_POOL};
+  if (IoUringDiskIO(-1, 1).Ok()) {
+    backends.push_back(DiskIOBackend::IO_URING);
+  }
+  for (auto backend : backends) {
+    auto *dm = new DiskManager(db_file, backend);
+    std::vector<std::vector<char>> data(num_pages, std::vector<char>(PAGE_SIZE));
+    std::vector<std::vector<char>> buf(num_pages, std::vector<char>(PAGE_SIZE, 1));
+
+    // Scenario: many writes in flight at once, half of them with callbacks and half with futures.
+    std::atomic<int> written{0};
+    std::promise<void> all_written;
+    std::vector<std::future<bool>> futures;
+    for (int i = 0; i < num_pages; i++) {
+      snprintf(data[i].data(), PAGE_SIZE, "page %d", i);
+      if (i % 2 == 0) {
+        dm->WritePageAsync(i, data[i].data(), [&](bool ok) {
+          EXPECT_TRUE(ok);
+          if (written.fetch_add(1) + 1 == num_pages / 2) {
+            all_written.set_value();
+          }
+        });
+      } else {
+        futures.push_back(dm->WritePageAsync(i, data[i].data()));
+      }
+    }
+    for (auto &future : futures) {
+      EXPECT_TRUE(future.get());
+    }
+    all_written.get_future().wait();
+    EXPECT_EQ(num_pages, dm->GetNumPages());
+    EXPECT_EQ(num_pages, dm->GetNumWrites());
+
+    // Scenario: reads in flight at once see what was written; a page past the end of the file reads as zeros.
+    futures.clear();
+    for (int i = 0; i < num_pages; i++) {
+      futures.push_back(dm->ReadPageAsync(i, buf[i].data()));
+    }
+    std::vector<char> past_end(PAGE_SIZE, 1);
+    EXPECT_TRUE(dm->ReadPageAsync(num_pages + 7, past_end.data()).get());
+    for (int i = 0; i < num_pages; i++) {
+      EXPECT_TRUE(futures[i].get());
+      EXPECT_EQ(data[i], buf[i]) << "page " << i;
+    }
+    EXPECT_EQ(std::vector<char>(PAGE_SIZE, 0), past_end);
+
+    // Scenario: batches of several runs of pages go out at once, and the synchronous API sees the result.
+    std::vector<std::pair<page_id_t, const char *>> to_write;
+    std::vector<std::pair<page_id_t, char *>> to_read;
+    for (int i = 0; i < num_pages; i += 3) {
+      data[i][0] = 'P';
+      to_write.emplace_back(i, data[i].data());
+      to_read.emplace_back(i, buf[i].data());
+    }
+    dm->WritePages(to_write, false);
+    to_read.emplace_back(num_pages + 1, past_end.data());
+    memset(past_end.data(), 1, PAGE_SIZE);
+    dm->ReadPages(to_read);
+    for (int i = 0; i < num_pages; i += 3) {
+      EXPECT_EQ(data[i], buf[i]) << "page " << i;
+    }
+    EXPECT_EQ(std::vector<char>(PAGE_SIZE, 0), past_end);
+    dm->ReadPage(3, buf[3].data());
+    EXPECT_STREQ("Page 3", buf[3].data());
+
+    dm->ShutDown();
+    delete dm;
+    remove(db_file.c_str());
+    remove("test.fsm");
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(DiskManagerTest, DirectIOTest) {
+  std::string db_file("test.db");
+  const int num_pages = 16;
+  auto *dm = new DiskManager(db_file, DiskIOBackend::AUTO, true);
+  // Buffers that start one byte into an aligned block, so that none of them is aligned.
+  std::vector<char> memory((2 * num_pages + 2) * PAGE_SIZE);
+  auto block = reinterpret_cast<uintptr_t>(memory.data()) / PAGE_SIZE * PAGE_SIZE + PAGE_SIZE;
+  auto data = [block](int i) { return reinterpret_cast<char *>(block) + i * PAGE_SIZE + 1; };
+  auto buf = [&](int i) { return data(num_pages + i); };
+
+  // Scenario: pages go to disk and back through any of the paths, whether the buffers are aligned or not.
+  std::vector<std::pair<page_id_t, const char *>> to_write;
+  std::vector<std::pair<page_id_t, char *>> to_read;
+  for (int i = 0; i < num_pages; i++) {
+    snprintf(data(i), PAGE_SIZE, "page %d", i);
+    if (i % 4 != 3) {
+      to_write.emplace_back(i, data(i));
+      to_read.emplace_back(i, buf(i));
+    }
+  }
+  dm->WritePages(to_write, true);
+  dm->WritePage(3, data(3));
+  EXPECT_TRUE(dm->WritePageAsync(7, data(7)).get());
+  dm->WritePage(11, data(11));
+  EXPECT_TRUE(dm->WritePageAsync(15, data(15)).get());
+  dm->ReadPages(to_read);
+  dm->ReadPage(3, buf(3));
+  dm->ReadPage(7, buf(7));
+  EXPECT_TRUE(dm->ReadPageAsync(11, buf(11)).get());
+  EXPECT_TRUE(dm->ReadPageAsync(15, buf(15)).get());
+  for (int i = 0; i < num_pages; i++) {
+    EXPECT_EQ(0, std::memcmp(data(i), buf(i), PAGE_SIZE)) << "page " << i;
+  }
+  EXPECT_EQ(num_pages, dm->GetNumPages());
+  dm->ShutDown();
+  delete dm;
+
+  // Scenario: a disk manager that uses the page cache reads what went around it.
+  dm = new DiskManager(db_file);
+  for (int i = 0; i < num_pages; i++) {
+    dm->ReadPage(i, buf(i));
+    EXPECT_STREQ(("page " + std::to_string(i)).c_str(), buf(i));
+  }
+  dm->ShutDown();
+  delete dm;
+  remove(db_file.c_str());
+  remove("test.fsm");
+}
+
+// NOLINTNEXTLINE
+TEST(DiskManagerTest, FreeSpaceMapTest) {
+  std::string db_file("test.db");
+  std::string fsm_file("test.fsm");
+  remove(fsm_file.c_str());
+  auto *dm = new DiskManager(db_file);
+  char data[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+
+  // Scenario: pages are handed out in order, and deallocated pages are handed out again, lowest first, while runs
+  // of pages go to the first gap that is large enough.
+  for (page_id_t i = 0; i < 10; i++) {
+    EXPECT_EQ(i, dm->AllocatePage());
+    memset(data, 0, PAGE_SIZE);
+    snprintf(data, PAGE_SIZE, "page %d", i);
+    dm->WritePage(i, data);
+  }
+  for (page_id_t page_id : {2, 3, 4, 7}) {
+    dm->DeallocatePage(page_id);
+  }
+  dm->DeallocatePage(3);
+  dm->DeallocatePage(42);
+  EXPECT_FALSE(dm->IsAllocated(3));
+  EXPECT_EQ(2, dm->AllocatePage());
+  EXPECT_EQ(10, dm->AllocatePages(3));
+  EXPECT_EQ(3, dm->AllocatePages(2));
+  EXPECT_TRUE(dm->IsAllocated(12));
+  EXPECT_FALSE(dm->IsAllocated(13));
+  dm->ShutDown();
+  delete dm;
+
+  // Scenario: allocations survive a restart.
+  dm = new DiskManager(db_file);
+  EXPECT_FALSE(dm->IsAllocated(7));
+  EXPECT_EQ(7, dm->AllocatePage());
+  EXPECT_EQ(13, dm->AllocatePage());
+
+  // Scenario: compacting punches holes for deallocated pages and cuts off the free end of the file.
+  for (page_id_t page_id : {5, 6, 8, 9, 10, 11, 12, 13}) {
+    dm->DeallocatePage(page_id);
+  }
+  EXPECT_EQ(10, dm->GetNumPages());
+  EXPECT_EQ(4, dm->Compact());
+  EXPECT_EQ(8, dm->GetNumPages());
+  dm->ReadPage(1, buf);
+  EXPECT_STREQ("page 1", buf);
+  dm->ReadPage(5, buf);
+  EXPECT_EQ(std::string(PAGE_SIZE, '\0'), std::string(buf, PAGE_SIZE));
+  EXPECT_EQ(5, dm->AllocatePage());
+
+  // Scenario: concurrent allocations never hand out a page twice.
+  std::vector<std::vector<page_id_t>> allocated(4);
+  std::vector<std::thread> threads;
+  for (auto &page_ids : allocated) {
+    threads.emplace_back([dm, &page_ids] {
+      for (int i = 0; i < 100; i++) {
+        page_ids.push_back(dm->AllocatePage());
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::vector<page_id_t> all;
+  for (auto &page_ids : allocated) {
+    all.insert(all.end(), page_ids.begin(), page_ids.end());
+  }
+  std::sort(all.begin(), all.end());
+  EXPECT_EQ(all.end(), std::adjacent_find(all.begin(), all.end()));
+  dm->ShutDown();
+  delete dm;
+
+  // Scenario: a db file without a free space map counts all of its pages as allocated.
+  remove(fsm_file.c_str());
+  dm = new DiskManager(db_file);
+  EXPECT_EQ(8, dm->AllocatePage());
+  dm->ShutDown();
+  delete dm;
+
+  // Scenario: after a crash, the map is as of its last flush, except that the pages the db file grew by are in use.
+  dm = new DiskManager(db_file);
+  dm->DeallocatePage(1);
+  dm->FlushFreeSpaceMap();
+  dm->DeallocatePage(2);
+  EXPECT_EQ(9, dm->AllocatePages(3));
+  memset(data, 0, PAGE_SIZE);
+  dm->WritePage(10, data);
+  auto *crashed_dm = dm;
+  dm = new DiskManager(db_file);
+  EXPECT_FALSE(dm->IsAllocated(1));
+  EXPECT_TRUE(dm->IsAllocated(2));
+  EXPECT_TRUE(dm->IsAllocated(9));
+  EXPECT_TRUE(dm->IsAllocated(10));
+  EXPECT_FALSE(dm->IsAllocated(11));
+  dm->ShutDown();
+  delete dm;
+  crashed_dm->ShutDown();
+  delete crashed_dm;
+
+  // Scenario: a disk manager that is deleted without being shut down writes the map out all the same.
+  dm = new DiskManager(db_file);
+  dm->DeallocatePage(9);
+  delete dm;
+  dm = new DiskManager(db_file);
+  EXPECT_FALSE(dm->IsAllocated(9));
+  EXPECT_TRUE(dm->IsAllocated(10));
+  dm->ShutDown();
+  delete dm;
+  remove(db_file.c_str());
+  remove(fsm_file.c_str());
 }
 
 TEST(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
@@ -11,12 +11,15 @@
 //===----------------------------------------------------------------------===//
 
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "common/bustub_instance.h"
 #include "gtest/gtest.h"
 #include "logging/common.h"
 #include "storage/table/table_heap.h"
@@ -65,10 +68,295 @@ TEST(TupleTest, DISABLED_TableHeapTest) {
   }
   disk_manager->ShutDown();
   remove("test.db");  // remove db file
+  remove("test.fsm");
   remove("test.log");
   delete table;
   delete buffer_pool_manager;
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(TupleTest, TableHeapScanTest) {
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  Column col3{"c", TypeId::BIGINT};
+  Column col4{"d", TypeId::BOOLEAN};
+  Column col5{"e", TypeId::VARCHAR, 16};
+  std::vector<Column> cols{col1, col2, col3, col4, col5};
+  Schema schema{cols};
+  Tuple tuple = ConstructTuple(&schema);
+  const int num_tuples = 2000;
+
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManager(64, disk_manager);
+  auto *lock_manager = new LockManager(TwoPLMode::REGULAR, DeadlockMode::PREVENTION);
+  auto *log_manager = new LogManager(disk_manager);
+  auto *table = new TableHeap(buffer_pool_manager, lock_manager, log_manager, transaction);
+  BufferAccessStrategy bulk_write(BufferAccessStrategyType::BULK_WRITE);
+  for (int i = 0; i < num_tuples; ++i) {
+    RID rid;
+    ASSERT_TRUE(table->InsertTuple(tuple, &rid, transaction, &bulk_write));
+  }
+  auto first_page_id = table->GetFirstPageId();
+  buffer_pool_manager->FlushAllPages();
+  delete table;
+  delete buffer_pool_manager;
+
+  // Scenario: scan the table on a cold buffer pool, through a ring and with the following pages read ahead.
+  buffer_pool_manager = new BufferPoolManager(64, disk_manager);
+  table = new TableHeap(buffer_pool_manager, lock_manager, log_manager, first_page_id);
+  BufferAccessStrategy bulk_read(BufferAccessStrategyType::BULK_READ);
+  int num_scanned = 0;
+  for (auto itr = table->Begin(transaction, &bulk_read); itr != table->End(); ++itr) {
+    EXPECT_EQ(tuple.GetLength(), itr->GetLength());
+    num_scanned++;
+  }
+  EXPECT_EQ(num_tuples, num_scanned);
+  auto stats = buffer_pool_manager->GetStats();
+  LOG_INFO("Scan read %lu pages on demand and %lu ahead", stats.misses_, stats.prefetches_);
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  remove("test.log");
+  delete table;
+  delete buffer_pool_manager;
+  delete log_manager;
+  delete lock_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, ConcurrentScanTest) {
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  Column col3{"c", TypeId::BIGINT};
+  Column col4{"d", TypeId::BOOLEAN};
+  Column col5{"e", TypeId::VARCHAR, 16};
+  std::vector<Column> cols{col1, col2, col3, col4, col5};
+  Schema schema{cols};
+  Tuple tuple = ConstructTuple(&schema);
+  const int num_tuples = 1000;
+
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManager(64, disk_manager);
+  auto *lock_manager = new LockManager(TwoPLMode::REGULAR, DeadlockMode::PREVENTION);
+  auto *log_manager = new LogManager(disk_manager);
+  auto *table = new TableHeap(buffer_pool_manager, lock_manager, log_manager, transaction);
+
+  // Scenario: an optimistic read of a page is only valid if nobody took the write latch meanwhile.
+  auto page = buffer_pool_manager->FetchPage(table->GetFirstPageId());
+  ASSERT_NE(nullptr, page);
+  uint64_t version;
+  ASSERT_TRUE(page->StartOptimisticRead(&version));
+  EXPECT_TRUE(page->ValidateOptimisticRead(version));
+  page->WLatch();
+  EXPECT_FALSE(page->ValidateOptimisticRead(version));
+  uint64_t locked_version;
+  EXPECT_FALSE(page->StartOptimisticRead(&locked_version));
+  page->WUnlatch();
+  EXPECT_FALSE(page->ValidateOptimisticRead(version));
+  ASSERT_TRUE(page->StartOptimisticRead(&version));
+  EXPECT_TRUE(page->ValidateOptimisticRead(version));
+  buffer_pool_manager->UnpinPage(table->GetFirstPageId(), false);
+
+  // Scenario: scans see every tuple that is there all along, in one piece, while tuples are added to the pages they
+  // read.
+  std::vector<RID> rids;
+  for (int i = 0; i < num_tuples; ++i) {
+    RID rid;
+    ASSERT_TRUE(table->InsertTuple(tuple, &rid, transaction));
+    rids.push_back(rid);
+  }
+  for (int i = 0; i < num_tuples; i += 2) {
+    ASSERT_TRUE(table->MarkDelete(rids[i], transaction));
+    table->ApplyDelete(rids[i], transaction);
+  }
+  std::atomic<bool> done{false};
+  Transaction writer_transaction(1);
+  std::thread writer([&] {
+    for (int i = 0; i < num_tuples; ++i) {
+      RID rid;
+      EXPECT_TRUE(table->InsertTuple(tuple, &rid, &writer_transaction));
+    }
+    done = true;
+  });
+  do {
+    int num_scanned = 0;
+    for (auto itr = table->Begin(transaction); itr != table->End(); ++itr) {
+      ASSERT_EQ(tuple.GetLength(), itr->GetLength());
+      EXPECT_EQ(0, memcmp(tuple.GetData(), itr->GetData(), tuple.GetLength()));
+      num_scanned++;
+    }
+    EXPECT_LE(num_tuples / 2, num_scanned);
+  } while (!done);
+  writer.join();
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  remove("test.log");
+  delete table;
+  delete buffer_pool_manager;
+  delete log_manager;
+  delete lock_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, TableOwnerTest) {
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  auto *buffer_pool_manager = new BufferPoolManager(32, disk_manager);
+  auto *lock_manager = new LockManager(TwoPLMode::REGULAR, DeadlockMode::PREVENTION);
+  auto *log_manager = new LogManager(disk_manager);
+  auto *table = new TableHeap(buffer_pool_manager, lock_manager, log_manager, transaction);
+
+  // Scenario: a new table registers itself with the buffer pool, named after its first page, and its pages are
+  // charged to it, the first one included.
+  auto owner_id = table->GetOwnerId();
+  EXPECT_NE(NO_OWNER, owner_id);
+  auto stats = buffer_pool_manager->GetOwnerStats();
+  ASSERT_LT(owner_id, stats.size());
+  EXPECT_EQ("table:" + std::to_string(table->GetFirstPageId()), stats[owner_id].name_);
+  EXPECT_EQ(1, stats[owner_id].resident_frames_);
+  EXPECT_EQ(0, stats[NO_OWNER].resident_frames_);
+  table->Begin(transaction);
+  EXPECT_EQ(1, buffer_pool_manager->GetOwnerStats()[owner_id].hits_);
+
+  // Scenario: opening the table again charges it to the same owner.
+  auto *reopened = new TableHeap(buffer_pool_manager, lock_manager, log_manager, table->GetFirstPageId());
+  EXPECT_EQ(owner_id, reopened->GetOwnerId());
+  delete reopened;
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  remove("test.log");
+  delete table;
+  delete buffer_pool_manager;
+  delete log_manager;
+  delete lock_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, ExtentTest) {
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  Column col3{"c", TypeId::BIGINT};
+  Column col4{"d", TypeId::BOOLEAN};
+  Column col5{"e", TypeId::VARCHAR, 16};
+  std::vector<Column> cols{col1, col2, col3, col4, col5};
+  Schema schema{cols};
+  Tuple tuple = ConstructTuple(&schema);
+  const int num_tuples = 2000;
+  const size_t extent_size = 16;
+
+  auto *transaction = new Transaction(0);
+  auto *disk_manager = new DiskManager("test.db");
+  BufferPoolOptions options;
+  options.extent_size_ = extent_size;
+  auto *buffer_pool_manager = new BufferPoolManager(2, 64, disk_manager, nullptr, options);
+  auto *lock_manager = new LockManager(TwoPLMode::REGULAR, DeadlockMode::PREVENTION);
+  auto *log_manager = new LogManager(disk_manager);
+  std::vector<TableHeap *> tables;
+  for (int i = 0; i < 2; i++) {
+    tables.push_back(new TableHeap(buffer_pool_manager, lock_manager, log_manager, transaction));
+  }
+
+  // Scenario: tables that grow at the same time still have their pages one after the other on disk, except after the
+  // first page, which is allocated before the table is registered, and where one extent ends and the next begins.
+  for (int i = 0; i < num_tuples; ++i) {
+    for (auto table : tables) {
+      RID rid;
+      ASSERT_TRUE(table->InsertTuple(tuple, &rid, transaction));
+    }
+  }
+  for (auto table : tables) {
+    size_t num_pages = 0;
+    size_t num_jumps = 0;
+    for (auto page_id = table->GetFirstPageId(); page_id != INVALID_PAGE_ID; num_pages++) {
+      auto page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(page_id));
+      ASSERT_NE(nullptr, page);
+      auto next_page_id = page->GetNextPageId();
+      buffer_pool_manager->UnpinPage(page_id, false);
+      if (next_page_id != INVALID_PAGE_ID && next_page_id != page_id + 1) {
+        num_jumps++;
+      }
+      page_id = next_page_id;
+    }
+    EXPECT_LT(extent_size, num_pages);
+    EXPECT_EQ(1 + (num_pages - 2) / extent_size, num_jumps);
+  }
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  remove("test.log");
+  for (auto table : tables) {
+    delete table;
+  }
+  delete buffer_pool_manager;
+  delete log_manager;
+  delete lock_manager;
+  delete disk_manager;
+  delete transaction;
+}
+
+// NOLINTNEXTLINE
+TEST(TupleTest, ExtentTeardownTest) {
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  std::vector<Column> cols{col1, col2};
+  Schema schema{cols};
+  Tuple tuple = ConstructTuple(&schema);
+  const int num_tuples = 500;
+  const size_t extent_size = 16;
+
+  auto *instance = new BustubInstance("test.db", 64, 0, extent_size);
+  auto *transaction = new Transaction(0);
+  auto *table = new TableHeap(instance->buffer_pool_manager_, instance->lock_manager_, instance->log_manager_,
+                              transaction);
+  for (int i = 0; i < num_tuples; ++i) {
+    RID rid;
+    ASSERT_TRUE(table->InsertTuple(tuple, &rid, transaction));
+  }
+  std::vector<page_id_t> page_ids;
+  for (auto page_id = table->GetFirstPageId(); page_id != INVALID_PAGE_ID;) {
+    page_ids.push_back(page_id);
+    auto page = static_cast<TablePage *>(instance->buffer_pool_manager_->FetchPage(page_id));
+    ASSERT_NE(nullptr, page);
+    auto next_page_id = page->GetNextPageId();
+    instance->buffer_pool_manager_->UnpinPage(page_id, false);
+    page_id = next_page_id;
+  }
+  ASSERT_LT(2, page_ids.size());
+  ASSERT_GT(extent_size, page_ids.size());
+  instance->buffer_pool_manager_->FlushAllPages();
+  delete table;
+  delete transaction;
+  delete instance;
+
+  // Scenario: after the instance is torn down, the free space map on disk holds the pages of the table, and not the
+  // rest of its extent.
+  auto *disk_manager = new DiskManager("test.db");
+  for (auto page_id : page_ids) {
+    EXPECT_TRUE(disk_manager->IsAllocated(page_id));
+  }
+  EXPECT_FALSE(disk_manager->IsAllocated(page_ids.back() + 1));
+  EXPECT_FALSE(disk_manager->IsAllocated(page_ids[1] + static_cast<page_id_t>(extent_size) - 1));
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.fsm");
+  remove("test.log");
+  delete disk_manager;
+}
+
 }  // namespace bustub